@@ -20,804 +20,363 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <setjmp.h>		/* 050523 */
+#include <pthread.h>
+#include <sys/stat.h>
+#include <glib.h>
 
 #include "avcbencsmp.h"
 
 #include <shcodecs/shcodecs_encoder.h>
 
-static int ReadUntilKeyMatch(FILE * fp_in, const char *key_word, char *buf_value)
+/* コントロールファイルの1パラメータの値 */
+typedef struct {
+	char *str;		/* ";"までの文字列 */
+	long num;		/* 数値として読めた場合の値 */
+	int is_num;
+} CtrlFileValue;
+
+/* パース済みコントロールファイルのキャッシュ */
+typedef struct {
+	time_t mtime;
+	off_t size;
+	GHashTable *table;
+} CtrlFileCacheEntry;
+
+typedef int (*CtrlFileSetter) (SHCodecs_Encoder * encoder, long value);
+
+typedef struct {
+	const char *key_word;
+	CtrlFileSetter set;
+} CtrlFileParam;
+
+/* セッタの引数と戻り値の型はそれぞれ異なるので、表には同じ型の
+   サンクを置き、値はサンクの中でセッタの引数の型に変換する */
+#define CTRL_FILE_SETTER(key_word, name) \
+	static int CtrlFileSet_##name(SHCodecs_Encoder * encoder, long value) \
+	{ \
+		return (int)shcodecs_encoder_set_##name(encoder, value); \
+	}
+
+#define CTRL_FILE_PARAM(key_word, name) {key_word, CtrlFileSet_##name},
+
+static GHashTable *ctrl_file_cache = NULL;
+static pthread_mutex_t ctrl_file_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*** avcbe_encoding_property ***/
+#define ENCODING_PROPERTY_PARAMS(P) \
+	P("bitrate", bitrate) \
+	P("I_vop_interval", I_vop_interval) \
+	P("mv_mode", mv_mode) \
+	P("fcode_forward", fcode_forward) \
+	P("search_mode", search_mode) \
+	P("search_time_fixed", search_time_fixed) \
+	P("rate_ctrl_skip_enable", ratecontrol_skip_enable) \
+	P("rate_ctrl_use_prevquant", ratecontrol_use_prevquant) \
+	P("rate_ctrl_respect_type", ratecontrol_respect_type) \
+	P("rate_ctrl_intra_thr_changeable", ratecontrol_intra_thr_changeable) \
+	P("control_bitrate_length", control_bitrate_length) \
+	P("intra_macroblock_refresh_cycle", intra_macroblock_refresh_cycle) \
+	P("video_format", video_format) \
+	P("frame_num_resolution", frame_num_resolution) \
+	P("noise_reduction", noise_reduction) \
+	P("reaction_param_coeff", reaction_param_coeff) \
+	P("weightedQ_mode", weightedQ_mode)
+
+ENCODING_PROPERTY_PARAMS(CTRL_FILE_SETTER)
+
+static const CtrlFileParam encoding_property_params[] = {
+	ENCODING_PROPERTY_PARAMS(CTRL_FILE_PARAM)
+	{NULL, NULL}
+};
+
+/*** avcbe_other_options_h264 ***/
+#define OTHER_OPTIONS_H264_PARAMS(P) \
+	P("Ivop_quant_initial_value", h264_Ivop_quant_initial_value) \
+	P("Pvop_quant_initial_value", h264_Pvop_quant_initial_value) \
+	P("use_dquant", h264_use_dquant) \
+	P("clip_dquant_next_mb", h264_clip_dquant_next_mb) \
+	P("clip_dquant_frame", h264_clip_dquant_frame) \
+	P("quant_min", h264_quant_min) \
+	P("quant_min_Ivop_under_range", h264_quant_min_Ivop_under_range) \
+	P("quant_max", h264_quant_max) \
+	P("rate_ctrl_cpb_skipcheck_enable", h264_ratecontrol_cpb_skipcheck_enable) \
+	P("rate_ctrl_cpb_Ivop_noskip", h264_ratecontrol_cpb_Ivop_noskip) \
+	P("rate_ctrl_cpb_remain_zero_skip_enable", h264_ratecontrol_cpb_remain_zero_skip_enable) \
+	P("rate_ctrl_cpb_offset", h264_ratecontrol_cpb_offset) \
+	P("rate_ctrl_cpb_offset_rate", h264_ratecontrol_cpb_offset_rate) \
+	P("rate_ctrl_cpb_buffer_mode", h264_ratecontrol_cpb_buffer_mode) \
+	P("rate_ctrl_cpb_max_size", h264_ratecontrol_cpb_max_size) \
+	P("rate_ctrl_cpb_buffer_unit_size", h264_ratecontrol_cpb_buffer_unit_size) \
+	P("intra_thr_1", h264_intra_thr_1) \
+	P("intra_thr_2", h264_intra_thr_2) \
+	P("sad_intra_bias", h264_sad_intra_bias) \
+	P("regularly_inserted_I_type", h264_regularly_inserted_I_type) \
+	P("call_unit", h264_call_unit) \
+	P("use_slice", h264_use_slice) \
+	P("slice_size_mb", h264_slice_size_mb) \
+	P("slice_size_bit", h264_slice_size_bit) \
+	P("slice_type_value_pattern", h264_slice_type_value_pattern) \
+	P("use_mb_partition", h264_use_mb_partition) \
+	P("mb_partition_vector_thr", h264_mb_partition_vector_thr) \
+	P("deblocking_mode", h264_deblocking_mode) \
+	P("use_deblocking_filter_control", h264_use_deblocking_filter_control) \
+	P("deblocking_alpha_offset", h264_deblocking_alpha_offset) \
+	P("deblocking_beta_offset", h264_deblocking_beta_offset) \
+	P("me_skip_mode", h264_me_skip_mode) \
+	P("put_start_code", h264_put_start_code) \
+	P("param_changeable", h264_param_changeable) \
+	P("changeable_max_bitrate", h264_changeable_max_bitrate) \
+	P("seq_param_set_id", h264_seq_param_set_id) \
+	P("profile", h264_profile) \
+	P("constraint_set_flag", h264_constraint_set_flag) \
+	P("level_type", h264_level_type) \
+	P("level_value", h264_level_value) \
+	P("out_vui_parameters", h264_out_vui_parameters) \
+	P("chroma_qp_index_offset", h264_chroma_qp_index_offset) \
+	P("constrained_intra_pred", h264_constrained_intra_pred) \
+	P("ref_frame_num", ref_frame_num) \
+	P("filler_output_on", output_filler_enable)
+
+OTHER_OPTIONS_H264_PARAMS(CTRL_FILE_SETTER)
+
+static const CtrlFileParam other_options_h264_params[] = {
+	OTHER_OPTIONS_H264_PARAMS(CTRL_FILE_PARAM)
+	{NULL, NULL}
+};
+
+/*** avcbe_other_options_mpeg4 ***/
+#define OTHER_OPTIONS_MPEG4_PARAMS(P) \
+	P("out_vos", mpeg4_out_vos) \
+	P("out_gov", mpeg4_out_gov) \
+	P("aspect_ratio_info_type", mpeg4_aspect_ratio_info_type) \
+	P("aspect_ratio_info_value", mpeg4_aspect_ratio_info_value) \
+	P("vos_profile_level_type", mpeg4_vos_profile_level_type) \
+	P("vos_profile_level_value", mpeg4_vos_profile_level_value) \
+	P("out_visual_object_identifier", mpeg4_out_visual_object_identifier) \
+	P("visual_object_verid", mpeg4_visual_object_verid) \
+	P("visual_object_priority", mpeg4_visual_object_priority) \
+	P("video_object_type_indication", mpeg4_video_object_type_indication) \
+	P("out_object_layer_identifier", mpeg4_out_object_layer_identifier) \
+	P("video_object_layer_verid", mpeg4_video_object_layer_verid) \
+	P("video_object_layer_priority", mpeg4_video_object_layer_priority) \
+	P("error_resilience_mode", mpeg4_error_resilience_mode) \
+	P("video_packet_size_mb", mpeg4_video_packet_size_mb) \
+	P("video_packet_size_bit", mpeg4_video_packet_size_bit) \
+	P("video_packet_header_extention", mpeg4_video_packet_header_extention) \
+	P("data_partitioned", mpeg4_data_partitioned) \
+	P("reversible_vlc", mpeg4_reversible_vlc) \
+	P("high_quality", mpeg4_high_quality) \
+	P("param_changeable", mpeg4_param_changeable) \
+	P("changeable_max_bitrate", mpeg4_changeable_max_bitrate) \
+	P("Ivop_quant_initial_value", mpeg4_Ivop_quant_initial_value) \
+	P("Pvop_quant_initial_value", mpeg4_Pvop_quant_initial_value) \
+	P("use_dquant", mpeg4_use_dquant) \
+	P("clip_dquant_frame", mpeg4_clip_dquant_frame) \
+	P("quant_min", mpeg4_quant_min) \
+	P("quant_min_Ivop_under_range", mpeg4_quant_min_Ivop_under_range) \
+	P("quant_max", mpeg4_quant_max) \
+	P("rate_ctrl_vbv_skipcheck_enable", mpeg4_ratecontrol_vbv_skipcheck_enable) \
+	P("rate_ctrl_vbv_Ivop_noskip", mpeg4_ratecontrol_vbv_Ivop_noskip) \
+	P("rate_ctrl_vbv_remain_zero_skip_enable", mpeg4_ratecontrol_vbv_remain_zero_skip_enable) \
+	P("rate_ctrl_vbv_buffer_unit_size", mpeg4_ratecontrol_vbv_buffer_unit_size) \
+	P("rate_ctrl_vbv_buffer_mode", mpeg4_ratecontrol_vbv_buffer_mode) \
+	P("rate_ctrl_vbv_max_size", mpeg4_ratecontrol_vbv_max_size) \
+	P("rate_ctrl_vbv_offset", mpeg4_ratecontrol_vbv_offset) \
+	P("rate_ctrl_vbv_offset_rate", mpeg4_ratecontrol_vbv_offset_rate) \
+	P("quant_type", mpeg4_quant_type) \
+	P("use_AC_prediction", mpeg4_use_AC_prediction) \
+	P("vop_min_mode", mpeg4_vop_min_mode) \
+	P("vop_min_size", mpeg4_vop_min_size) \
+	P("intra_thr", mpeg4_intra_thr) \
+	P("b_vop_num", mpeg4_b_vop_num)
+
+OTHER_OPTIONS_MPEG4_PARAMS(CTRL_FILE_SETTER)
+
+static const CtrlFileParam other_options_mpeg4_params[] = {
+	OTHER_OPTIONS_MPEG4_PARAMS(CTRL_FILE_PARAM)
+	{NULL, NULL}
+};
+
+static void FreeCtrlFileValue(gpointer data)
 {
-	char buf_line[256], buf_work_value[256], *pos;
-	int line_length, keyword_length, try_count;
+	CtrlFileValue *value = data;
 
-	keyword_length = strlen(key_word);
-
-	try_count = 1;
-
-      retry:;
-	while (fgets(buf_line, 256, fp_in)) {
-		line_length = strlen(buf_line);
-		if (line_length < keyword_length) {
-			continue;
-		}
-
-		if (strncmp(key_word, &buf_line[0], keyword_length) == 0) {
-			pos = strchr(&buf_line[keyword_length], '=');
-			if (pos == NULL) {
-				return (-2);
-				/* キーワードに一致する行は見つかったが、"="が見つからなかった */
-				;
-			}
-			strcpy(buf_work_value, (pos + 2));
-			pos = strchr(&buf_work_value[1], ';');
-			if (pos == NULL) {
-				return (-3);
-				/* キーワードに一致する行は見つかったが、";"が見つからなかった */
-				;
-			} else {
-				*pos = '\0';
-			}
-
-			strcpy(buf_value, buf_work_value);
-			return (1);	/* 見つかった */
-		}
-	}
-
-	/* 見つからなかったときは、ファイルの先頭に戻る */
-	if (try_count == 1) {
-		rewind(fp_in);
-		try_count = 2;
-		goto retry;
-	} else {
-		return (-1);	/* 見つからなった */
-	}
+	g_free(value->str);
+	g_free(value);
 }
 
-/*****************************************************************************
- * Function Name	: GetValueFromCtrlFile
- * Description		: コントロールファイルから、キーワードに対する数値を読み込み、戻り値で返す
- *					
- * Parameters		: 
- * Called functions	: 		  
- * Global Data		: 
- * Return Value		: 
- *****************************************************************************/
-static long GetValueFromCtrlFile(FILE * fp_in, const char *key_word,
-			  int *status_flag)
+static void FreeCtrlFileCacheEntry(gpointer data)
 {
-	char buf_line[256];
-	long return_code, work_value;
-
-	*status_flag = 1;	/* 正常のとき */
-
-	if ((fp_in == NULL) || (key_word == NULL)) {
-		*status_flag = -1;	/* 引数エラーのとき */
-		return (0);
-	}
-
-	return_code = ReadUntilKeyMatch(fp_in, key_word, &buf_line[0]);
-	if (return_code == 1) {
-		*status_flag = 1;	/* 正常のとき */
-		work_value = atoi((const char *) &buf_line[0]);
-	} else {
-		*status_flag = -1;	/* 見つからなかった等のエラーのとき */
-		work_value = 0;
-	}
+	CtrlFileCacheEntry *entry = data;
 
-	return (work_value);
+	g_hash_table_unref(entry->table);
+	g_free(entry);
 }
 
 /*****************************************************************************
- * Function Name	: GetFromCtrlFtoEncoding_property
- * Description		: コントロールファイルから、構造体avcbe_encoding_propertyのメンバ値を読み込み、引数に設定して返す
- *					
+ * Function Name	: ParseCtrlFile
+ * Description		: コントロールファイルを一度だけ走査し、"key = value;"の行を
+ *					  キーワードをキーとするハッシュテーブルに格納して返す
  * Parameters		: 
  * Called functions	: 		  
  * Global Data		: 
- * Return Value		: 
+ * Return Value		: ハッシュテーブル、NULL: エラー
  *****************************************************************************/
-static int GetFromCtrlFtoEncoding_property(FILE * fp_in,
-				    SHCodecs_Encoder * encoder)
+static GHashTable *ParseCtrlFile(const char *control_filepath)
 {
-	int status_flag;
-	long return_value;
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "bitrate", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_bitrate (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "I_vop_interval", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_I_vop_interval (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "mv_mode", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mv_mode (encoder, return_value);
-	}
+	GHashTable *table;
+	CtrlFileValue *value;
+	gchar *contents, *line, *next, *eq, *end, *num_end;
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "fcode_forward", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_fcode_forward (encoder, return_value);
+	if (!g_file_get_contents(control_filepath, &contents, NULL, NULL)) {
+		return (NULL);
 	}
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "search_mode", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_search_mode (encoder, return_value);
-	}
+	table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+				      FreeCtrlFileValue);
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "search_time_fixed", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_search_time_fixed (encoder, return_value);
-	}
+	for (line = contents; line != NULL; line = next) {
+		next = strchr(line, '\n');
+		if (next != NULL) {
+			*next++ = '\0';
+		}
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_skip_enable",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_ratecontrol_skip_enable (encoder, return_value);
-	}
+		/* コメント行、"="や";"のない行は読み飛ばす */
+		g_strchug(line);
+		eq = strchr(line, '=');
+		if ((eq == NULL) || (strncmp(line, "/*", 2) == 0)) {
+			continue;
+		}
+		end = strchr(eq + 1, ';');
+		if (end == NULL) {
+			continue;
+		}
+		*eq = '\0';
+		*end = '\0';
+		g_strstrip(line);
+		if ((*line == '\0') || g_hash_table_lookup(table, line)) {
+			continue;	/* 同じキーワードは最初の行を使う */
+		}
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_use_prevquant",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_ratecontrol_use_prevquant (encoder, return_value);
+		value = g_new0(CtrlFileValue, 1);
+		value->str = g_strdup(g_strstrip(eq + 1));
+		value->num = strtol(value->str, &num_end, 10);
+		value->is_num = (num_end != value->str);
+		g_hash_table_insert(table, g_strdup(line), value);
 	}
 
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_respect_type ", &status_flag);	/* 050426 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_ratecontrol_respect_type (encoder, return_value);
-	}
+	g_free(contents);
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_intra_thr_changeable",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_ratecontrol_intra_thr_changeable (encoder, return_value);
-	}
+	return (table);
+}
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "control_bitrate_length",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_control_bitrate_length (encoder, return_value);
-	}
+/*****************************************************************************
+ * Function Name	: GetCtrlFileTable
+ * Description		: パース済みのコントロールファイルを返す。パス名と更新時刻で
+ *					  キャッシュし、エレメントのインスタンス間で共有する
+ * Parameters		: 
+ * Called functions	: 		  
+ * Global Data		: ctrl_file_cache
+ * Return Value		: 参照を加えたハッシュテーブル、NULL: エラー
+ *****************************************************************************/
+static GHashTable *GetCtrlFileTable(const char *control_filepath)
+{
+	struct stat st;
+	CtrlFileCacheEntry *entry;
+	GHashTable *table;
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "intra_macroblock_refresh_cycle",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_intra_macroblock_refresh_cycle (encoder, return_value);
+	if (stat(control_filepath, &st) != 0) {
+		return (NULL);
 	}
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "video_format", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_video_format (encoder, return_value);
-	}
+	pthread_mutex_lock(&ctrl_file_cache_mutex);
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "frame_num_resolution",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_frame_num_resolution (encoder, return_value);
+	if (ctrl_file_cache == NULL) {
+		ctrl_file_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+							g_free,
+							FreeCtrlFileCacheEntry);
 	}
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "noise_reduction", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_noise_reduction (encoder, return_value);
+	entry = g_hash_table_lookup(ctrl_file_cache, control_filepath);
+	if ((entry == NULL) || (entry->mtime != st.st_mtime) ||
+	    (entry->size != st.st_size)) {
+		table = ParseCtrlFile(control_filepath);
+		if (table == NULL) {
+			pthread_mutex_unlock(&ctrl_file_cache_mutex);
+			return (NULL);
+		}
+		entry = g_new0(CtrlFileCacheEntry, 1);
+		entry->mtime = st.st_mtime;
+		entry->size = st.st_size;
+		entry->table = table;
+		/* 古いテーブルは使用中の参照がなくなった時点で解放される */
+		g_hash_table_replace(ctrl_file_cache,
+				     g_strdup(control_filepath), entry);
 	}
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "reaction_param_coeff",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_reaction_param_coeff (encoder, return_value);
-	}
+	table = g_hash_table_ref(entry->table);
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "weightedQ_mode", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_weightedQ_mode (encoder, return_value);
-	}
+	pthread_mutex_unlock(&ctrl_file_cache_mutex);
 
-	return (1);		/* 正常終了 */
+	return (table);
 }
 
 /*****************************************************************************
- * Function Name	: GetFromCtrlFtoOther_options_H264
- * Description		: コントロールファイルから、構造体avcbe_other_options_h264のメンバ値を読み込み、引数に設定して返す
+ * Function Name	: GetValueFromCtrlFile
+ * Description		: パース済みのコントロールファイルから、キーワードに対する数値を返す
  *					
  * Parameters		: 
  * Called functions	: 		  
  * Global Data		: 
  * Return Value		: 
  *****************************************************************************/
-static int GetFromCtrlFtoOther_options_H264(FILE * fp_in,
-				     SHCodecs_Encoder * encoder)
+static long GetValueFromCtrlFile(GHashTable * table, const char *key_word,
+			  int *status_flag)
 {
-	int status_flag;
-	long return_value;
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "Ivop_quant_initial_value",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_Ivop_quant_initial_value (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "Pvop_quant_initial_value",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_Pvop_quant_initial_value (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "use_dquant", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_use_dquant (encoder, return_value);
-	}
+	CtrlFileValue *value;
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "clip_dquant_next_mb",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_clip_dquant_next_mb (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "clip_dquant_frame", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_clip_dquant_frame (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "quant_min", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_quant_min (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "quant_min_Ivop_under_range", &status_flag);	/* 050509 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_quant_min_Ivop_under_range (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "quant_max", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_quant_max (encoder, return_value);
-	}
-
-
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_cpb_skipcheck_enable ", &status_flag);	/* 050524 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_ratecontrol_cpb_skipcheck_enable (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_cpb_Ivop_noskip",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_ratecontrol_cpb_Ivop_noskip (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_cpb_remain_zero_skip_enable", &status_flag);	/* 050524 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_ratecontrol_cpb_remain_zero_skip_enable (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_cpb_offset",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_ratecontrol_cpb_offset (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_cpb_offset_rate",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_ratecontrol_cpb_offset_rate (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_cpb_buffer_mode",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_ratecontrol_cpb_buffer_mode (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_cpb_max_size",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_ratecontrol_cpb_max_size (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_cpb_buffer_unit_size",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_ratecontrol_cpb_buffer_unit_size (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "intra_thr_1", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_intra_thr_1 (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "intra_thr_2", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_intra_thr_2 (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "sad_intra_bias", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_sad_intra_bias (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "regularly_inserted_I_type",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_regularly_inserted_I_type (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "call_unit", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_call_unit (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "use_slice", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_use_slice (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "slice_size_mb", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_slice_size_mb (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "slice_size_bit", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_slice_size_bit (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "slice_type_value_pattern",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_slice_type_value_pattern (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "use_mb_partition", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_use_mb_partition (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "mb_partition_vector_thr",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_mb_partition_vector_thr (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "deblocking_mode", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_deblocking_mode (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "use_deblocking_filter_control",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_use_deblocking_filter_control (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "deblocking_alpha_offset",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_deblocking_alpha_offset (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "deblocking_beta_offset",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_deblocking_beta_offset (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "me_skip_mode", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_me_skip_mode (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "put_start_code", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_put_start_code (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "param_changeable", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_param_changeable (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "changeable_max_bitrate",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_changeable_max_bitrate (encoder, return_value);
-	}
-
-	/* SequenceHeaderParameter */
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "seq_param_set_id", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_seq_param_set_id (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "profile", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_profile (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "constraint_set_flag",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_constraint_set_flag (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "level_type", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_level_type (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "level_value", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_level_value (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "out_vui_parameters",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_out_vui_parameters (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "chroma_qp_index_offset",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_chroma_qp_index_offset (encoder, return_value);
+	if ((table == NULL) || (key_word == NULL)) {
+		*status_flag = -1;	/* 引数エラーのとき */
+		return (0);
 	}
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "constrained_intra_pred",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_h264_constrained_intra_pred (encoder, return_value);
+	value = g_hash_table_lookup(table, key_word);
+	if ((value == NULL) || !value->is_num) {
+		*status_flag = -1;	/* 見つからなかった等のエラーのとき */
+		return (0);
 	}
 
-	return (1);		/* 正常終了 */
+	*status_flag = 1;	/* 正常のとき */
+	return (value->num);
 }
 
 /*****************************************************************************
- * Function Name	: GetFromCtrlFtoOther_options_MPEG4
- * Description		: コントロールファイルから、構造体avcbe_other_options_mpeg4のメンバ値を読み込み、引数に設定して返す
- *					
+ * Function Name	: SetFromCtrlTable
+ * Description		: パラメータ表の順にコントロールファイルの値を読み、
+ *					  見つかったものをエンコーダに設定する
  * Parameters		: 
  * Called functions	: 		  
  * Global Data		: 
  * Return Value		: 
  *****************************************************************************/
-static int GetFromCtrlFtoOther_options_MPEG4(FILE * fp_in,
-					SHCodecs_Encoder * encoder)
+static int SetFromCtrlTable(GHashTable * table, const CtrlFileParam * params,
+			    SHCodecs_Encoder * encoder)
 {
 	int status_flag;
 	long return_value;
 
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "out_vos", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_out_vos (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "out_gov", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_out_gov (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "aspect_ratio_info_type",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_aspect_ratio_info_type (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "aspect_ratio_info_value",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_aspect_ratio_info_value (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "vos_profile_level_type",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_vos_profile_level_type (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "vos_profile_level_value",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_vos_profile_level_value (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "out_visual_object_identifier",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_out_visual_object_identifier (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "visual_object_verid",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_visual_object_verid (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "visual_object_priority",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_visual_object_priority (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "video_object_type_indication",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_video_object_type_indication (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "out_object_layer_identifier",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_out_object_layer_identifier (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "video_object_layer_verid",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_video_object_layer_verid (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "video_object_layer_priority",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_video_object_layer_priority (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "error_resilience_mode",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_error_resilience_mode (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "video_packet_size_mb",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_video_packet_size_mb (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "video_packet_size_bit",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_video_packet_size_bit (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "video_packet_header_extention",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_video_packet_header_extention (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "data_partitioned", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_data_partitioned (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "reversible_vlc", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_reversible_vlc (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "high_quality", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_high_quality (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "param_changeable", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_param_changeable (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "changeable_max_bitrate",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_changeable_max_bitrate (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "Ivop_quant_initial_value",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_Ivop_quant_initial_value (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "Pvop_quant_initial_value",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_Pvop_quant_initial_value (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "use_dquant", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_use_dquant (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "clip_dquant_frame", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_clip_dquant_frame (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "quant_min", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_quant_min (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "quant_min_Ivop_under_range", &status_flag);	/* 050509 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_quant_min_Ivop_under_range (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "quant_max", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_quant_max (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_vbv_skipcheck_enable",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_ratecontrol_vbv_skipcheck_enable (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "rate_ctrl_vbv_Ivop_noskip",
-				 &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_ratecontrol_vbv_Ivop_noskip (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_vbv_remain_zero_skip_enable", &status_flag);	/* 050524 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_ratecontrol_vbv_remain_zero_skip_enable (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_vbv_buffer_unit_size", &status_flag);	/* 順序変更 050601 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_ratecontrol_vbv_buffer_unit_size (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_vbv_buffer_mode", &status_flag);	/* 順序変更 050601 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_ratecontrol_vbv_buffer_mode (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_vbv_max_size", &status_flag);	/* 順序変更 050601 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_ratecontrol_vbv_max_size (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_vbv_offset", &status_flag);	/* 順序変更 050601 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_ratecontrol_vbv_offset (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "rate_ctrl_vbv_offset_rate", &status_flag);	/* 順序変更 050601 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_ratecontrol_vbv_offset_rate (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "quant_type", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_quant_type (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "use_AC_prediction", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_use_AC_prediction (encoder, return_value);
-	}
-
-	return_value = GetValueFromCtrlFile(fp_in, "vop_min_mode", &status_flag);	/* 050524 */
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_vop_min_mode (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "vop_min_size", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_vop_min_size (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "intra_thr", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_intra_thr (encoder, return_value);
-	}
-
-	return_value =
-	    GetValueFromCtrlFile(fp_in, "b_vop_num", &status_flag);
-	if (status_flag == 1) {
-		shcodecs_encoder_set_mpeg4_b_vop_num (encoder, return_value);
+	for (; params->key_word != NULL; params++) {
+		return_value =
+		    GetValueFromCtrlFile(table, params->key_word,
+					 &status_flag);
+		if (status_flag == 1) {
+			params->set(encoder, return_value);
+		}
 	}
 
 	return (1);		/* 正常終了 */
 }
 
-
 /*****************************************************************************
  * Function Name	: GetFromCtrlFTop
  * Description		: コントロールファイルから、入力ファイル、出力先、ストリームタイプを得る
@@ -829,7 +388,7 @@ static int GetFromCtrlFtoOther_options_MPEG4(FILE * fp_in,
 int GetFromCtrlFTop(const char *control_filepath,
 		    APPLI_INFO * appli_info, long *stream_type)
 {
-	FILE *fp_in;
+	GHashTable *table;
 	int status_flag;
 	long return_value;
 
@@ -838,35 +397,41 @@ int GetFromCtrlFTop(const char *control_filepath,
 		return (-1);
 	}
 
-	fp_in = fopen(control_filepath, "rt");
-	if (fp_in == NULL) {
+	table = GetCtrlFileTable(control_filepath);
+	if (table == NULL) {
 		return (-1);
 	}
 
 	return_value =
-	    GetValueFromCtrlFile(fp_in, "stream_type", &status_flag);
+	    GetValueFromCtrlFile(table, "stream_type", &status_flag);
 	if (status_flag == 1) {
 		*stream_type = return_value;
 	}
 	return_value =
-	    GetValueFromCtrlFile(fp_in, "x_pic_size", &status_flag);
+	    GetValueFromCtrlFile(table, "x_pic_size", &status_flag);
 	if (status_flag == 1) {
 		appli_info->xpic = return_value;
 	}
 
 	return_value =
-	    GetValueFromCtrlFile(fp_in, "y_pic_size", &status_flag);
+	    GetValueFromCtrlFile(table, "y_pic_size", &status_flag);
 	if (status_flag == 1) {
 		appli_info->ypic = return_value;
 	}
 
 	return_value =
-	    GetValueFromCtrlFile(fp_in, "frame_rate", &status_flag);
+	    GetValueFromCtrlFile(table, "frame_rate", &status_flag);
 	if (status_flag == 1) {
 		appli_info->frame_rate = return_value;
 	}
 
-	fclose(fp_in);
+	return_value =
+	    GetValueFromCtrlFile(table, "bitrate", &status_flag);
+	if (status_flag == 1) {
+		appli_info->bitrate = return_value;
+	}
+
+	g_hash_table_unref(table);
 
 	return (1);		/* 正常終了 */
 
@@ -884,9 +449,7 @@ int GetFromCtrlFTop(const char *control_filepath,
 int GetFromCtrlFtoEncParam(SHCodecs_Encoder * encoder,
                            APPLI_INFO * appli_info)
 {
-	FILE *fp_in;
-	int status_flag;
-	long return_value;
+	GHashTable *table;
 	long stream_type;
 
 	if ((encoder == NULL) ||
@@ -895,34 +458,26 @@ int GetFromCtrlFtoEncParam(SHCodecs_Encoder * encoder,
 		return (-1);
 	}
 
-	fp_in = fopen(appli_info->ctrl_file_name_buf, "rt");
-	if (fp_in == NULL) {
+	/* GetFromCtrlFTopでパースしたテーブルがキャッシュから返される */
+	table = GetCtrlFileTable(appli_info->ctrl_file_name_buf);
+	if (table == NULL) {
 		return (-1);
 	}
 
 	/*** avcbe_encoding_property ***/
-	GetFromCtrlFtoEncoding_property(fp_in, encoder);
+	SetFromCtrlTable(table, encoding_property_params, encoder);
 
         stream_type = shcodecs_encoder_get_stream_type (encoder);
 
 	if (stream_type == SHCodecs_Format_H264) {
 		/*** avcbe_other_options_h264 ***/
-		GetFromCtrlFtoOther_options_H264(fp_in, encoder);
-	        return_value = GetValueFromCtrlFile(fp_in, "ref_frame_num", &status_flag);
-	        if (status_flag == 1) {
-		        shcodecs_encoder_set_ref_frame_num (encoder, return_value);
-	        }
-	        return_value = GetValueFromCtrlFile(fp_in, "filler_output_on", &status_flag);
-	        if (status_flag == 1) {
-	        	shcodecs_encoder_set_output_filler_enable (encoder, return_value);
-	        }
+		SetFromCtrlTable(table, other_options_h264_params, encoder);
 	} else {
 		/*** avcbe_other_options_mpeg4 ***/
-		GetFromCtrlFtoOther_options_MPEG4(fp_in, encoder);
+		SetFromCtrlTable(table, other_options_mpeg4_params, encoder);
 	}
 
-	fclose(fp_in);
+	g_hash_table_unref(table);
 
 	return (1);		/* 正常終了 */
 }
-
@@ -10,6 +10,7 @@ typedef struct {
 	long xpic;
 	long ypic;
     long frame_rate;
+	long bitrate;
 
 } APPLI_INFO;
 
@@ -0,0 +1,174 @@
+/**
+ * Helpers for scanning H.264 and MPEG-4 elementary streams
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <string.h>
+#include "gstshbitstream.h"
+
+const guint8 *
+bitstream_find_start_code(const guint8 *data, const guint8 *end)
+{
+	const guint8 *p = data;
+
+	while (p + 3 <= end)
+	{
+		/* The third byte decides how far we can skip */
+		if (p[2] > 1)
+		{
+			p += 3;
+		}
+		else if (p[2] == 0)
+		{
+			p++;
+		}
+		else if (p[0] == 0 && p[1] == 0)
+		{
+			return p;
+		}
+		else
+		{
+			p += 3;
+		}
+	}
+	return end;
+}
+
+/**
+ * Find the first start code with the given value
+ * \param data Start of the data
+ * \param size Size of the data
+ * \param code Value of the byte after 00 00 01
+ * \return pointer to the byte after the code value or NULL
+ */
+static const guint8 *
+bitstream_find_code(const guint8 *data, guint size, guint8 code)
+{
+	const guint8 *end = data + size;
+	const guint8 *p = data;
+
+	while ((p = bitstream_find_start_code(p, end)) + 3 < end)
+	{
+		if (p[3] == code)
+		{
+			return p + 4;
+		}
+		p += 3;
+	}
+	return NULL;
+}
+
+gboolean
+bitstream_h264_has_idr(const guint8 *data, guint size)
+{
+	const guint8 *end = data + size;
+	const guint8 *p = data;
+
+	while ((p = bitstream_find_start_code(p, end)) + 3 < end)
+	{
+		if ((p[3] & 0x1f) == H264_NAL_IDR)
+		{
+			return TRUE;
+		}
+		p += 3;
+	}
+	return FALSE;
+}
+
+gboolean
+bitstream_mpeg4_has_vop(const guint8 *data, guint size)
+{
+	return bitstream_find_code(data, size, MPEG4_VOP_START) != NULL;
+}
+
+gboolean
+bitstream_mpeg4_has_i_vop(const guint8 *data, guint size)
+{
+	return bitstream_mpeg4_vop_type(data, size) == MPEG4_VOP_I;
+}
+
+gint
+bitstream_mpeg4_vop_type(const guint8 *data, guint size)
+{
+	const guint8 *vop = bitstream_find_code(data, size, MPEG4_VOP_START);
+
+	if (!vop || vop >= data + size)
+	{
+		return -1;
+	}
+	// vop_coding_type is the first two bits
+	return vop[0] >> 6;
+}
+
+guint
+bitstream_mpeg4_header_size(const guint8 *data, guint size)
+{
+	const guint8 *end = data + size;
+	const guint8 *p = data;
+
+	// A GOV or a VOP alone is not a configuration
+	if (size < 4 || data[0] || data[1] || data[2] != 1 ||
+	    (data[3] != MPEG4_VOS_START && data[3] > MPEG4_VOL_START_MAX))
+	{
+		return 0;
+	}
+
+	// The GOV time code changes from one GOP to the next
+	while ((p = bitstream_find_start_code(p, end)) + 3 < end)
+	{
+		if (p[3] == MPEG4_GOV_START || p[3] == MPEG4_VOP_START)
+		{
+			return p - data;
+		}
+		p += 3;
+	}
+	return 0;
+}
+
+guint
+bitstream_h264_avcc_size(guint sps_size, guint pps_size)
+{
+	return 6 + 2 + sps_size + 1 + 2 + pps_size;
+}
+
+void
+bitstream_h264_write_avcc(guint8 *dst, const guint8 *sps, guint sps_size,
+			  const guint8 *pps, guint pps_size)
+{
+	guint8 *p = dst;
+
+	*p++ = 1;		// configurationVersion
+	*p++ = sps[1];		// AVCProfileIndication
+	*p++ = sps[2];		// profile_compatibility
+	*p++ = sps[3];		// AVCLevelIndication
+	*p++ = 0xfc | 3;	// lengthSizeMinusOne
+	*p++ = 0xe0 | 1;	// numOfSequenceParameterSets
+
+	*p++ = sps_size >> 8;
+	*p++ = sps_size & 0xff;
+	memcpy(p, sps, sps_size);
+	p += sps_size;
+
+	*p++ = 1;		// numOfPictureParameterSets
+	*p++ = pps_size >> 8;
+	*p++ = pps_size & 0xff;
+	memcpy(p, pps, pps_size);
+}
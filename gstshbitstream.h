@@ -0,0 +1,114 @@
+/**
+ * Helpers for scanning H.264 and MPEG-4 elementary streams
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHBITSTREAM_H
+#define  GSTSHBITSTREAM_H
+
+#include <glib.h>
+
+/** H.264 NAL unit types */
+#define H264_NAL_SLICE 1
+#define H264_NAL_IDR 5
+#define H264_NAL_SEI 6
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+
+/** MPEG-4 start code values */
+#define MPEG4_VOS_START 0xB0
+#define MPEG4_GOV_START 0xB3
+#define MPEG4_VOP_START 0xB6
+/** Video object and video object layer start codes are 0x00-0x2F */
+#define MPEG4_VOL_START_MAX 0x2F
+
+/** MPEG-4 vop_coding_type values */
+#define MPEG4_VOP_I 0
+#define MPEG4_VOP_P 1
+#define MPEG4_VOP_B 2
+
+/**
+ * Find the next 00 00 01 start code
+ * \param data Start of the data
+ * \param end End of the data
+ * \return pointer to the first zero of the start code or end if there is none
+ */
+const guint8 *bitstream_find_start_code(const guint8 *data, const guint8 *end);
+
+/**
+ * Check whether an H.264 byte stream contains an IDR slice
+ * \param data Start of the data
+ * \param size Size of the data
+ */
+gboolean bitstream_h264_has_idr(const guint8 *data, guint size);
+
+/**
+ * Check whether an MPEG-4 stream contains a VOP
+ * \param data Start of the data
+ * \param size Size of the data
+ */
+gboolean bitstream_mpeg4_has_vop(const guint8 *data, guint size);
+
+/**
+ * Check whether the first VOP of an MPEG-4 stream is an I-VOP
+ * \param data Start of the data
+ * \param size Size of the data
+ */
+gboolean bitstream_mpeg4_has_i_vop(const guint8 *data, guint size);
+
+/**
+ * Get the coding type of the first VOP of an MPEG-4 stream
+ * \param data Start of the data
+ * \param size Size of the data
+ * \return MPEG4_VOP_I, MPEG4_VOP_P, MPEG4_VOP_B or -1 if there is no VOP
+ */
+gint bitstream_mpeg4_vop_type(const guint8 *data, guint size);
+
+/**
+ * Get the size of the MPEG-4 configuration headers (VOS, VO and VOL) that
+ * precede the first GOV or VOP
+ * \param data Start of the data
+ * \param size Size of the data
+ * \return number of bytes before the first GOV or VOP start code, 0 if there
+ * is neither or the data does not start with a VOS, VO or VOL header
+ */
+guint bitstream_mpeg4_header_size(const guint8 *data, guint size);
+
+/**
+ * Get the size of an AVCDecoderConfigurationRecord with one SPS and one PPS
+ * \param sps_size Size of the SPS NAL unit without start code
+ * \param pps_size Size of the PPS NAL unit without start code
+ */
+guint bitstream_h264_avcc_size(guint sps_size, guint pps_size);
+
+/**
+ * Write an AVCDecoderConfigurationRecord (ISO/IEC 14496-15) with one SPS 
+ * and one PPS. NAL unit lengths are written in four bytes.
+ * \param dst Destination, bitstream_h264_avcc_size() bytes
+ * \param sps The SPS NAL unit without start code, at least 4 bytes
+ * \param sps_size Size of the SPS
+ * \param pps The PPS NAL unit without start code
+ * \param pps_size Size of the PPS
+ */
+void bitstream_h264_write_avcc(guint8 *dst, const guint8 *sps, guint sps_size,
+			       const guint8 *pps, guint pps_size);
+
+#endif // GSTSHBITSTREAM_H
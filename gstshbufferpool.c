@@ -0,0 +1,310 @@
+/**
+ * Recycling pool of frame buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gstshbufferpool.h"
+
+static GstBufferClass *parent_class;
+
+/** 
+ * Drop a reference to the pool and free it with the last one
+ * \param pool The pool
+ */
+static void
+gst_sh_buffer_pool_unref(GstSHBufferPool *pool)
+{
+	if (g_atomic_int_dec_and_test(&pool->refcount))
+	{
+		pthread_mutex_destroy(&pool->mutex);
+		g_free(pool);
+	}
+}
+
+/** 
+ * Free the memory of a buffer and give it back to the parent class
+ * \param buffer GstSHPoolBuffer object
+ */
+static void
+gst_sh_pool_buffer_destroy(GstSHPoolBuffer *buffer)
+{
+	GstSHBufferPool *pool = buffer->pool;
+
+	free(buffer->memory);
+	buffer->memory = NULL;
+	buffer->pool = NULL;
+	GST_BUFFER_MALLOCDATA(buffer) = NULL;
+	GST_BUFFER_DATA(buffer) = NULL;
+
+	GST_MINI_OBJECT_CLASS (parent_class)->finalize (GST_MINI_OBJECT (buffer));
+
+	if (pool)
+	{
+		gst_sh_buffer_pool_unref(pool);
+	}
+}
+
+/** 
+ * Initialize the buffer
+ * \param buffer GstSHPoolBuffer object
+ * \param g_class GClass pointer
+ */
+static void
+gst_sh_pool_buffer_init (GstSHPoolBuffer * buffer, gpointer g_class)
+{
+	buffer->pool = NULL;
+	buffer->memory = NULL;
+	buffer->memory_size = 0;
+}
+
+/** 
+ * Finalize the buffer. The buffer is resurrected and put back to the 
+ * free list if the pool is still in use.
+ * \param buffer GstSHPoolBuffer object
+ */
+static void
+gst_sh_pool_buffer_finalize (GstSHPoolBuffer * buffer)
+{
+	GstSHBufferPool *pool = buffer->pool;
+
+	if (pool)
+	{
+		pthread_mutex_lock(&pool->mutex);
+		if (pool->active && buffer->memory_size == pool->buffer_size)
+		{
+			gst_buffer_ref(GST_BUFFER_CAST(buffer));
+
+			gst_caps_replace(&GST_BUFFER_CAPS(buffer), NULL);
+			GST_BUFFER_FLAGS(buffer) = 0;
+			GST_BUFFER_DATA(buffer) = buffer->memory;
+			GST_BUFFER_SIZE(buffer) = buffer->memory_size;
+			GST_BUFFER_TIMESTAMP(buffer) = GST_CLOCK_TIME_NONE;
+			GST_BUFFER_DURATION(buffer) = GST_CLOCK_TIME_NONE;
+			GST_BUFFER_OFFSET(buffer) = GST_BUFFER_OFFSET_NONE;
+			GST_BUFFER_OFFSET_END(buffer) = GST_BUFFER_OFFSET_NONE;
+
+			pool->free_buffers = g_slist_prepend(pool->free_buffers, buffer);
+			pthread_mutex_unlock(&pool->mutex);
+			return;
+		}
+		pool->allocated--;
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	gst_sh_pool_buffer_destroy(buffer);
+}
+
+/** 
+ * Initialize the buffer class
+ * \param g_class GClass pointer
+ * \param class_data Optional data pointer
+ */
+static void
+gst_sh_pool_buffer_class_init (gpointer g_class, gpointer class_data)
+{
+	GstMiniObjectClass *mini_object_class = GST_MINI_OBJECT_CLASS (g_class);
+
+	parent_class = g_type_class_peek_parent (g_class);
+
+	mini_object_class->finalize = (GstMiniObjectFinalizeFunction)
+			gst_sh_pool_buffer_finalize;
+}
+
+GType
+gst_sh_pool_buffer_get_type (void)
+{
+	static GType gst_sh_pool_buffer_type;
+
+	if (G_UNLIKELY (gst_sh_pool_buffer_type == 0)) {
+		static const GTypeInfo gst_sh_pool_buffer_info = {
+			sizeof (GstBufferClass),
+			NULL,
+			NULL,
+			gst_sh_pool_buffer_class_init,
+			NULL,
+			NULL,
+			sizeof (GstSHPoolBuffer),
+			0,
+			(GInstanceInitFunc) gst_sh_pool_buffer_init,
+			NULL
+		};
+		gst_sh_pool_buffer_type = g_type_register_static (GST_TYPE_BUFFER,
+				"GstSHPoolBuffer", &gst_sh_pool_buffer_info, 0);
+	}
+	return gst_sh_pool_buffer_type;
+}
+
+GstSHBufferPool *
+gst_sh_buffer_pool_new(guint max_buffers)
+{
+	GstSHBufferPool *pool;
+
+	pool = g_new0(GstSHBufferPool, 1);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pool->free_buffers = NULL;
+	pool->buffer_size = 0;
+	pool->max_buffers = max_buffers;
+	pool->allocated = 0;
+	pool->active = TRUE;
+	pool->refcount = 1;
+
+	return pool;
+}
+
+/** 
+ * Take all the free buffers out of the pool. Must be called with the 
+ * pool mutex held.
+ * \param pool The pool
+ * \return list of the buffers
+ */
+static GSList *
+gst_sh_buffer_pool_steal_free(GstSHBufferPool *pool)
+{
+	GSList *list = pool->free_buffers;
+
+	pool->free_buffers = NULL;
+	pool->allocated -= g_slist_length(list);
+	return list;
+}
+
+/** 
+ * Free the buffers taken out of the pool. The buffers on the free list 
+ * were resurrected with one reference, dropping it without a pool runs 
+ * the normal finalize and frees the buffer object too.
+ * \param list List of GstSHPoolBuffer objects
+ */
+static void
+gst_sh_buffer_pool_destroy_list(GSList *list)
+{
+	GSList *item;
+	GstSHPoolBuffer *buffer;
+	GstSHBufferPool *pool;
+
+	for (item = list; item; item = g_slist_next(item))
+	{
+		buffer = GST_SH_POOL_BUFFER_CAST(item->data);
+		pool = buffer->pool;
+
+		buffer->pool = NULL;
+		gst_buffer_unref(GST_BUFFER_CAST(buffer));
+
+		if (pool)
+		{
+			gst_sh_buffer_pool_unref(pool);
+		}
+	}
+	g_slist_free(list);
+}
+
+void
+gst_sh_buffer_pool_free(GstSHBufferPool *pool)
+{
+	GSList *list;
+
+	if (!pool)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->active = FALSE;
+	list = gst_sh_buffer_pool_steal_free(pool);
+	pthread_mutex_unlock(&pool->mutex);
+
+	gst_sh_buffer_pool_destroy_list(list);
+	gst_sh_buffer_pool_unref(pool);
+}
+
+GstBuffer *
+gst_sh_buffer_pool_get(GstSHBufferPool *pool, guint size)
+{
+	GstSHPoolBuffer *buffer = NULL;
+	GSList *stale = NULL;
+	void *memory;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	if (size != pool->buffer_size)
+	{
+		// Frame size changed, the old buffers are of no use
+		stale = gst_sh_buffer_pool_steal_free(pool);
+		pool->buffer_size = size;
+	}
+
+	if (pool->free_buffers)
+	{
+		buffer = GST_SH_POOL_BUFFER_CAST(pool->free_buffers->data);
+		pool->free_buffers = g_slist_delete_link(pool->free_buffers,
+							 pool->free_buffers);
+	}
+	else if (pool->allocated < pool->max_buffers)
+	{
+		pool->allocated++;
+	}
+	else
+	{
+		pthread_mutex_unlock(&pool->mutex);
+		gst_sh_buffer_pool_destroy_list(stale);
+		return NULL;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	gst_sh_buffer_pool_destroy_list(stale);
+
+	if (buffer)
+	{
+		return GST_BUFFER_CAST(buffer);
+	}
+
+	if (posix_memalign(&memory, sysconf(_SC_PAGESIZE), size))
+	{
+		pthread_mutex_lock(&pool->mutex);
+		pool->allocated--;
+		pthread_mutex_unlock(&pool->mutex);
+		return NULL;
+	}
+
+	buffer = (GstSHPoolBuffer *) gst_mini_object_new(GST_TYPE_SH_POOL_BUFFER);
+	buffer->memory = memory;
+	buffer->memory_size = size;
+	buffer->pool = pool;
+	g_atomic_int_inc(&pool->refcount);
+
+	GST_BUFFER_DATA(buffer) = buffer->memory;
+	GST_BUFFER_SIZE(buffer) = size;
+
+	return GST_BUFFER_CAST(buffer);
+}
+
+guint
+gst_sh_buffer_pool_get_outstanding(GstSHBufferPool *pool)
+{
+	guint outstanding;
+
+	pthread_mutex_lock(&pool->mutex);
+	outstanding = pool->allocated - g_slist_length(pool->free_buffers);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return outstanding;
+}
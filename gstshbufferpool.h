@@ -0,0 +1,120 @@
+/**
+ * Recycling pool of frame buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+#ifndef GSTSHBUFFERPOOL_H
+#define GSTSHBUFFERPOOL_H
+
+#include <pthread.h>
+#include <gst/gst.h>
+
+#define GST_TYPE_SH_POOL_BUFFER (gst_sh_pool_buffer_get_type())
+#define GST_IS_SH_POOL_BUFFER(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_SH_POOL_BUFFER))
+#define GST_SH_POOL_BUFFER(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_SH_POOL_BUFFER, GstSHPoolBuffer))
+#define GST_SH_POOL_BUFFER_CAST(obj)  ((GstSHPoolBuffer *)(obj))
+
+typedef struct _GstSHBufferPool GstSHBufferPool;
+typedef struct _GstSHPoolBuffer GstSHPoolBuffer;
+typedef struct _GstSHPoolBufferclass GstSHPoolBufferclass;
+
+/**
+ * \struct _GstSHPoolBuffer
+ * \brief Buffer that returns to its pool when the last reference is dropped
+ * \var buffer Parent buffer
+ * \var pool The pool owning the memory
+ * \var memory Start of the allocated memory
+ * \var memory_size Size of the allocated memory
+ */
+struct _GstSHPoolBuffer 
+{
+	GstBuffer buffer;
+
+	GstSHBufferPool *pool;
+	guint8 *memory;
+	guint memory_size;
+};
+
+/**
+ * \struct _GstSHPoolBufferclass
+ * \var parent Parent
+ */
+struct _GstSHPoolBufferclass
+{
+	GstBufferClass parent;
+};
+
+/**
+ * \struct _GstSHBufferPool
+ * \var mutex Protects the free list and the counters
+ * \var free_buffers Buffers ready for reuse
+ * \var buffer_size Size of the buffers currently handed out
+ * \var max_buffers Maximum number of buffers allocated at the same time
+ * \var allocated Number of buffers allocated (free or in use)
+ * \var active FALSE after the pool has been freed by its owner
+ * \var refcount One reference for the owner and one for each buffer
+ */
+struct _GstSHBufferPool
+{
+	pthread_mutex_t mutex;
+	GSList *free_buffers;
+	guint buffer_size;
+	guint max_buffers;
+	guint allocated;
+	gboolean active;
+	volatile gint refcount;
+};
+
+/** 
+ * Get GstSHPoolBuffer object type
+ * @return object type
+ */
+GType gst_sh_pool_buffer_get_type (void);
+
+/** 
+ * Create a buffer pool
+ * @param max_buffers Maximum number of buffers in the pool
+ * @return the pool
+ */
+GstSHBufferPool *gst_sh_buffer_pool_new(guint max_buffers);
+
+/** 
+ * Release the pool. Buffers still in use are freed when they are returned.
+ * @param pool The pool
+ */
+void gst_sh_buffer_pool_free(GstSHBufferPool *pool);
+
+/** 
+ * Get a buffer from the pool. Page aligned memory is allocated if there 
+ * are no free buffers of the requested size.
+ * @param pool The pool
+ * @param size Size of the buffer
+ * @return the buffer or NULL if all the buffers are in use
+ */
+GstBuffer *gst_sh_buffer_pool_get(GstSHBufferPool *pool, guint size);
+
+/** 
+ * Get the number of buffers handed out and not yet returned
+ * @param pool The pool
+ * @return number of buffers in use
+ */
+guint gst_sh_buffer_pool_get_outstanding(GstSHBufferPool *pool);
+
+#endif //GSTSHBUFFERPOOL_H
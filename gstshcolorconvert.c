@@ -0,0 +1,261 @@
+/**
+ * Software conversion of packed and planar YUV frames to NV12
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <string.h>
+
+#include "gstshcolorconvert.h"
+
+/* The kernels work on 32-bit words holding four pixels. The SH core has no
+   SIMD unit, so this is as wide as it gets. */
+
+/**
+ * Load four bytes as a little endian word
+ * \param p Source, any alignment
+ */
+static inline guint32
+load_le32(const guint8 *p)
+{
+	guint32 w;
+
+	memcpy(&w, p, 4);
+	return GUINT32_FROM_LE(w);
+}
+
+/**
+ * Store a word as four little endian bytes
+ * \param p Destination, any alignment
+ * \param w The word
+ */
+static inline void
+store_le32(guint8 *p, guint32 w)
+{
+	w = GUINT32_TO_LE(w);
+	memcpy(p, &w, 4);
+}
+
+/**
+ * Spread the two low bytes of a word to bytes 0 and 2
+ * \param x The word
+ */
+static inline guint32
+spread16(guint32 x)
+{
+	x &= 0xffff;
+	return (x | (x << 8)) & 0x00ff00ff;
+}
+
+/**
+ * Average four byte pairs, rounding up
+ * \param a First word
+ * \param b Second word
+ */
+static inline guint32
+average4(guint32 a, guint32 b)
+{
+	return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7f);
+}
+
+/**
+ * Interleave one row of Cb and Cr samples
+ * \param dst Destination CbCr row
+ * \param u Cb row
+ * \param v Cr row
+ * \param count Number of sample pairs
+ */
+static void
+interleave_row(guint8 *dst, const guint8 *u, const guint8 *v, gint count)
+{
+	gint i;
+	guint32 wu, wv;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		wu = load_le32(u + i);
+		wv = load_le32(v + i);
+		store_le32(dst, spread16(wu) | (spread16(wv) << 8));
+		store_le32(dst + 4, spread16(wu >> 16) | (spread16(wv >> 16) << 8));
+		dst += 8;
+	}
+	for (; i < count; i++)
+	{
+		*dst++ = u[i];
+		*dst++ = v[i];
+	}
+}
+
+void
+convert_planar_to_nv12(guint8 *dst_y, guint8 *dst_c, 
+		       const guint8 *src_y, const guint8 *src_u, 
+		       const guint8 *src_v, gint width, gint height, 
+		       gint y_stride, gint c_stride)
+{
+	gint row;
+
+	/* One block is two luma rows and the chroma row they share */
+	for (row = 0; row < height; row += 2)
+	{
+		memcpy(dst_y, src_y, width);
+		memcpy(dst_y + width, src_y + y_stride, width);
+		interleave_row(dst_c, src_u, src_v, width / 2);
+
+		dst_y += 2 * width;
+		src_y += 2 * y_stride;
+		dst_c += width;
+		src_u += c_stride;
+		src_v += c_stride;
+	}
+}
+
+/**
+ * Split two YUY2 rows to two luma rows and one averaged CbCr row
+ * \param y0 First destination luma row
+ * \param y1 Second destination luma row
+ * \param c Destination CbCr row
+ * \param s0 First source row
+ * \param s1 Second source row
+ * \param width Width of the rows in pixels
+ */
+static void
+split_yuy2_rows(guint8 *y0, guint8 *y1, guint8 *c, const guint8 *s0,
+		const guint8 *s1, gint width)
+{
+	gint i;
+	guint32 a, b, chroma;
+
+	/* Each word holds Y0 Cb Y1 Cr of two pixels */
+	for (i = 0; i < width; i += 2)
+	{
+		a = load_le32(s0);
+		b = load_le32(s1);
+
+		y0[0] = a & 0xff;
+		y0[1] = (a >> 16) & 0xff;
+		y1[0] = b & 0xff;
+		y1[1] = (b >> 16) & 0xff;
+
+		chroma = average4(a, b);
+		c[0] = (chroma >> 8) & 0xff;
+		c[1] = chroma >> 24;
+
+		y0 += 2;
+		y1 += 2;
+		c += 2;
+		s0 += 4;
+		s1 += 4;
+	}
+}
+
+void
+convert_yuy2_to_nv12(guint8 *dst_y, guint8 *dst_c, const guint8 *src,
+		     gint width, gint height, gint stride)
+{
+	gint row;
+
+	for (row = 0; row < height; row += 2)
+	{
+		split_yuy2_rows(dst_y, dst_y + width, dst_c, src, src + stride, 
+				width);
+
+		dst_y += 2 * width;
+		dst_c += width;
+		src += 2 * stride;
+	}
+}
+
+/**
+ * Scale one plane of 8-bit (Y) or 16-bit (CbCr pair) samples
+ * \param dst Destination plane, packed
+ * \param src Source plane, packed
+ * \param columns Source column of each destination column
+ * \param dst_width Destination samples per row
+ * \param dst_height Destination rows
+ * \param src_width Source samples per row
+ * \param src_height Source rows
+ * \param pairs TRUE for CbCr pairs
+ */
+static void
+scale_plane(guint8 *dst, const guint8 *src, const gint *columns, 
+	    gint dst_width, gint dst_height, gint src_width, gint src_height,
+	    gboolean pairs)
+{
+	gint row, i;
+	guint32 y_step, y;
+	const guint8 *s;
+	guint16 *d16;
+
+	y_step = (src_height << 16) / dst_height;
+	y = y_step / 2;
+
+	for (row = 0; row < dst_height; row++, y += y_step)
+	{
+		if (pairs)
+		{
+			s = src + (y >> 16) * src_width * 2;
+			d16 = (guint16 *)(dst + row * dst_width * 2);
+			for (i = 0; i < dst_width; i++)
+			{
+				d16[i] = ((const guint16 *)s)[columns[i]];
+			}
+		}
+		else
+		{
+			s = src + (y >> 16) * src_width;
+			for (i = 0; i < dst_width; i++)
+			{
+				dst[row * dst_width + i] = s[columns[i]];
+			}
+		}
+	}
+}
+
+void
+scale_nv12_columns(gint *columns, gint dst_width, gint src_width)
+{
+	guint32 x_step, x;
+	gint i;
+
+	x_step = (src_width << 16) / dst_width;
+	for (i = 0, x = x_step / 2; i < dst_width; i++, x += x_step)
+	{
+		columns[i] = x >> 16;
+	}
+
+	// The chroma is subsampled by two in both directions
+	columns += dst_width;
+	x_step = (src_width << 15) / (dst_width / 2);
+	for (i = 0, x = x_step / 2; i < dst_width / 2; i++, x += x_step)
+	{
+		columns[i] = x >> 16;
+	}
+}
+
+void
+scale_nv12(guint8 *dst_y, guint8 *dst_c, gint dst_width, gint dst_height,
+	   const guint8 *src_y, const guint8 *src_c, 
+	   gint src_width, gint src_height, const gint *columns)
+{
+	scale_plane(dst_y, src_y, columns, dst_width, dst_height, 
+		    src_width, src_height, FALSE);
+	scale_plane(dst_c, src_c, columns + dst_width, dst_width / 2, 
+		    dst_height / 2, src_width / 2, src_height / 2, TRUE);
+}
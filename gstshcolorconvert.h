@@ -0,0 +1,93 @@
+/**
+ * Software conversion of packed and planar YUV frames to NV12
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHCOLORCONVERT_H
+#define  GSTSHCOLORCONVERT_H
+
+#include <glib.h>
+
+/**
+ * Convert a planar 4:2:0 frame (I420 or YV12) to NV12. The chroma planes are
+ * interleaved while the luma rows of the same block are copied, so the frame
+ * is read and written only once.
+ * \param dst_y Destination Y plane, packed
+ * \param dst_c Destination CbCr plane, packed
+ * \param src_y Source Y plane
+ * \param src_u Source Cb plane
+ * \param src_v Source Cr plane
+ * \param width Width of the frame, even
+ * \param height Height of the frame, even
+ * \param y_stride Bytes between the source luma rows
+ * \param c_stride Bytes between the source chroma rows
+ */
+void convert_planar_to_nv12(guint8 *dst_y, guint8 *dst_c, 
+			    const guint8 *src_y, const guint8 *src_u, 
+			    const guint8 *src_v, gint width, gint height, 
+			    gint y_stride, gint c_stride);
+
+/**
+ * Convert a packed 4:2:2 YUY2 frame to NV12. The chroma of two rows is 
+ * averaged to get the vertical subsampling.
+ * \param dst_y Destination Y plane, packed
+ * \param dst_c Destination CbCr plane, packed
+ * \param src Source frame
+ * \param width Width of the frame, even
+ * \param height Height of the frame, even
+ * \param stride Bytes between the source rows
+ */
+void convert_yuy2_to_nv12(guint8 *dst_y, guint8 *dst_c, const guint8 *src,
+			  gint width, gint height, gint stride);
+
+/**
+ * Number of entries in the column table of scale_nv12()
+ */
+#define SCALE_NV12_COLUMNS(dst_width) ((dst_width) + (dst_width) / 2)
+
+/**
+ * Fill in the source column of each destination column for scale_nv12(),
+ * first for the Y plane and then for the CbCr plane. The table only 
+ * depends on the widths, so it is made once for a pair of sizes.
+ * \param columns The table, SCALE_NV12_COLUMNS(dst_width) entries
+ * \param dst_width Width of the destination frame, even
+ * \param src_width Width of the source frame, even
+ */
+void scale_nv12_columns(gint *columns, gint dst_width, gint src_width);
+
+/**
+ * Scale a packed NV12 frame down to another size by picking the nearest 
+ * source pixel. Each destination pixel costs one load and one store.
+ * \param dst_y Destination Y plane, packed
+ * \param dst_c Destination CbCr plane, packed
+ * \param dst_width Width of the destination frame, even
+ * \param dst_height Height of the destination frame, even
+ * \param src_y Source Y plane, packed
+ * \param src_c Source CbCr plane, packed
+ * \param src_width Width of the source frame, even
+ * \param src_height Height of the source frame, even
+ * \param columns Table made by scale_nv12_columns() for the two widths
+ */
+void scale_nv12(guint8 *dst_y, guint8 *dst_c, gint dst_width, 
+		gint dst_height, const guint8 *src_y, const guint8 *src_c,
+		gint src_width, gint src_height, const gint *columns);
+
+#endif // GSTSHCOLORCONVERT_H
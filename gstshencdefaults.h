@@ -1,3 +1,32 @@
+/* ELEMENT */
+#define DEFAULT_QUEUE_DEPTH 3
+#define MAX_QUEUE_DEPTH 32
+#define DEFAULT_READ_AHEAD 1
+#define DEFAULT_DROP_POLICY "block"
+#define DEFAULT_LOW_LATENCY FALSE
+#define DEFAULT_POOL_SIZE 6
+#define MAX_POOL_SIZE 32
+#define OUTPUT_POOL_SIZE 16
+#define DEFAULT_OUTPUT_QUEUE_SIZE 8
+#define MAX_OUTPUT_QUEUE_SIZE 64
+#define DEFAULT_RTP FALSE
+#define DEFAULT_MTU 1400
+#define MIN_MTU 64
+#define MAX_MTU 65535
+#define DEFAULT_PT 96
+#define MIN_PT 96
+#define MAX_PT 127
+#define DEFAULT_SSRC 0
+#define DEFAULT_RATE_CONTROL "none"
+#define DEFAULT_TARGET_BITRATE 0
+#define DEFAULT_STATS_INTERVAL 0
+#define STATS_WINDOW 120
+#define DEFAULT_PRESET "none"
+#define VFR_FRAMERATE 300
+#define VFR_INTERVAL_WEIGHT 8
+#define DEFAULT_SCENE_CUT_THRESHOLD 0
+#define DEFAULT_SCENE_CUT_RESTART_GOP FALSE
+#define KEY_UNIT_MAX_ATTEMPTS 3
 /* COMMON */
 #define DEFAULT_WIDTH 0
 #define DEFAULT_HEIGHT 0
@@ -89,6 +118,7 @@
 #define DEFAULT_SAD_INTRA_BIAS 0
 #define DEFAULT_REGULARLY_INSERTED_I_TYPE 11
 #define DEFAULT_CALL_UNIT 1
+#define CALL_UNIT_NAL 1
 #define DEFAULT_USE_SLICE 0
 #define DEFAULT_SLICE_SIZE_MB 0
 #define DEFAULT_SLICE_SIZE_BIT 0
@@ -0,0 +1,178 @@
+/**
+ * Process-wide pool of initialized encoder contexts
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include "gstshencoderpool.h"
+
+/**
+ * \struct _encoder_pool_entry
+ * \var encoder The encoder context
+ * \var width Picture width the context was initialized with
+ * \var height Picture height the context was initialized with
+ * \var format Stream format the context was initialized with
+ * \var config Control file name or NULL
+ * \var in_use Whether an element is using the context
+ */
+typedef struct _encoder_pool_entry
+{
+	SHCodecs_Encoder *encoder;
+	gint width;
+	gint height;
+	SHCodecs_Format format;
+	gchar *config;
+	gboolean in_use;
+}encoder_pool_entry;
+
+/* All contexts, most recently released first */
+static GList *entries = NULL;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static gboolean
+encoder_pool_matches(encoder_pool_entry *entry, gint width, gint height, 
+		     SHCodecs_Format format, const gchar *config)
+{
+	return !entry->in_use && entry->width == width && 
+		entry->height == height && entry->format == format &&
+		(entry->config == config || 
+		 (entry->config && config && !strcmp(entry->config, config)));
+}
+
+static void
+encoder_pool_close(encoder_pool_entry *entry)
+{
+	shcodecs_encoder_close(entry->encoder);
+	g_free(entry->config);
+	g_free(entry);
+}
+
+SHCodecs_Encoder *
+encoder_pool_acquire(gint width, gint height, SHCodecs_Format format, 
+		     const gchar *config)
+{
+	GList *item;
+	encoder_pool_entry *entry;
+	SHCodecs_Encoder *encoder;
+
+	if (config && !*config)
+	{
+		config = NULL;
+	}
+
+	pthread_mutex_lock(&pool_mutex);
+	for (item = entries; item; item = item->next)
+	{
+		entry = (encoder_pool_entry *)item->data;
+		if (encoder_pool_matches(entry, width, height, format, config))
+		{
+			entry->in_use = TRUE;
+			pthread_mutex_unlock(&pool_mutex);
+			return entry->encoder;
+		}
+	}
+	pthread_mutex_unlock(&pool_mutex);
+
+	/* Initialization takes a while, don't block the other users */
+	encoder = shcodecs_encoder_init(width, height, format);
+	if (!encoder)
+	{
+		return NULL;
+	}
+
+	entry = g_new0(encoder_pool_entry, 1);
+	entry->encoder = encoder;
+	entry->width = width;
+	entry->height = height;
+	entry->format = format;
+	entry->config = g_strdup(config);
+	entry->in_use = TRUE;
+
+	pthread_mutex_lock(&pool_mutex);
+	entries = g_list_prepend(entries, entry);
+	pthread_mutex_unlock(&pool_mutex);
+
+	return encoder;
+}
+
+void
+encoder_pool_release(SHCodecs_Encoder *encoder, gboolean reusable)
+{
+	GList *item, *oldest;
+	encoder_pool_entry *entry;
+	guint idle;
+
+	pthread_mutex_lock(&pool_mutex);
+	for (item = entries; item; item = item->next)
+	{
+		entry = (encoder_pool_entry *)item->data;
+		if (entry->encoder == encoder)
+		{
+			break;
+		}
+	}
+
+	if (!item)
+	{
+		/* Not from the pool */
+		pthread_mutex_unlock(&pool_mutex);
+		shcodecs_encoder_close(encoder);
+		return;
+	}
+
+	if (!reusable)
+	{
+		/* Stopped in the middle of a stream */
+		entries = g_list_delete_link(entries, item);
+		pthread_mutex_unlock(&pool_mutex);
+		encoder_pool_close(entry);
+		return;
+	}
+
+	entry->in_use = FALSE;
+	entries = g_list_delete_link(entries, item);
+	entries = g_list_prepend(entries, entry);
+
+	idle = 0;
+	oldest = NULL;
+	for (item = entries; item; item = item->next)
+	{
+		if (!((encoder_pool_entry *)item->data)->in_use)
+		{
+			idle++;
+			oldest = item;
+		}
+	}
+
+	entry = NULL;
+	if (idle > ENCODER_POOL_MAX_IDLE)
+	{
+		entry = (encoder_pool_entry *)oldest->data;
+		entries = g_list_delete_link(entries, oldest);
+	}
+	pthread_mutex_unlock(&pool_mutex);
+
+	if (entry)
+	{
+		encoder_pool_close(entry);
+	}
+}
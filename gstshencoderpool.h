@@ -0,0 +1,60 @@
+/**
+ * Process-wide pool of initialized encoder contexts
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHENCODERPOOL_H
+#define  GSTSHENCODERPOOL_H
+
+#include <glib.h>
+#include <shcodecs/shcodecs_encoder.h>
+
+/** Number of idle encoder contexts kept open */
+#define ENCODER_POOL_MAX_IDLE 4
+
+/**
+ * Get an encoder context. An idle context initialized with the same 
+ * parameters is reused, otherwise a new one is initialized. Contexts set 
+ * up from a control file are only reused with the same control file, 
+ * as the file may leave some encoder parameters unset.
+ * \param width Picture width
+ * \param height Picture height
+ * \param format Stream format
+ * \param config Control file name, or NULL if the parameters are set 
+ * from the element properties
+ * \return the encoder or NULL if initialization failed
+ */
+SHCodecs_Encoder *encoder_pool_acquire(gint width, gint height, 
+				       SHCodecs_Format format, 
+				       const gchar *config);
+
+/**
+ * Return an encoder context to the pool. The encoder must not be running.
+ * libshcodecs has no call to reset a context, so only a context that has
+ * not been run or whose run ended cleanly at the end of the stream is 
+ * kept, the others are closed. The oldest idle context is closed if the 
+ * pool is full.
+ * \param encoder Encoder got from encoder_pool_acquire
+ * \param reusable FALSE if a run of the encoder was aborted
+ */
+void encoder_pool_release(SHCodecs_Encoder *encoder, gboolean reusable);
+
+#endif // GSTSHENCODERPOOL_H
@@ -0,0 +1,141 @@
+/**
+ * Encoder parameter presets
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <string.h>
+#include "gstshencpresets.h"
+
+static const enc_preset_param none[] =
+{
+	{ NULL, NULL }
+};
+
+/* Every frame goes out as soon as it is encoded. The picture is refreshed
+   with intra macroblocks instead of large periodic I frames, and frames
+   are never reordered or skipped. */
+static const enc_preset_param zero_latency_h264[] =
+{
+	{ "low-latency", "true" },
+	{ "queue-depth", "1" },
+	{ "i-vop-interval", "0" },
+	{ "intra-macroblock-refresh-cycle", "30" },
+	{ "ratecontrol-skip-enable", "0" },
+	{ "clip-ratecontrol-cpb-skipcheck-enable", "0" },
+	{ "ref-frame-num", "1" },
+	{ NULL, NULL }
+};
+
+/* low-latency is H.264 only, a VOP is pushed whole */
+static const enc_preset_param zero_latency_mpeg4[] =
+{
+	{ "queue-depth", "1" },
+	{ "i-vop-interval", "0" },
+	{ "intra-macroblock-refresh-cycle", "30" },
+	{ "ratecontrol-skip-enable", "0" },
+	{ "ratecontrol-vbv-skipcheck-enable", "0" },
+	{ "b-vop-num", "0" },
+	{ NULL, NULL }
+};
+
+/* Quality over speed and latency. Frames are never dropped, and key 
+   frames go to the scene cuts instead of the middle of a scene. */
+static const enc_preset_param archival_h264[] =
+{
+	{ "drop-policy", "block" },
+	{ "queue-depth", "8" },
+	{ "i-vop-interval", "300" },
+	{ "ratecontrol-skip-enable", "0" },
+	{ "search-time-fixed", "0" },
+	{ "weighted-q-mode", "1" },
+	{ "ref-frame-num", "2" },
+	{ "quant-min", "4" },
+	{ "scene-cut-threshold", "25" },
+	{ "scene-cut-restart-gop", "true" },
+	{ NULL, NULL }
+};
+
+static const enc_preset_param archival_mpeg4[] =
+{
+	{ "drop-policy", "block" },
+	{ "queue-depth", "8" },
+	{ "i-vop-interval", "300" },
+	{ "ratecontrol-skip-enable", "0" },
+	{ "search-time-fixed", "0" },
+	{ "weighted-q-mode", "1" },
+	{ "high-quality", "1" },
+	{ "use-ac-prediction", "1" },
+	{ "quant-min", "2" },
+	{ "scene-cut-threshold", "25" },
+	{ "scene-cut-restart-gop", "true" },
+	{ NULL, NULL }
+};
+
+/* The bitrate is kept under the cap by skipping frames and by following
+   downstream, and the stream recovers quickly from lost packets. */
+static const enc_preset_param streaming_h264[] =
+{
+	{ "rate-control", "aimd" },
+	{ "drop-policy", "drop-oldest" },
+	{ "i-vop-interval", "60" },
+	{ "ratecontrol-skip-enable", "1" },
+	{ "clip-ratecontrol-cpb-skipcheck-enable", "1" },
+	{ "clip-ratecontrol-cpb-buffer-mode", "1" },
+	{ "output-filler-enable", "0" },
+	{ NULL, NULL }
+};
+
+static const enc_preset_param streaming_mpeg4[] =
+{
+	{ "rate-control", "aimd" },
+	{ "drop-policy", "drop-oldest" },
+	{ "i-vop-interval", "60" },
+	{ "ratecontrol-skip-enable", "1" },
+	{ "ratecontrol-vbv-skipcheck-enable", "1" },
+	{ "ratecontrol-vbv-buffer-mode", "1" },
+	{ "error-resilience-mode", "1" },
+	{ "video-packet-size-mb", "64" },
+	{ NULL, NULL }
+};
+
+static const enc_preset presets[] =
+{
+	{ "none", none, none },
+	{ "zero-latency", zero_latency_h264, zero_latency_mpeg4 },
+	{ "archival", archival_h264, archival_mpeg4 },
+	{ "streaming", streaming_h264, streaming_mpeg4 },
+	{ NULL, NULL, NULL }
+};
+
+const enc_preset *
+enc_preset_find(const gchar *name)
+{
+	const enc_preset *preset;
+
+	for (preset = presets; preset->name; preset++)
+	{
+		if (!strcmp(preset->name, name))
+		{
+			return preset;
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,60 @@
+/**
+ * Encoder parameter presets
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHENCPRESETS_H
+#define  GSTSHENCPRESETS_H
+
+#include <glib.h>
+
+/**
+ * \struct _enc_preset_param gstshencpresets.h
+ * \var name Name of the element property
+ * \var value Property value as a string, see gst_value_deserialize()
+ */
+typedef struct _enc_preset_param
+{
+	const gchar *name;
+	const gchar *value;
+}enc_preset_param;
+
+/**
+ * \struct _enc_preset gstshencpresets.h
+ * \var name Name of the preset
+ * \var h264 Parameters for H.264, terminated by a NULL name
+ * \var mpeg4 Parameters for MPEG-4, terminated by a NULL name
+ */
+typedef struct _enc_preset
+{
+	const gchar *name;
+	const enc_preset_param *h264;
+	const enc_preset_param *mpeg4;
+}enc_preset;
+
+/**
+ * Find a preset by name
+ * \param name Name of the preset
+ * \return the preset or NULL if there is no such preset
+ */
+const enc_preset *enc_preset_find(const gchar *name);
+
+#endif // GSTSHENCPRESETS_H
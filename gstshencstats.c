@@ -0,0 +1,128 @@
+/**
+ * Per-frame encoder statistics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gstshencstats.h"
+
+enc_stats *
+enc_stats_new(void)
+{
+	return g_new0(enc_stats, 1);
+}
+
+void
+enc_stats_free(enc_stats *stats)
+{
+	g_free(stats);
+}
+
+guint64
+enc_stats_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (guint64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void
+enc_stats_add(enc_stats *stats, const enc_stats_record *record)
+{
+	guint count = g_atomic_int_get(&stats->count);
+
+	stats->records[count % ENC_STATS_SIZE] = *record;
+
+	// Published only after the record has been written
+	g_atomic_int_inc(&stats->count);
+}
+
+/**
+ * Compare two latencies for qsort
+ * \param a First latency
+ * \param b Second latency
+ */
+static int
+enc_stats_compare(const void *a, const void *b)
+{
+	guint la = *(const guint *)a;
+	guint lb = *(const guint *)b;
+
+	return la < lb ? -1 : la > lb;
+}
+
+void
+enc_stats_summarize(enc_stats *stats, guint window, enc_stats_summary *summary)
+{
+	enc_stats_record records[ENC_STATS_SIZE / 2];
+	guint latencies[ENC_STATS_SIZE / 2];
+	guint first, end, after, n, i, skip;
+	guint64 bytes = 0, busy = 0, span;
+
+	memset(summary, 0, sizeof(*summary));
+
+	end = g_atomic_int_get(&stats->count);
+	n = MIN(MIN(window, end), ENC_STATS_SIZE / 2);
+	first = end - n;
+
+	for (i = 0; i < n; i++)
+	{
+		records[i] = stats->records[(first + i) % ENC_STATS_SIZE];
+	}
+
+	/* The writer may have overwritten the oldest copied records 
+	   meanwhile, including the slot it is writing now */
+	after = g_atomic_int_get(&stats->count);
+	skip = 0;
+	if (after + 1 > first + ENC_STATS_SIZE)
+	{
+		skip = MIN(after + 1 - ENC_STATS_SIZE - first, n);
+	}
+
+	summary->frames = n - skip;
+	if (summary->frames == 0)
+	{
+		return;
+	}
+
+	for (i = skip; i < n; i++)
+	{
+		bytes += records[i].size;
+		busy += records[i].busy;
+		latencies[i - skip] = records[i].latency;
+	}
+
+	qsort(latencies, summary->frames, sizeof(guint), enc_stats_compare);
+	summary->latency_p50 = latencies[(summary->frames - 1) / 2];
+	summary->latency_p99 = latencies[(summary->frames - 1) * 99 / 100];
+
+	// The first frame only marks the start of the span
+	span = records[n - 1].output_time - records[skip].output_time;
+	if (summary->frames > 1 && span > 0)
+	{
+		summary->fps = (summary->frames - 1) * 1000000.0 / span;
+		summary->bitrate = (bytes - records[skip].size) * 8 * 1000000 / span;
+		summary->load = MIN((busy - records[skip].busy) / (gdouble)span, 1.0);
+	}
+}
@@ -0,0 +1,125 @@
+/**
+ * Per-frame encoder statistics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHENCSTATS_H
+#define  GSTSHENCSTATS_H
+
+#include <glib.h>
+
+/** Number of frame records kept */
+#define ENC_STATS_SIZE 256
+
+/** Frame types of the records */
+typedef enum
+{
+	ENC_STATS_FRAME_I,
+	ENC_STATS_FRAME_P,
+	ENC_STATS_FRAME_B
+}enc_stats_frame_type;
+
+/**
+ * \struct _enc_stats_record gstshencstats.h
+ * \var timestamp Timestamp of the frame in nanoseconds
+ * \var output_time Time the frame was encoded, enc_stats_now() microseconds
+ * \var size Size of the encoded frame in bytes
+ * \var type Frame type
+ * \var latency Microseconds from the input frame arriving to the output
+ * \var busy Microseconds the encoder spent on the frame
+ */
+typedef struct _enc_stats_record
+{
+	guint64 timestamp;
+	guint64 output_time;
+	guint size;
+	enc_stats_frame_type type;
+	guint latency;
+	guint busy;
+}enc_stats_record;
+
+/**
+ * \struct _enc_stats gstshencstats.h
+ * \brief Ring of the latest frame records. One thread adds records, any
+ * thread may summarize them without locking.
+ * \var records The records, the latest at (count - 1) % ENC_STATS_SIZE
+ * \var count Number of records ever added
+ */
+typedef struct _enc_stats
+{
+	enc_stats_record records[ENC_STATS_SIZE];
+	volatile gint count;
+}enc_stats;
+
+/**
+ * \struct _enc_stats_summary gstshencstats.h
+ * \var frames Number of frames summarized
+ * \var fps Frames per second
+ * \var bitrate Bits per second
+ * \var latency_p50 Median latency in microseconds
+ * \var latency_p99 99th percentile latency in microseconds
+ * \var load Share of the time the encoder was busy, 0.0-1.0
+ */
+typedef struct _enc_stats_summary
+{
+	guint frames;
+	gdouble fps;
+	guint bitrate;
+	guint latency_p50;
+	guint latency_p99;
+	gdouble load;
+}enc_stats_summary;
+
+/**
+ * Allocate the statistics
+ * \return the statistics
+ */
+enc_stats *enc_stats_new(void);
+
+/**
+ * Free the statistics
+ * \param stats The statistics
+ */
+void enc_stats_free(enc_stats *stats);
+
+/**
+ * Get a monotonic time for the records
+ * \return microseconds from an arbitrary point
+ */
+guint64 enc_stats_now(void);
+
+/**
+ * Add a frame record. May only be called from one thread.
+ * \param stats The statistics
+ * \param record The record
+ */
+void enc_stats_add(enc_stats *stats, const enc_stats_record *record);
+
+/**
+ * Summarize the latest frames
+ * \param stats The statistics
+ * \param window Maximum number of frames, at most ENC_STATS_SIZE / 2
+ * \param summary The summary
+ */
+void enc_stats_summarize(enc_stats *stats, guint window, 
+			 enc_stats_summary *summary);
+
+#endif // GSTSHENCSTATS_H
@@ -0,0 +1,255 @@
+/**
+ * Adaptive bitrate control policies
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <string.h>
+#include "gstshratecontrol.h"
+
+/** The lowest bitrate is this fraction of the target */
+#define MIN_BITRATE_DIVISOR 8
+
+/** Samples to wait after a decrease before the next one */
+#define DECREASE_HOLD 8
+
+/** Samples between two increases */
+#define INCREASE_PERIOD 30
+
+/** An increase adds this fraction of the target */
+#define INCREASE_DIVISOR 16
+
+/** QoS proportion above which downstream is considered late */
+#define QOS_LATE 1.05
+
+/**
+ * Keep the target bitrate and never skip
+ * \param rc The controller
+ * \param sample The sample
+ */
+static void
+rate_control_update_none(rate_control *rc, const rate_control_sample *sample)
+{
+	rc->bitrate = rc->target_bitrate;
+	rc->skip_interval = 0;
+}
+
+/**
+ * Additive increase, multiplicative decrease. The bitrate drops by a 
+ * quarter while the output queue is three quarters full or downstream is
+ * late, and creeps back up to the target when it isn't. Every second frame
+ * is skipped when the lowest bitrate is not enough.
+ * \param rc The controller
+ * \param sample The sample
+ */
+static void
+rate_control_update_aimd(rate_control *rc, const rate_control_sample *sample)
+{
+	gboolean congested;
+
+	congested = (sample->queue_size && 
+		     sample->queue_level * 4 >= sample->queue_size * 3) ||
+		sample->qos_proportion > QOS_LATE;
+
+	rc->hold++;
+
+	if (congested)
+	{
+		if (rc->bitrate <= rc->min_bitrate)
+		{
+			rc->skip_interval = 2;
+		}
+		else if (rc->hold >= DECREASE_HOLD)
+		{
+			rc->bitrate = MAX(rc->bitrate * 3 / 4, rc->min_bitrate);
+			rc->hold = 0;
+		}
+	}
+	else
+	{
+		rc->skip_interval = 0;
+		if (rc->hold >= INCREASE_PERIOD && rc->bitrate < rc->target_bitrate)
+		{
+			rc->bitrate = MIN(rc->bitrate + 
+					  rc->target_bitrate / INCREASE_DIVISOR,
+					  rc->target_bitrate);
+			rc->hold = 0;
+		}
+	}
+}
+
+static const rate_control_policy policies[] =
+{
+	{ "none", rate_control_update_none },
+	{ "aimd", rate_control_update_aimd },
+	{ NULL, NULL }
+};
+
+const rate_control_policy *
+rate_control_find_policy(const gchar *name)
+{
+	const rate_control_policy *policy;
+
+	for (policy = policies; policy->name; policy++)
+	{
+		if (!strcmp(policy->name, name))
+		{
+			return policy;
+		}
+	}
+	return NULL;
+}
+
+rate_control *
+rate_control_new(const rate_control_policy *policy, glong target_bitrate)
+{
+	rate_control *rc;
+
+	rc = g_new0(rate_control, 1);
+	rc->policy = policy;
+	rc->target_bitrate = target_bitrate;
+	rc->min_bitrate = target_bitrate / MIN_BITRATE_DIVISOR;
+	rc->bitrate = target_bitrate;
+
+	return rc;
+}
+
+void
+rate_control_free(rate_control *rc)
+{
+	g_free(rc);
+}
+
+gboolean
+rate_control_update(rate_control *rc, const rate_control_sample *sample)
+{
+	glong bitrate = rc->bitrate;
+
+	if (sample->target_bitrate > 0 && 
+	    sample->target_bitrate != rc->target_bitrate)
+	{
+		rc->target_bitrate = sample->target_bitrate;
+		rc->min_bitrate = sample->target_bitrate / MIN_BITRATE_DIVISOR;
+		rc->bitrate = MIN(rc->bitrate, rc->target_bitrate);
+	}
+
+	rc->policy->update(rc, sample);
+
+	return rc->bitrate != bitrate;
+}
+
+gboolean
+rate_control_skip_frame(rate_control *rc)
+{
+	rc->frames++;
+
+	return rc->skip_interval && rc->frames % rc->skip_interval == 0;
+}
+
+gboolean
+rate_control_write_sample(FILE *file, const rate_control_sample *sample)
+{
+	return fprintf(file, "%" G_GUINT64_FORMAT " %u %u %u %.3f %ld %d\n",
+		       sample->timestamp, sample->frame_bytes, 
+		       sample->queue_level, sample->queue_size,
+		       sample->qos_proportion, sample->target_bitrate,
+		       sample->skipped ? 1 : 0) > 0;
+}
+
+rate_control_sample *
+rate_control_read_trace(const gchar *filename, guint *count)
+{
+	FILE *file;
+	rate_control_sample *trace = NULL;
+	rate_control_sample sample;
+	guint allocated = 0;
+	gchar line[128];
+	gint skipped;
+
+	*count = 0;
+
+	file = fopen(filename, "r");
+	if (!file)
+	{
+		return NULL;
+	}
+
+	while (fgets(line, sizeof(line), file))
+	{
+		// Older traces have no skipped column, they only list encoded frames
+		skipped = 0;
+		if (sscanf(line, "%" G_GUINT64_FORMAT " %u %u %u %lf %ld %d",
+			   &sample.timestamp, &sample.frame_bytes, 
+			   &sample.queue_level, &sample.queue_size,
+			   &sample.qos_proportion, &sample.target_bitrate,
+			   &skipped) < 6)
+		{
+			break;
+		}
+		sample.skipped = skipped != 0;
+
+		if (*count == allocated)
+		{
+			allocated = MAX(allocated * 2, 256);
+			trace = g_renew(rate_control_sample, trace, allocated);
+		}
+		trace[(*count)++] = sample;
+	}
+
+	fclose(file);
+	return trace;
+}
+
+void
+rate_control_simulate(const rate_control_policy *policy, glong target_bitrate,
+		      const rate_control_sample *trace, guint count,
+		      glong *bitrates, gboolean *skips)
+{
+	rate_control *rc;
+	rate_control_sample sample;
+	guint i;
+
+	if (!count)
+	{
+		return;
+	}
+
+	rc = rate_control_new(policy, target_bitrate > 0 ? target_bitrate : 
+			      trace[0].target_bitrate);
+
+	for (i = 0; i < count; i++)
+	{
+		skips[i] = rate_control_skip_frame(rc);
+
+		// A frame skipped by the encoder has no encoded size to learn from
+		if (!trace[i].skipped)
+		{
+			sample = trace[i];
+			if (target_bitrate > 0)
+			{
+				sample.target_bitrate = target_bitrate;
+			}
+			rate_control_update(rc, &sample);
+		}
+		bitrates[i] = rc->bitrate;
+	}
+
+	rate_control_free(rc);
+}
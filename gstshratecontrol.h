@@ -0,0 +1,161 @@
+/**
+ * Adaptive bitrate control policies
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHRATECONTROL_H
+#define  GSTSHRATECONTROL_H
+
+#include <stdio.h>
+#include <glib.h>
+
+/**
+ * \struct _rate_control_sample gstshratecontrol.h
+ * \brief What the controller knows after each encoded frame. Skipped input
+ * frames get a sample too, so that a trace has one sample per input frame.
+ * \var timestamp Timestamp of the frame in nanoseconds
+ * \var frame_bytes Size of the encoded frame
+ * \var queue_level Number of encoded buffers waiting to be pushed
+ * \var queue_size Capacity of the output queue
+ * \var qos_proportion Latest QoS proportion from downstream, above 1.0 when
+ *      downstream is late. 0 if there has been no QoS event.
+ * \var target_bitrate Bitrate the application asks for
+ * \var skipped TRUE if the frame was skipped and not encoded
+ */
+typedef struct _rate_control_sample
+{
+	guint64 timestamp;
+	guint frame_bytes;
+	guint queue_level;
+	guint queue_size;
+	gdouble qos_proportion;
+	glong target_bitrate;
+	gboolean skipped;
+}rate_control_sample;
+
+typedef struct _rate_control rate_control;
+
+/**
+ * \struct _rate_control_policy gstshratecontrol.h
+ * \var name Name of the policy
+ * \var update Decides the bitrate and the frame skipping from a sample
+ */
+typedef struct _rate_control_policy
+{
+	const gchar *name;
+	void (*update)(rate_control *rc, const rate_control_sample *sample);
+}rate_control_policy;
+
+/**
+ * \struct _rate_control gstshratecontrol.h
+ * \var policy The policy making the decisions
+ * \var target_bitrate Highest bitrate used
+ * \var min_bitrate Lowest bitrate used before frames are skipped
+ * \var bitrate Bitrate decided by the policy
+ * \var skip_interval Every skip_interval'th frame is skipped, 0 for none
+ * \var frames Number of frames asked about skipping
+ * \var hold Number of samples since the bitrate was last changed
+ */
+struct _rate_control
+{
+	const rate_control_policy *policy;
+	glong target_bitrate;
+	glong min_bitrate;
+	glong bitrate;
+	guint skip_interval;
+	guint frames;
+	guint hold;
+};
+
+/**
+ * Find a policy by name
+ * \param name "none" or "aimd"
+ * \return the policy or NULL if there is no such policy
+ */
+const rate_control_policy *rate_control_find_policy(const gchar *name);
+
+/**
+ * Create a controller
+ * \param policy The policy
+ * \param target_bitrate Starting and highest bitrate
+ * \return the controller
+ */
+rate_control *rate_control_new(const rate_control_policy *policy, 
+			       glong target_bitrate);
+
+/**
+ * Free the controller
+ * \param rc The controller
+ */
+void rate_control_free(rate_control *rc);
+
+/**
+ * Feed the controller with the sample of an encoded frame
+ * \param rc The controller
+ * \param sample The sample
+ * \return TRUE if the bitrate changed
+ */
+gboolean rate_control_update(rate_control *rc, 
+			     const rate_control_sample *sample);
+
+/**
+ * Ask whether the next input frame is skipped. Called once for each frame.
+ * \param rc The controller
+ */
+gboolean rate_control_skip_frame(rate_control *rc);
+
+/**
+ * Append a sample to a trace file, one sample per line
+ * \param file The trace file
+ * \param sample The sample
+ * \return FALSE if the write failed
+ */
+gboolean rate_control_write_sample(FILE *file, 
+				   const rate_control_sample *sample);
+
+/**
+ * Read a trace file written with rate_control_write_sample()
+ * \param filename Name of the trace file
+ * \param count Number of samples read
+ * \return the samples, free with g_free(). NULL if the file can't be read.
+ */
+rate_control_sample *rate_control_read_trace(const gchar *filename, 
+					     guint *count);
+
+/**
+ * Run a policy over a recorded trace. The result only depends on the 
+ * policy and the trace, so policies can be compared offline. As in the 
+ * encoder, the skip decision is taken for each input frame, and the 
+ * frames that were encoded then feed the controller with their sample.
+ * \param policy The policy
+ * \param target_bitrate Starting and highest bitrate, overriding the 
+ * targets recorded in the trace. 0 follows the recorded targets.
+ * \param trace The samples
+ * \param count Number of samples
+ * \param bitrates Bitrate after each sample, count entries
+ * \param skips Whether the frame of each sample is skipped, count entries
+ */
+void rate_control_simulate(const rate_control_policy *policy, 
+			   glong target_bitrate,
+			   const rate_control_sample *trace, guint count,
+			   glong *bitrates, gboolean *skips);
+
+#endif // GSTSHRATECONTROL_H
@@ -0,0 +1,103 @@
+/**
+ * Replays a rate control trace offline
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+/*
+ * Usage: gstshratereplay TRACE [POLICY] [TARGET_BITRATE]
+ *
+ * TRACE is a file written by the encoder with rate-control-trace. The 
+ * policy ("aimd" by default) is run over the recorded samples and the 
+ * bitrate and the skip decision after each frame are printed, one line 
+ * per input frame. A target bitrate given here is used throughout, 
+ * otherwise the targets recorded in the trace are followed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gstshratecontrol.h"
+
+int
+main(int argc, char **argv)
+{
+	const rate_control_policy *policy;
+	rate_control_sample *trace;
+	glong target_bitrate;
+	glong *bitrates;
+	gboolean *skips;
+	guint count, skipped, i;
+
+	if (argc < 2 || argc > 4)
+	{
+		fprintf(stderr, "Usage: %s TRACE [POLICY] [TARGET_BITRATE]\n", 
+			argv[0]);
+		return 1;
+	}
+
+	policy = rate_control_find_policy(argc > 2 ? argv[2] : "aimd");
+	if (!policy)
+	{
+		fprintf(stderr, "Unknown policy %s\n", argv[2]);
+		return 1;
+	}
+
+	trace = rate_control_read_trace(argv[1], &count);
+	if (!trace)
+	{
+		fprintf(stderr, "Can't read %s or it has no samples\n", argv[1]);
+		return 1;
+	}
+
+	target_bitrate = argc > 3 ? atol(argv[3]) : 0;
+	if (target_bitrate <= 0 && trace[0].target_bitrate <= 0)
+	{
+		fprintf(stderr, "No target bitrate in %s, give one\n", argv[1]);
+		g_free(trace);
+		return 1;
+	}
+
+	bitrates = g_new(glong, count);
+	skips = g_new(gboolean, count);
+	rate_control_simulate(policy, target_bitrate, trace, count, 
+			      bitrates, skips);
+
+	skipped = 0;
+	printf("# frame timestamp bytes queue qos bitrate skip skipped-live\n");
+	for (i = 0; i < count; i++)
+	{
+		printf("%u %" G_GUINT64_FORMAT " %u %u/%u %.3f %ld %d %d\n", i,
+		       trace[i].timestamp, trace[i].frame_bytes, 
+		       trace[i].queue_level, trace[i].queue_size,
+		       trace[i].qos_proportion, bitrates[i], skips[i] ? 1 : 0,
+		       trace[i].skipped ? 1 : 0);
+		if (skips[i])
+		{
+			skipped++;
+		}
+	}
+	printf("# %u frames, %u skipped, final bitrate %ld\n", count, skipped,
+	       bitrates[count - 1]);
+
+	g_free(bitrates);
+	g_free(skips);
+	g_free(trace);
+	return 0;
+}
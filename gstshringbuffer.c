@@ -0,0 +1,144 @@
+/**
+ * Lock-free single producer / single consumer ring buffer. The producer
+ * may also pop to discard the oldest item.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include "gstshringbuffer.h"
+
+/** The low bits of the tail are the slot index, the high bits count the 
+    pops so that a tail that has wrapped around is not taken for the 
+    same tail */
+#define TAIL_INDEX_BITS 16
+
+#define TAIL_INDEX(tail) ((tail) & ((1 << TAIL_INDEX_BITS) - 1))
+
+/**
+ * Get the tail after a pop
+ * \param ring Pointer to the ring buffer
+ * \param tail The tail before the pop
+ * \return the next slot index with the pop count incremented
+ */
+static gint
+ring_buffer_next_tail(ring_buffer *ring, gint tail)
+{
+	guint count = ((guint)tail >> TAIL_INDEX_BITS) + 1;
+
+	return (gint)((count << TAIL_INDEX_BITS) | 
+		      ((TAIL_INDEX(tail) + 1) % ring->size));
+}
+
+ring_buffer *
+ring_buffer_new(guint capacity)
+{
+	ring_buffer *ring;
+
+	g_return_val_if_fail(capacity < (1 << TAIL_INDEX_BITS) - 1, NULL);
+
+	ring = g_new0(ring_buffer, 1);
+	ring->size = capacity + 1;
+	ring->slots = g_new0(gpointer, ring->size);
+	ring->head = 0;
+	ring->tail = 0;
+
+	return ring;
+}
+
+void
+ring_buffer_free(ring_buffer *ring)
+{
+	if (ring)
+	{
+		g_free(ring->slots);
+		g_free(ring);
+	}
+}
+
+gboolean
+ring_buffer_push(ring_buffer *ring, gpointer item)
+{
+	gint head, next;
+
+	head = g_atomic_int_get(&ring->head);
+	next = (head + 1) % ring->size;
+
+	if (next == TAIL_INDEX(g_atomic_int_get(&ring->tail)))
+	{
+		return FALSE;
+	}
+
+	ring->slots[head] = item;
+
+	/* Publish the slot only after it has been written */
+	g_atomic_int_set(&ring->head, next);
+
+	return TRUE;
+}
+
+gpointer
+ring_buffer_pop(ring_buffer *ring)
+{
+	gint tail;
+	gpointer item;
+
+	/* The producer may also pop to discard the oldest item, so the 
+	   tail is only moved if nobody else has moved it meanwhile. The pop 
+	   count in the tail makes the exchange fail also when the other 
+	   thread has popped the whole ring around to the same slot. */
+	do
+	{
+		tail = g_atomic_int_get(&ring->tail);
+
+		if (TAIL_INDEX(tail) == g_atomic_int_get(&ring->head))
+		{
+			return NULL;
+		}
+
+		item = ring->slots[TAIL_INDEX(tail)];
+	}
+	while (!g_atomic_int_compare_and_exchange(&ring->tail, tail, 
+				ring_buffer_next_tail(ring, tail)));
+
+	return item;
+}
+
+guint
+ring_buffer_get_fill_level(ring_buffer *ring)
+{
+	gint head, tail;
+
+	head = g_atomic_int_get(&ring->head);
+	tail = TAIL_INDEX(g_atomic_int_get(&ring->tail));
+
+	return (head - tail + ring->size) % ring->size;
+}
+
+guint
+ring_buffer_get_capacity(ring_buffer *ring)
+{
+	return ring->size - 1;
+}
+
+gboolean
+ring_buffer_is_full(ring_buffer *ring)
+{
+	return ring_buffer_get_fill_level(ring) == ring_buffer_get_capacity(ring);
+}
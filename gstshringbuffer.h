@@ -0,0 +1,93 @@
+/**
+ * Lock-free single producer / single consumer ring buffer. The producer
+ * may also pop to discard the oldest item.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHRINGBUFFER_H
+#define  GSTSHRINGBUFFER_H
+
+#include <glib.h>
+
+/**
+ * \struct _ring_buffer gstshringbuffer.h
+ * \var slots Storage for the queued pointers
+ * \var size Number of slots. One slot is always kept free.
+ * \var head Index of the next slot to write. Only moved by the producer.
+ * \var tail Index of the next slot to read in the low bits and the number
+ *      of pops in the high bits. Moved by whoever pops.
+ */
+typedef struct _ring_buffer
+{
+	gpointer *slots;
+	gint size;
+	volatile gint head;
+	volatile gint tail;
+}ring_buffer;
+
+/**
+ * Allocate a ring buffer
+ * \param capacity Maximum number of queued items, less than 65535
+ * \return the ring buffer
+ */
+ring_buffer *ring_buffer_new(guint capacity);
+
+/**
+ * Free the ring buffer. The queued items are not freed.
+ * \param ring Pointer to the ring buffer
+ */
+void ring_buffer_free(ring_buffer *ring);
+
+/**
+ * Append an item. May only be called from the producer thread.
+ * \param ring Pointer to the ring buffer
+ * \param item Item to append
+ * \return FALSE if the ring buffer is full
+ */
+gboolean ring_buffer_push(ring_buffer *ring, gpointer item);
+
+/**
+ * Remove the oldest item. May be called from the consumer thread and from 
+ * the producer thread at the same time, but not from two consumers.
+ * \param ring Pointer to the ring buffer
+ * \return the item or NULL if the ring buffer is empty
+ */
+gpointer ring_buffer_pop(ring_buffer *ring);
+
+/**
+ * Get the number of queued items
+ * \param ring Pointer to the ring buffer
+ */
+guint ring_buffer_get_fill_level(ring_buffer *ring);
+
+/**
+ * Get the maximum number of queued items
+ * \param ring Pointer to the ring buffer
+ */
+guint ring_buffer_get_capacity(ring_buffer *ring);
+
+/**
+ * Check whether a push would fail
+ * \param ring Pointer to the ring buffer
+ */
+gboolean ring_buffer_is_full(ring_buffer *ring);
+
+#endif // GSTSHRINGBUFFER_H
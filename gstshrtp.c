@@ -0,0 +1,298 @@
+/**
+ * RTP packetization of encoded H.264 and MPEG-4 video
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <string.h>
+
+#include "gstshrtp.h"
+#include "gstshbitstream.h"
+
+/** Aggregation and fragmentation NAL unit types of RFC 6184 */
+#define H264_NAL_STAP_A 24
+#define H264_NAL_FU_A 28
+
+/** Maximum number of NAL units in a STAP-A packet */
+#define STAP_A_MAX_NALS 8
+
+GstSHRtpPacketizer *
+gst_sh_rtp_packetizer_new(guint mtu, guint pt, guint32 ssrc)
+{
+	GstSHRtpPacketizer *rtp;
+
+	rtp = g_new0(GstSHRtpPacketizer, 1);
+	rtp->mtu = mtu;
+	rtp->pt = pt;
+	rtp->ssrc = ssrc;
+	rtp->seqnum_base = g_random_int_range(0, G_MAXUINT16);
+	rtp->seqnum = rtp->seqnum_base;
+	rtp->clock_base = g_random_int();
+	rtp->timestamp = rtp->clock_base;
+
+	return rtp;
+}
+
+void
+gst_sh_rtp_packetizer_free(GstSHRtpPacketizer *rtp)
+{
+	g_free(rtp);
+}
+
+/** 
+ * Update the RTP timestamp from the timestamp of an encoded unit. Units 
+ * without a timestamp use the previous one.
+ * \param rtp The packetizer
+ * \param unit The encoded unit
+ */
+static void
+gst_sh_rtp_set_timestamp(GstSHRtpPacketizer *rtp, GstBuffer *unit)
+{
+	if (GST_BUFFER_TIMESTAMP_IS_VALID(unit))
+	{
+		rtp->timestamp = rtp->clock_base + 
+			gst_util_uint64_scale_int(GST_BUFFER_TIMESTAMP(unit),
+						  RTP_VIDEO_CLOCK_RATE, GST_SECOND);
+	}
+}
+
+/** 
+ * Allocate a packet header and write the RTP header into it
+ * \param rtp The packetizer
+ * \param unit The encoded unit the packet is made of
+ * \param extra Number of payload bytes following the RTP header
+ * \param marker Value of the marker bit
+ * \return the header buffer
+ */
+static GstBuffer *
+gst_sh_rtp_new_header(GstSHRtpPacketizer *rtp, GstBuffer *unit, guint extra,
+		      gboolean marker)
+{
+	GstBuffer *header;
+	guint8 *p;
+
+	header = gst_buffer_new_and_alloc(RTP_HEADER_SIZE + extra);
+	gst_buffer_copy_metadata(header, unit, GST_BUFFER_COPY_FLAGS | 
+				 GST_BUFFER_COPY_TIMESTAMPS | 
+				 GST_BUFFER_COPY_CAPS);
+	p = GST_BUFFER_DATA(header);
+
+	p[0] = 0x80;		// Version 2, no padding, extension or CSRCs
+	p[1] = (marker ? 0x80 : 0) | rtp->pt;
+	GST_WRITE_UINT16_BE(p + 2, rtp->seqnum);
+	GST_WRITE_UINT32_BE(p + 4, rtp->timestamp);
+	GST_WRITE_UINT32_BE(p + 8, rtp->ssrc);
+
+	rtp->seqnum++;
+	return header;
+}
+
+/** 
+ * Find the next NAL unit of a byte stream
+ * \param pos Where to start looking, moved past the NAL unit
+ * \param end End of the data
+ * \param size Size of the NAL unit without trailing zero bytes
+ * \return the first byte of the NAL unit or NULL if there are no more
+ */
+static const guint8 *
+gst_sh_rtp_next_nal(const guint8 **pos, const guint8 *end, guint *size)
+{
+	const guint8 *nal;
+
+	do
+	{
+		nal = bitstream_find_start_code(*pos, end);
+		if (nal == end)
+		{
+			*pos = end;
+			return NULL;
+		}
+		nal += 3;
+		*pos = bitstream_find_start_code(nal, end);
+
+		// Drops the leading zero of a four byte start code
+		*size = *pos - nal;
+		while (*size && nal[*size - 1] == 0)
+		{
+			(*size)--;
+		}
+	}
+	while (!*size);
+
+	return nal;
+}
+
+/** 
+ * Check whether a NAL unit is aggregated into STAP-A packets
+ * \param nal The NAL unit
+ */
+static gboolean
+gst_sh_rtp_is_aggregated(const guint8 *nal)
+{
+	switch (nal[0] & 0x1f)
+	{
+		case H264_NAL_SEI:
+		case H264_NAL_SPS:
+		case H264_NAL_PPS:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+gboolean
+gst_sh_rtp_packetize_h264(GstSHRtpPacketizer *rtp, GstBuffer *unit,
+			  gboolean marker, GstSHRtpPacketFunc func,
+			  gpointer user_data)
+{
+	const guint8 *data = GST_BUFFER_DATA(unit);
+	const guint8 *end = data + GST_BUFFER_SIZE(unit);
+	const guint8 *pos = data;
+	const guint8 *nal;
+	const guint8 *next;
+	const guint8 *stap[STAP_A_MAX_NALS];
+	guint stap_size[STAP_A_MAX_NALS];
+	guint max = rtp->mtu - RTP_HEADER_SIZE;
+	guint size, next_size, count, total, offset, chunk, i;
+	guint8 nri;
+	gboolean last;
+	GstBuffer *header;
+	guint8 *p;
+
+	gst_sh_rtp_set_timestamp(rtp, unit);
+
+	nal = gst_sh_rtp_next_nal(&pos, end, &size);
+	while (nal)
+	{
+		next = gst_sh_rtp_next_nal(&pos, end, &next_size);
+
+		/* Gathers small headers that follow each other */
+		count = 0;
+		total = 1;
+		if (gst_sh_rtp_is_aggregated(nal))
+		{
+			stap[count] = nal;
+			stap_size[count++] = size;
+			total += 2 + size;
+			while (next && count < STAP_A_MAX_NALS && 
+			       gst_sh_rtp_is_aggregated(next) &&
+			       total + 2 + next_size <= max)
+			{
+				stap[count] = next;
+				stap_size[count++] = next_size;
+				total += 2 + next_size;
+				next = gst_sh_rtp_next_nal(&pos, end, &next_size);
+			}
+		}
+		last = marker && !next;
+
+		if (count > 1)
+		{
+			/* The headers are small, they are copied */
+			header = gst_sh_rtp_new_header(rtp, unit, total, last);
+			p = GST_BUFFER_DATA(header) + RTP_HEADER_SIZE;
+			nri = 0;
+			for (i = 0; i < count; i++)
+			{
+				nri = MAX(nri, stap[i][0] & 0x60);
+			}
+			*p++ = nri | H264_NAL_STAP_A;
+			for (i = 0; i < count; i++)
+			{
+				GST_WRITE_UINT16_BE(p, stap_size[i]);
+				memcpy(p + 2, stap[i], stap_size[i]);
+				p += 2 + stap_size[i];
+			}
+			if (!func(header, NULL, user_data))
+			{
+				return FALSE;
+			}
+		}
+		else if (size <= max)
+		{
+			header = gst_sh_rtp_new_header(rtp, unit, 0, last);
+			if (!func(header, gst_buffer_create_sub(unit, nal - data, size),
+				  user_data))
+			{
+				return FALSE;
+			}
+		}
+		else
+		{
+			/* FU-A fragments carry the NAL header in their own two
+			   bytes, the payload starts after it */
+			for (offset = 1; offset < size; offset += chunk)
+			{
+				chunk = MIN(size - offset, max - 2);
+				header = gst_sh_rtp_new_header(rtp, unit, 2, 
+						last && offset + chunk == size);
+				p = GST_BUFFER_DATA(header) + RTP_HEADER_SIZE;
+				p[0] = (nal[0] & 0x60) | H264_NAL_FU_A;
+				p[1] = nal[0] & 0x1f;
+				if (offset == 1)
+				{
+					p[1] |= 0x80;
+				}
+				if (offset + chunk == size)
+				{
+					p[1] |= 0x40;
+				}
+				if (!func(header, 
+					  gst_buffer_create_sub(unit, 
+								nal + offset - data,
+								chunk),
+					  user_data))
+				{
+					return FALSE;
+				}
+			}
+		}
+
+		nal = next;
+		size = next_size;
+	}
+	return TRUE;
+}
+
+gboolean
+gst_sh_rtp_packetize_mpeg4(GstSHRtpPacketizer *rtp, GstBuffer *unit,
+			   gboolean marker, GstSHRtpPacketFunc func,
+			   gpointer user_data)
+{
+	guint size = GST_BUFFER_SIZE(unit);
+	guint max = rtp->mtu - RTP_HEADER_SIZE;
+	guint offset, chunk;
+	GstBuffer *header;
+
+	gst_sh_rtp_set_timestamp(rtp, unit);
+
+	for (offset = 0; offset < size; offset += chunk)
+	{
+		chunk = MIN(size - offset, max);
+		header = gst_sh_rtp_new_header(rtp, unit, 0, 
+					       marker && offset + chunk == size);
+		if (!func(header, gst_buffer_create_sub(unit, offset, chunk),
+			  user_data))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
@@ -0,0 +1,117 @@
+/**
+ * RTP packetization of encoded H.264 and MPEG-4 video
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+#ifndef GSTSHRTP_H
+#define GSTSHRTP_H
+
+#include <gst/gst.h>
+
+/** Size of the fixed RTP header */
+#define RTP_HEADER_SIZE 12
+
+/** RTP clock rate of video payloads */
+#define RTP_VIDEO_CLOCK_RATE 90000
+
+typedef struct _GstSHRtpPacketizer GstSHRtpPacketizer;
+
+/**
+ * Called for each packet. The header buffer holds the RTP header and any 
+ * payload bytes that had to be written (FU-A headers, STAP-A). The payload
+ * is a sub-buffer of the encoded data or NULL.
+ * @param header The RTP header, owned by the callee
+ * @param payload The rest of the packet, owned by the callee. May be NULL.
+ * @param user_data User data given to the packetizer
+ * @return FALSE to stop packetizing
+ */
+typedef gboolean (*GstSHRtpPacketFunc)(GstBuffer *header, GstBuffer *payload,
+				       gpointer user_data);
+
+/**
+ * \struct _GstSHRtpPacketizer
+ * \var mtu Maximum size of a packet including the RTP header
+ * \var pt Payload type
+ * \var ssrc Synchronization source
+ * \var seqnum Sequence number of the next packet
+ * \var seqnum_base Sequence number of the first packet
+ * \var clock_base RTP timestamp of running time 0
+ * \var timestamp RTP timestamp of the latest packet
+ */
+struct _GstSHRtpPacketizer
+{
+	guint mtu;
+	guint pt;
+	guint32 ssrc;
+	guint16 seqnum;
+	guint16 seqnum_base;
+	guint32 clock_base;
+	guint32 timestamp;
+};
+
+/** 
+ * Create a packetizer. The sequence number and timestamp bases are random.
+ * @param mtu Maximum size of a packet including the RTP header
+ * @param pt Payload type
+ * @param ssrc Synchronization source
+ * @return the packetizer
+ */
+GstSHRtpPacketizer *gst_sh_rtp_packetizer_new(guint mtu, guint pt, 
+					      guint32 ssrc);
+
+/** 
+ * Free the packetizer
+ * @param rtp The packetizer
+ */
+void gst_sh_rtp_packetizer_free(GstSHRtpPacketizer *rtp);
+
+/** 
+ * Packetize an H.264 access unit in byte-stream format (RFC 6184). NAL 
+ * units that fit in a packet are sent as they are, larger ones are split
+ * into FU-A fragments. Consecutive parameter set and SEI NAL units are 
+ * aggregated into a STAP-A packet.
+ * @param rtp The packetizer
+ * @param unit The access unit. Packets get its timestamps and flags.
+ * @param marker Set the marker bit of the last packet
+ * @param func Called for each packet
+ * @param user_data Passed to func
+ * @return FALSE if func stopped the packetizing
+ */
+gboolean gst_sh_rtp_packetize_h264(GstSHRtpPacketizer *rtp, GstBuffer *unit,
+				   gboolean marker, GstSHRtpPacketFunc func,
+				   gpointer user_data);
+
+/** 
+ * Packetize MPEG-4 visual data (RFC 3016). The data is split into packets
+ * of at most the MTU, the configuration headers stay with the VOP that
+ * follows them.
+ * @param rtp The packetizer
+ * @param unit The VOP with any preceding headers. Packets get its 
+ * timestamps and flags.
+ * @param marker Set the marker bit of the last packet
+ * @param func Called for each packet
+ * @param user_data Passed to func
+ * @return FALSE if func stopped the packetizing
+ */
+gboolean gst_sh_rtp_packetize_mpeg4(GstSHRtpPacketizer *rtp, GstBuffer *unit,
+				    gboolean marker, GstSHRtpPacketFunc func,
+				    gpointer user_data);
+
+#endif //GSTSHRTP_H
@@ -0,0 +1,170 @@
+/**
+ * Scene cut detection on the luma plane of the encoder input
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gstshscenecut.h"
+
+scene_cut *
+scene_cut_new(void)
+{
+	return g_new0(scene_cut, 1);
+}
+
+void
+scene_cut_free(scene_cut *detector)
+{
+	g_free(detector);
+}
+
+void
+scene_cut_reset(scene_cut *detector)
+{
+	detector->has_thumb = FALSE;
+	detector->average = 0;
+	detector->distance = 0;
+}
+
+/**
+ * Sum of bytes. Four bytes are added at a time into two 16-bit lanes of a
+ * word, which holds up to 512 bytes without overflowing.
+ * \param p The bytes, no alignment needed
+ * \param n Number of bytes, at most 512
+ */
+static guint
+scene_cut_sum(const guint8 *p, gint n)
+{
+	guint32 word, lanes = 0;
+	guint sum;
+	gint i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		memcpy(&word, p + i, 4);
+		lanes += (word & 0x00ff00ff) + ((word >> 8) & 0x00ff00ff);
+	}
+	sum = (lanes & 0xffff) + (lanes >> 16);
+
+	for (; i < n; i++)
+	{
+		sum += p[i];
+	}
+	return sum;
+}
+
+/**
+ * Make a thumbnail of the luma plane. Each thumbnail pixel is the average
+ * of every other row of a span at the start of its block, so about a 
+ * quarter of the plane is read.
+ * \param thumb The thumbnail
+ * \param y Luma plane
+ * \param width Width of the plane
+ * \param height Height of the plane
+ */
+static void
+scene_cut_thumbnail(guint8 *thumb, const guint8 *y, gint width, gint height)
+{
+	gint span, rows, tx, ty, row, top;
+	guint sums[SCENE_CUT_THUMB_WIDTH];
+	const guint8 *line;
+
+	// Whole words where possible, the blocks are spread over the row
+	span = width / SCENE_CUT_THUMB_WIDTH;
+	if (span >= 4)
+	{
+		span = MIN(span & ~3, 512);
+	}
+	rows = (height / SCENE_CUT_THUMB_HEIGHT + 1) / 2;
+
+	for (ty = 0; ty < SCENE_CUT_THUMB_HEIGHT; ty++)
+	{
+		memset(sums, 0, sizeof(sums));
+		top = ty * height / SCENE_CUT_THUMB_HEIGHT;
+
+		for (row = 0; row < rows; row++)
+		{
+			line = y + (top + row * 2) * width;
+			for (tx = 0; tx < SCENE_CUT_THUMB_WIDTH; tx++)
+			{
+				sums[tx] += scene_cut_sum(
+					line + tx * width / SCENE_CUT_THUMB_WIDTH, span);
+			}
+		}
+
+		for (tx = 0; tx < SCENE_CUT_THUMB_WIDTH; tx++)
+		{
+			*thumb++ = sums[tx] / (span * rows);
+		}
+	}
+}
+
+gboolean
+scene_cut_detect(scene_cut *detector, const guint8 *y, gint width, 
+		 gint height, guint threshold)
+{
+	guint8 thumb[SCENE_CUT_THUMB_WIDTH * SCENE_CUT_THUMB_HEIGHT];
+	guint sad, difference, i;
+	gboolean cut;
+
+	if (width < SCENE_CUT_THUMB_WIDTH || height < SCENE_CUT_THUMB_HEIGHT)
+	{
+		return FALSE;
+	}
+
+	scene_cut_thumbnail(thumb, y, width, height);
+
+	// The first frame of a stream is a key frame anyway
+	if (!detector->has_thumb)
+	{
+		memcpy(detector->thumb, thumb, sizeof(thumb));
+		detector->has_thumb = TRUE;
+		return FALSE;
+	}
+
+	sad = 0;
+	for (i = 0; i < sizeof(thumb); i++)
+	{
+		sad += abs(thumb[i] - detector->thumb[i]);
+	}
+	memcpy(detector->thumb, thumb, sizeof(thumb));
+
+	// Mean absolute difference in 1/16 levels
+	difference = sad * 16 / sizeof(thumb);
+	detector->distance++;
+
+	/* Fast motion also makes large differences, but over many frames. 
+	   A cut stands out from the frames before it. */
+	cut = threshold && detector->distance >= SCENE_CUT_MIN_DISTANCE &&
+		difference >= threshold * 16 &&
+		difference >= detector->average * SCENE_CUT_RATIO;
+
+	if (cut)
+	{
+		detector->distance = 0;
+	}
+	else
+	{
+		detector->average = (detector->average * 7 + difference) / 8;
+	}
+	return cut;
+}
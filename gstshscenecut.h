@@ -0,0 +1,88 @@
+/**
+ * Scene cut detection on the luma plane of the encoder input
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHSCENECUT_H
+#define  GSTSHSCENECUT_H
+
+#include <glib.h>
+
+/** Size of the thumbnails the frames are compared on */
+#define SCENE_CUT_THUMB_WIDTH 64
+#define SCENE_CUT_THUMB_HEIGHT 48
+
+/** A cut needs a difference this many times the recent average */
+#define SCENE_CUT_RATIO 3
+
+/** Frames after a cut before the next one. Keeps flashes and fades from
+    producing a run of key frames. */
+#define SCENE_CUT_MIN_DISTANCE 5
+
+/**
+ * \struct _scene_cut gstshscenecut.h
+ * \var thumb Thumbnail of the previous frame
+ * \var has_thumb Whether thumb holds a frame
+ * \var average Running average of the difference between frames, in 1/16
+ *      of a level per pixel
+ * \var distance Frames since the latest cut
+ */
+typedef struct _scene_cut
+{
+	guint8 thumb[SCENE_CUT_THUMB_WIDTH * SCENE_CUT_THUMB_HEIGHT];
+	gboolean has_thumb;
+	guint average;
+	guint distance;
+}scene_cut;
+
+/**
+ * Allocate a detector
+ * \return the detector
+ */
+scene_cut *scene_cut_new(void);
+
+/**
+ * Free the detector
+ * \param detector The detector
+ */
+void scene_cut_free(scene_cut *detector);
+
+/**
+ * Forget the previous frames, e.g. at a new stream
+ * \param detector The detector
+ */
+void scene_cut_reset(scene_cut *detector);
+
+/**
+ * Compare a frame to the previous one
+ * \param detector The detector
+ * \param y Luma plane, rows of width bytes
+ * \param width Width of the frame. Frames narrower than SCENE_CUT_THUMB_WIDTH
+ *        or lower than SCENE_CUT_THUMB_HEIGHT are never cuts.
+ * \param height Height of the frame
+ * \param threshold Smallest mean absolute difference per pixel (0-255) 
+ *        taken as a cut
+ * \return TRUE if the frame starts a new scene
+ */
+gboolean scene_cut_detect(scene_cut *detector, const guint8 *y, 
+			  gint width, gint height, guint threshold);
+
+#endif // GSTSHSCENECUT_H
@@ -228,12 +228,25 @@ GST_DEBUG_CATEGORY_STATIC (gst_sh_mobile_debug);
  *   HW buffering makes zero copy functionality possible if gst-sh-mobile-sink
  *   element is connected to the src -pad. Possible values: "yes"/"no"/"auto". 
  *   Default: auto
+ * - "vpu-priority" (gint). Priority of the decoder on the VPU shared with 
+ *   the other decoder and encoder instances, 0-7. A frame of a higher 
+ *   priority instance is always decoded first. Default: 0
+ * - "vpu-weight" (guint). Share of the VPU relative to the instances of 
+ *   the same priority, 1-16. Default: 1
+ * - "vpu-load" (gdouble, read only). Share of the time the decoder had the
+ *   VPU during the last second
+ * - "vpu-deadline-misses" (guint, read only). Number of frames decoded 
+ *   later than one frame duration after the decoding was started
  */
 enum gstshvideodecproperties
 {
 	PROP_0,
 	PROP_MAX_BUFFER_SIZE,
 	PROP_HW_BUFFER,
+	PROP_VPU_PRIORITY,
+	PROP_VPU_WEIGHT,
+	PROP_VPU_LOAD,
+	PROP_VPU_DEADLINE_MISSES,
 	PROP_LAST
 };
 
@@ -414,6 +427,10 @@ gst_sh_video_dec_dispose (GObject * object)
 		GST_LOG_OBJECT (dec, "close decoder object %p", dec->decoder);
 		shcodecs_decoder_close (dec->decoder);
 	}
+
+	vpu_sched_client_free (dec->vpu);
+	dec->vpu = NULL;
+
 	G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -446,6 +463,36 @@ gst_sh_video_dec_class_init (GstSHVideoDecClass * klass)
 							      "Sets usage of HW buffers (auto(default)/yes/no)",
 							      NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+	g_object_class_install_property (gobject_class, PROP_VPU_PRIORITY,
+					 g_param_spec_int ("vpu-priority", 
+							   "VPU priority", 
+							   "Priority on the VPU shared with the other decoders and encoders", 
+							   0, VPU_SCHED_MAX_PRIORITY, 
+							   VPU_SCHED_DEFAULT_PRIORITY,
+							   G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (gobject_class, PROP_VPU_WEIGHT,
+					 g_param_spec_uint ("vpu-weight", 
+							    "VPU weight", 
+							    "Share of the VPU relative to the instances of the same priority", 
+							    1, VPU_SCHED_MAX_WEIGHT, 
+							    VPU_SCHED_DEFAULT_WEIGHT,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (gobject_class, PROP_VPU_LOAD,
+					 g_param_spec_double ("vpu-load", 
+							      "VPU load", 
+							      "Share of the time the decoder had the VPU", 
+							      0, 1, 0,
+							      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (gobject_class, PROP_VPU_DEADLINE_MISSES,
+					 g_param_spec_uint ("vpu-deadline-misses", 
+							    "VPU deadline misses", 
+							    "Number of frames decoded after their deadline", 
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
 }
 
 static void
@@ -474,6 +521,10 @@ gst_sh_video_dec_init (GstSHVideoDec * dec, GstSHVideoDecClass * gklass)
 	dec->buffer = NULL;
 	dec->buffer_size = DEFAULT_MAX_SIZE;
 
+	dec->vpu = vpu_sched_client_new();
+	dec->vpu_priority = VPU_SCHED_DEFAULT_PRIORITY;
+	dec->vpu_weight = VPU_SCHED_DEFAULT_WEIGHT;
+
 	pthread_mutex_init(&dec->mutex,NULL);
 	pthread_mutex_init(&dec->cond_mutex,NULL);
 	pthread_cond_init(&dec->thread_condition,NULL);
@@ -514,6 +565,20 @@ gst_sh_video_dec_set_property (GObject * object, guint prop_id,
 			}
 			break;
 		}
+		case PROP_VPU_PRIORITY:
+		{
+			dec->vpu_priority = g_value_get_int (value);
+			vpu_sched_client_set_share (dec->vpu, dec->vpu_priority, 
+						    dec->vpu_weight);
+			break;
+		}
+		case PROP_VPU_WEIGHT:
+		{
+			dec->vpu_weight = g_value_get_uint (value);
+			vpu_sched_client_set_share (dec->vpu, dec->vpu_priority, 
+						    dec->vpu_weight);
+			break;
+		}
 		default:
 		{
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -559,6 +624,32 @@ gst_sh_video_dec_get_property (GObject * object, guint prop_id,
 			}
 			break;
 		}
+		case PROP_VPU_PRIORITY:
+		{
+			g_value_set_int(value, dec->vpu_priority);
+			break;
+		}
+		case PROP_VPU_WEIGHT:
+		{
+			g_value_set_uint(value, dec->vpu_weight);
+			break;
+		}
+		case PROP_VPU_LOAD:
+		case PROP_VPU_DEADLINE_MISSES:
+		{
+			vpu_sched_stats stats;
+
+			vpu_sched_client_get_stats(dec->vpu, &stats);
+			if (prop_id == PROP_VPU_LOAD)
+			{
+				g_value_set_double(value, stats.load);
+			}
+			else
+			{
+				g_value_set_uint(value, stats.missed);
+			}
+			break;
+		}
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 	}
@@ -825,9 +916,15 @@ gst_sh_video_dec_decode (void *data)
 		GST_DEBUG_OBJECT(dec,"Input buffer size: %d",
 				 GST_BUFFER_SIZE (buffer));
 
+		/* One frame is decoded per call, it should be ready before 
+		   the next one is due */
+		vpu_sched_acquire(dec->vpu, dec->fps_numerator ? 
+				  vpu_sched_now() + (guint64)1000000 * 
+				  dec->fps_denominator / dec->fps_numerator : 0);
 		used_bytes = shcodecs_decode(dec->decoder,
 				GST_BUFFER_DATA (buffer),
 				GST_BUFFER_SIZE (buffer));
+		vpu_sched_release(dec->vpu);
 
 		GST_DEBUG_OBJECT(dec,"Used: %d",used_bytes);
 
@@ -856,7 +953,9 @@ gst_sh_video_dec_decode (void *data)
 		if(!dec->running)
 		{
 			GST_DEBUG_OBJECT(dec,"We are done, calling finalize.");
+			vpu_sched_acquire(dec->vpu, 0);
 			shcodecs_decoder_finalize(dec->decoder);
+			vpu_sched_release(dec->vpu);
 			GST_DEBUG_OBJECT(dec,
 					 "Stream finalized. Total decoded %d frames.",
 					 shcodecs_decoder_get_frame_count(dec->decoder));
@@ -881,6 +980,10 @@ gst_shcodecs_decoded_callback (SHCodecs_Decoder * decoder,
 
 	GST_LOG_OBJECT(dec,"%s called",__FUNCTION__);  
 
+	/* The frame is ready, the other instances may use the VPU while 
+	   we are pushing */
+	vpu_sched_release(dec->vpu);
+
 	if(dec->use_physical == HW_ADDR_YES)
 	{
 		GST_LOG_OBJECT(dec,"Using own buffer");  
@@ -42,6 +42,7 @@ typedef struct _GstSHVideoDec GstSHVideoDec;
 typedef struct _GstSHVideoDecClass GstSHVideoDecClass;
 
 #include <shcodecs/shcodecs_decoder.h>
+#include "gstshvpusched.h"
 
 /**
  * \struct _GstSHVideoDec gstshvideodec.h
@@ -63,6 +64,9 @@ typedef struct _GstSHVideoDecClass GstSHVideoDecClass;
  * \var mutex Mutex for the common data
  * \var cond_mutex Mutex for the conditional variable of the decoder thread
  * \var thread_condition Conditional variable of the decoder thread
+ * \var vpu Client of the VPU scheduler
+ * \var vpu_priority Priority on the VPU
+ * \var vpu_weight Share of the VPU within the priority
  */
 struct _GstSHVideoDec
 {
@@ -90,6 +94,10 @@ struct _GstSHVideoDec
 	pthread_mutex_t mutex;
 	pthread_mutex_t cond_mutex;
 	pthread_cond_t  thread_condition;
+
+	vpu_sched_client *vpu;
+	gint vpu_priority;
+	guint vpu_weight;
 };
 
 /**
@@ -38,6 +38,22 @@
  * used to convert the image data for the encoder. Again, filesink is used to
  * write the encoded video stream into a file.
  *
+ * \subsection enc-examples-conv Measuring the colour conversion
+ * \code
+ * time gst-launch videotestsrc num-buffers=500 ! video/x-raw-yuv, 
+ * format=(fourcc)I420, width=720, height=480 ! gst-sh-mobile-enc 
+ * stream-type=h264 ! fakesink
+ *
+ * time gst-launch videotestsrc num-buffers=500 ! video/x-raw-yuv, 
+ * format=(fourcc)I420, width=720, height=480 ! ffmpegcolorspace ! 
+ * video/x-raw-yuv, format=(fourcc)NV12 ! gst-sh-mobile-enc 
+ * stream-type=h264 ! fakesink
+ * \endcode
+ * The two lines encode the same frames, the first one using the conversion
+ * built into the encoder and the second one using ffmpegcolorspace. The 
+ * difference of the run times is the cost of the conversion. Replace I420 
+ * with YV12 or YUY2 to measure the other input formats.
+ *
  * \subsection enc-examples-3 Encoding from a webcam to network
  * \code
  * gst-launch v4l2src device=/dev/video0 ! image/jpeg, width=320, height=240,
@@ -48,6 +64,15 @@
  * in a file but sent over the network using udpsink -element. Before sending,
  * the video is packed into RTP frame using rtpmp4vpay -element.
  *
+ * \code
+ * gst-launch v4l2src device=/dev/video0 ! image/jpeg, width=320, height=240,
+ * framerate=15/1 ! jpegdec ! ffmpegcolorspace ! gst-sh-mobile-enc rtp=true
+ * ! udpsink host=192.168.10.10 port=5000 sync=false 
+ * \endcode
+ * The same without rtpmp4vpay. With rtp=true the encoder packetizes the 
+ * stream itself and the packets refer to the encoded data instead of 
+ * copying it.
+ *
  * The following line allows playback of the video in PC:
  * \code
  * gst-launch udpsrc port=5000 caps="application/x-rtp, clock-rate=90000"
@@ -55,6 +80,103 @@
  * height=240, framerate=15/1 ! ffdec_mpeg4 ! ffmpegcolorspace ! ximagesink 
  * \endcode
  * 
+ * \section enc-key-units Key units on demand
+ * A GstForceKeyUnit custom event, sent downstream into the sink pad or 
+ * upstream into the source pad, makes the encoder code the next frame as 
+ * an IDR frame / I-VOP. A downstream event applies to the first frame 
+ * after it, an upstream event to the next frame the encoder takes. The
+ * key frame is preceded by a downstream GstForceKeyUnit event carrying its
+ * timestamp. This allows a long i-vop-interval while new clients still get
+ * a key frame immediately. The key frame is forced with an I-VOP interval
+ * of one frame. Only an IDR frame or I-VOP found in the output answers the
+ * request, so an H.264 I frame coded without IDR is followed by further 
+ * forced frames, up to three. After that the event is sent with the next 
+ * sync point the encoder makes.
+ * 
+ * \section enc-live-changes Changing settings while encoding
+ * The bitrate, quant-min, quant-max and i-vop-interval properties can be 
+ * set while the stream is running. The new values are given to libshcodecs
+ * on the encoder thread between two frames, without restarting the 
+ * encoder. Whether the VPU middleware uses a value before the next stream
+ * depends on the middleware: only the bitrate is documented as changeable
+ * during a run, and it needs param-changeable=1. It is limited to 
+ * changeable-max-bitrate when that is set. The forced key frames, the 
+ * adaptive bitrate and the variable framerate support below rely on the 
+ * same calls.
+ * 
+ * \section enc-rate-control Adaptive bitrate
+ * With rate-control=aimd the bitrate follows downstream. After each encoded
+ * frame the controller looks at the output queue fill level, the latest QoS
+ * event from downstream and target-bitrate. It lowers the bitrate while 
+ * downstream can't keep up, skips every second frame if even the lowest 
+ * bitrate is too much, and returns to the target once downstream has 
+ * caught up. The policies are in gstshratecontrol.c. The controller 
+ * starts from target-bitrate, or bitrate, or with cntl-file the bitrate of
+ * the control file, and is off when none is known. The bitrate property
+ * keeps the value it was given. When rate-control-trace names a file, what the controller saw is written 
+ * there for each stream, and the gstshratereplay program replays it 
+ * offline with any policy:
+ * \code
+ * gstshratereplay rate.trace aimd 2000000
+ * \endcode
+ * 
+ * \section enc-presets Presets
+ * The preset property picks a table of parameters from gstshencpresets.c,
+ * with separate values for H.264 and MPEG-4. "zero-latency" pushes every 
+ * frame as soon as it is encoded, refreshes the picture with intra 
+ * macroblocks instead of periodic I frames and never reorders or skips 
+ * frames. "archival" trades speed and latency for quality, never drops
+ * frames and places key frames at scene cuts. "streaming" keeps the 
+ * bitrate under the cap with frame skipping and rate-control=aimd, and 
+ * recovers quickly from packet loss. The table
+ * is applied when the encoder is initialized. Properties set on the 
+ * element override the preset, and with cntl-file the control file 
+ * overrides the preset encoder parameters.
+ * 
+ * \section enc-simulcast Simulcast
+ * \code
+ * gst-launch v4l2src ! video/x-raw-yuv, format=(fourcc)NV12, width=640, 
+ * height=480 ! gst-sh-mobile-enc name=enc stream-type=h264 
+ * simulcast=320x240@256000 ! filesink location=main.264 
+ * enc.src_0 ! filesink location=preview.264
+ * \endcode
+ * Each src_%d request pad carries the profile with the same index in 
+ * simulcast. Every input frame is copied once per profile, downscaled 
+ * straight from the NV12 frame queued for the main stream into a buffer of
+ * the input pool of a child encoder with its own VPU context and encoder 
+ * thread. The child encoders get the stream-type, preset, rtp, 
+ * vpu-priority and vpu-weight of the element and the bitrate of their 
+ * profile. A child never blocks
+ * the main stream: it drops its newest frames with drop-policy 
+ * "drop-newest" and its oldest ones otherwise. Upstream events and the 
+ * element state are passed on to them. Request the pads after setting 
+ * simulcast. An invalid profile rejects the whole simulcast value.
+ * 
+ * \section enc-vpu Sharing the VPU
+ * All the encoder and decoder instances of the process take turns on the
+ * VPU, one frame at a time. An instance with a higher vpu-priority always
+ * goes first. Within a priority a frame that would otherwise be late goes
+ * first, and the rest of the VPU time is shared in proportion to 
+ * vpu-weight. For example a live preview decoder with vpu-priority=1 is 
+ * never held up by a background transcode at the default priority. 
+ * vpu-load and vpu-deadline-misses tell how much of the VPU the encoder 
+ * gets.
+ * 
+ * \section enc-scene-cuts Key frames at scene cuts
+ * With scene-cut-threshold set, every input frame is reduced to a 64x48 
+ * luma thumbnail and compared with the previous one before it is queued.
+ * A frame whose mean absolute difference reaches the threshold and is 
+ * several times the recent average starts a new scene and is encoded as a
+ * key frame, without the GstForceKeyUnit event of a requested key frame.
+ * Values around 25 catch hard cuts but not fast motion. With 
+ * scene-cut-restart-gop the element places the periodic key frames itself,
+ * i-vop-interval frames after the latest key frame of any kind, so a cut 
+ * pushes the next periodic key frame back instead of being followed by 
+ * one in the middle of the scene. This relies on libshcodecs taking a new
+ * I-VOP interval while encoding. If a forced key frame does not come out,
+ * the element warns and leaves the periodic key frames to the encoder at 
+ * i-vop-interval for the rest of the stream.
+ * 
  * \section enc-properties Properties
  * \copydoc gst_sh_video_enc_properties
  *
@@ -97,8 +219,11 @@
 #include <pthread.h>
 
 #include <gst/gst.h>
+#include <gst/video/video.h>
 
 #include "gstshvideoenc.h"
+#include "gstshcolorconvert.h"
+#include "gstshbitstream.h"
 #include "gstshencdefaults.h"
 #include "cntlfile/ControlFileUtil.h"
 
@@ -108,10 +233,19 @@
  * Direction: sink \n
  * Available: always \n
  * Caps:
- * - video/x-raw-yuv, format=(fourcc)NV12, width=(int)[48, 720], 
- *   height=(int)[48, 576], framerate=(fraction)[1, 25]
- * - video/x-raw-yuv, format=(fourcc)NV12, width=(int)[48, 720], 
- *   height=(int)[48, 480], framerate=(fraction)[1, 30]
+ * - video/x-raw-yuv, format=(fourcc){NV12, I420, YV12, YUY2}, 
+ *   width=(int)[48, 720], height=(int)[48, 576], framerate=(fraction)[0, 25]
+ * - video/x-raw-yuv, format=(fourcc){NV12, I420, YV12, YUY2}, 
+ *   width=(int)[48, 720], height=(int)[48, 480], framerate=(fraction)[0, 30]
+ *
+ * framerate=0/1 stands for variable framerate, see the framerate property.
+ *
+ * I420, YV12 and YUY2 frames are converted to NV12 by the encoder in the
+ * same pass that copies them to the encoder input memory.
+ *
+ * Padded frames are accepted with the optional caps fields rowstride=(int)
+ * and chroma-offset=(int), given in bytes. Rows wider than the frame are
+ * packed before encoding.
  */
 static GstStaticPadTemplate enc_sink_factory = 
 	GST_STATIC_PAD_TEMPLATE("sink",
@@ -119,13 +253,13 @@ static GstStaticPadTemplate enc_sink_factory =
 				 GST_PAD_ALWAYS,
 				 GST_STATIC_CAPS(
 						"video/x-raw-yuv, "
-						"format = (fourcc) NV12,"
+						"format = (fourcc) { NV12, I420, YV12, YUY2 },"
 						"width = (int) [48, 720],"
 						"height = (int) [48, 480]," 
 						"framerate = (fraction) [0, 30]"
 						";"
 						"video/x-raw-yuv, "
-						"format = (fourcc) NV12,"
+						"format = (fourcc) { NV12, I420, YV12, YUY2 },"
 						"width = (int) [48, 720],"
 						"height = (int) [48, 576]," 
 						"framerate = (fraction) [0, 25]"
@@ -140,45 +274,85 @@ static GstStaticPadTemplate enc_sink_factory =
  * Available: always \n
  * Caps:
  * - video/mpeg, width=(int)[48, 720], height=(int)[48, 576], 
- *   framerate=(fraction)[1, 25], mpegversion=(int)4
+ *   framerate=(fraction)[0, 25], mpegversion=(int)4
  * - video/mpeg, width=(int)[48, 720], height=(int)[48, 480], 
- *   framerate=(fraction)[1, 30], mpegversion=(int)4
+ *   framerate=(fraction)[0, 30], mpegversion=(int)4
  * - video/x-h264, width=(int)[48, 720], height=(int)[48, 576], 
- *   framerate=(fraction)[1, 25], h264version=(int)h264
+ *   framerate=(fraction)[0, 25], h264version=(int)h264, 
+ *   stream-format=(string){ byte-stream, avc }
  * - video/x-h264, width=(int)[48, 720], height=(int)[48, 480], 
- *   framerate=(fraction)[1, 30], h264version=(int)h264
+ *   framerate=(fraction)[0, 30], h264version=(int)h264, 
+ *   stream-format=(string){ byte-stream, avc }
+ * - application/x-rtp, media=(string)video, clock-rate=(int)90000,
+ *   encoding-name=(string){ H264, MP4V-ES }, payload=(int)[96, 127]
+ *
+ * The src caps get framerate=0/1 when the input is variable framerate.
+ *
+ * The stream-format is byte-stream unless downstream only accepts avc. 
+ * With avc the NAL units are prefixed with their length instead of a start
+ * code and the SPS and PPS are only carried in codec_data. MPEG-4 caps get 
+ * the VOS and VOL headers, without the GOV, as codec_data. Caps with 
+ * codec_data are set on the first buffer after the headers have been 
+ * encoded, and again only if the headers change. The RTP caps get 
+ * sprop-parameter-sets and profile-level-id (H.264) or config and 
+ * profile-level-id (MPEG-4) in the same way. They are set whatever caps 
+ * downstream returns, so rtp=true works with udpsink and filesink.
  */
+#define ENC_SRC_CAPS \
+	"video/mpeg," \
+	"width  = (int) [48, 720]," \
+	"height = (int) [48, 576]," \
+	"framerate = (fraction) [0, 25]," \
+	"mpegversion = (int) 4" \
+	";" \
+	"video/mpeg," \
+	"width  = (int) [48, 720]," \
+	"height = (int) [48, 480]," \
+	"framerate = (fraction) [0, 30]," \
+	"mpegversion = (int) 4" \
+	"; " \
+	"video/x-h264," \
+	"width  = (int) [48, 720]," \
+	"height = (int) [48, 576]," \
+	"framerate = (fraction) [0, 25]," \
+	"variant = (string) itu," \
+	"h264version = (string) h264," \
+	"stream-format = (string) { byte-stream, avc }" \
+	"; " \
+	"video/x-h264," \
+	"width  = (int) [48, 720]," \
+	"height = (int) [48, 480]," \
+	"framerate = (fraction) [0, 30]," \
+	"variant = (string) itu," \
+	"h264version = (string) h264," \
+	"stream-format = (string) { byte-stream, avc }" \
+	"; " \
+	"application/x-rtp," \
+	"media = (string) video," \
+	"clock-rate = (int) 90000," \
+	"encoding-name = (string) { H264, MP4V-ES }," \
+	"payload = (int) [96, 127]"
+
 static GstStaticPadTemplate enc_src_factory = 
 	GST_STATIC_PAD_TEMPLATE("src",
 				 GST_PAD_SRC,
 				 GST_PAD_ALWAYS,
-				 GST_STATIC_CAPS(
-						"video/mpeg,"
-						"width  = (int) [48, 720],"
-						"height = (int) [48, 576],"
-						"framerate = (fraction) [0, 25],"
-						"mpegversion = (int) 4"
-						";"
-						"video/mpeg,"
-						"width  = (int) [48, 720],"
-						"height = (int) [48, 480],"
-						"framerate = (fraction) [0, 30],"
-						"mpegversion = (int) 4"
-						"; "
-						"video/x-h264,"
-						"width  = (int) [48, 720],"
-						"height = (int) [48, 576],"
-						"framerate = (fraction) [0, 25],"
-						"variant = (string) itu,"
-						"h264version = (string) h264"
-						"; "
-						"video/x-h264,"
-						"width  = (int) [48, 720],"
-						"height = (int) [48, 480],"
-						"framerate = (fraction) [0, 30],"
-						"variant = (string) itu,"
-						"h264version = (string) h264"
-						)
+				 GST_STATIC_CAPS(ENC_SRC_CAPS)
+				 );
+
+/**
+ * \var enc_request_src_factory
+ * Name: src_%d \n
+ * Direction: src \n
+ * Available: on request \n
+ * Caps: as for src. One pad per simulcast profile, src_0 carries the first
+ * profile.
+ */
+static GstStaticPadTemplate enc_request_src_factory = 
+	GST_STATIC_PAD_TEMPLATE("src_%d",
+				 GST_PAD_SRC,
+				 GST_PAD_REQUEST,
+				 GST_STATIC_CAPS(ENC_SRC_CAPS)
 				 );
 
 GST_DEBUG_CATEGORY_STATIC(gst_sh_mobile_debug);
@@ -204,16 +378,97 @@ static GstElementClass *parent_class = NULL;
  *   be determined from the stream). 
  * - "framerate" (long). The framerate of the video stream multiplied by 10 (0-300).
  *   Default: 0 (An error message will display if the property is not set or 
- *   can not be determined from the stream).
+ *   can not be determined from the stream). Fractional caps framerates 
+ *   are rounded to the nearest tenth. Only framerate=0/1 caps make the 
+ *   input variable framerate, a framerate of 0 otherwise is an error. With
+ *   variable framerate the bitrate given to the encoder follows the average
+ *   interval of the frame timestamps, and param-changeable is set to 1.
  * - "bitrate" (long). The bitrate of the video stream (0-10000000). 
- *   Default: 384000 for mpeg4 and 2000000 for h264
+ *   Default: 384000 for mpeg4 and 2000000 for h264. Can be changed while
+ *   encoding, see enc-live-changes.
  * - "i-vop-interval" (long). Interval of intra-coded video object planes. 
- *   Default: 30
+ *   Default: 30. Can be changed while encoding, see enc-live-changes.
  * - "noise-reduction" (long). For motion-compensated macroblocks, a difference
  *    equal to or smaller than this setting is treated as 0 for encoding (0-4).
  *    Default: 0.
  * - "weighted-q-mode" (long). Used to specify whether weighted quantization for 
  *   encoding is used or not (0/1). Default: 0.
+ * - "queue-depth" (uint). Number of raw frames that can wait for the encoder
+ *   before the upstream element is blocked (1-32). A change takes effect
+ *   when the encoder is next initialized. Default: 3.
+ * - "queue-level" (uint). Read-only. Number of raw frames currently waiting
+ *   for the encoder.
+ * - "read-ahead" (uint). Number of frames fetched with one request in pull
+ *   mode (1-32). Up to queue-depth frames are kept prefetched. Default: 1.
+ * - "pool-size" (uint). Number of frame buffers the sink pad can hand out to
+ *   upstream elements (0-32). 0 disables the pool. Default: 6.
+ * - "drop-policy" (string). What to do with a new frame when the input queue
+ *   is full ("block"/"drop-oldest"/"drop-newest"). "block" waits for the 
+ *   encoder, the other two drop a frame and post a QoS message. 
+ *   Default: "block".
+ * - "frames-dropped" (uint). Read-only. Number of frames dropped because the
+ *   input queue was full or skipped by the rate controller.
+ * - "frames-encoded" (uint). Read-only. Number of encoded frames pushed.
+ * - "output-queue-size" (uint). Number of encoded buffers that can wait to be
+ *   pushed downstream (1-64). Default: 8.
+ * - "output-queue-high-water" (uint). Read-only. Largest number of encoded 
+ *   buffers that have been waiting at the same time. A value close to 
+ *   output-queue-size means that downstream is slower than the encoder.
+ * - "low-latency" (boolean). H.264 only, ignored for MPEG-4. Each slice is
+ *   pushed downstream as soon as it is encoded and the source caps get 
+ *   alignment=nal. Sets call-unit to one NAL unit, turns use-slice on and,
+ *   unless slice-size-mb or slice-size-bit is given, uses one macroblock 
+ *   row per slice. This also overrides a cntl-file. If the encoder does 
+ *   not accept the settings, the mode is off. Default: FALSE.
+ * - "rtp" (boolean). Packetize the stream into RTP packets (RFC 6184 for 
+ *   H.264, RFC 3016 for MPEG-4) and output application/x-rtp. Default: FALSE.
+ * - "mtu" (uint). Maximum size of an RTP packet (64-65535). Default: 1400.
+ * - "pt" (uint). RTP payload type (96-127). Default: 96.
+ * - "ssrc" (uint). RTP synchronization source. 0 picks a random one. 
+ *   Default: 0.
+ * - "rate-control" (string). Adaptive bitrate policy ("none"/"aimd"). 
+ *   Default: "none".
+ * - "target-bitrate" (long). Highest bitrate the rate controller uses. 
+ *   Can be changed while encoding, see enc-live-changes. 0 uses bitrate. 
+ *   Default: 0.
+ * - "rate-control-trace" (string). File where the rate controller input is
+ *   recorded, one line per input frame, skipped frames included. Rewritten
+ *   for each stream. Default: none.
+ * - "stats-fps" (double). Read-only. Encoded frames per second over the 
+ *   latest 120 frames.
+ * - "stats-bitrate" (uint). Read-only. Output bits per second over the 
+ *   latest 120 frames.
+ * - "stats-latency-p50", "stats-latency-p99" (uint). Read-only. Median and
+ *   99th percentile of the time from a raw frame entering the input queue 
+ *   to its encoded frame being queued for pushing, in microseconds.
+ * - "stats-encoder-load" (double). Read-only. Share of the time the 
+ *   encoder is busy (0.0-1.0). Close to 1.0 the encoder is saturated.
+ * - "stats-interval" (uint). Milliseconds between GstSHVideoEncStats 
+ *   element messages carrying the statistics above. 0 disables the 
+ *   messages. Default: 0.
+ * - "preset" (string). Parameter set for a use case 
+ *   ("none"/"zero-latency"/"archival"/"streaming"), see enc-presets.
+ *   Default: "none".
+ * - "simulcast" (string). Output profiles of the src_%d request pads, 
+ *   comma separated WIDTHxHEIGHT@BITRATE items, at most 4. See 
+ *   enc-simulcast. Default: none.
+ * - "vpu-priority" (int). Priority of the encoder on the VPU shared with 
+ *   the other encoder and decoder instances, 0-7. A frame of a higher 
+ *   priority instance is always encoded first. Default: 0.
+ * - "vpu-weight" (uint). Share of the VPU relative to the instances of 
+ *   the same priority, 1-16. Default: 1.
+ * - "vpu-load" (double, read only). Share of the time the encoder had the 
+ *   VPU during the last second (0.0-1.0).
+ * - "vpu-deadline-misses" (uint, read only). Number of frames encoded 
+ *   later than one frame duration after they arrived.
+ * - "scene-cut-threshold" (uint). Mean absolute luma difference to the 
+ *   previous frame (0-255) from which a frame is taken as a scene cut and 
+ *   encoded as a key frame, see enc-scene-cuts. 0 disables the detection.
+ *   Default: 0.
+ * - "scene-cut-restart-gop" (boolean). Count i-vop-interval from the 
+ *   latest key frame, so that a scene cut pushes back the next periodic 
+ *   key frame. Falls back to the encoder's own interval if forced key 
+ *   frames don't come out. Default: false.
  */
 enum gst_sh_video_enc_properties
 {
@@ -322,9 +577,69 @@ enum gst_sh_video_enc_properties
 	PROP_OUT_VUI_PARAMETERS,
 	PROP_CHROMA_QP_INDEX_OFFSET,
 	PROP_CONSTRAINED_INTRA_PRED,
+	/* ELEMENT */
+	PROP_QUEUE_DEPTH,
+	PROP_QUEUE_LEVEL,
+	PROP_READ_AHEAD,
+	PROP_POOL_SIZE,
+	PROP_DROP_POLICY,
+	PROP_FRAMES_DROPPED,
+	PROP_FRAMES_ENCODED,
+	PROP_LOW_LATENCY,
+	PROP_OUTPUT_QUEUE_SIZE,
+	PROP_OUTPUT_QUEUE_HIGH_WATER,
+	PROP_RTP,
+	PROP_MTU,
+	PROP_PT,
+	PROP_SSRC,
+	PROP_RATE_CONTROL,
+	PROP_TARGET_BITRATE,
+	PROP_RATE_CONTROL_TRACE,
+	PROP_STATS_FPS,
+	PROP_STATS_BITRATE,
+	PROP_STATS_LATENCY_P50,
+	PROP_STATS_LATENCY_P99,
+	PROP_STATS_ENCODER_LOAD,
+	PROP_STATS_INTERVAL,
+	PROP_PRESET,
+	PROP_SIMULCAST,
+	PROP_VPU_PRIORITY,
+	PROP_VPU_WEIGHT,
+	PROP_VPU_LOAD,
+	PROP_VPU_DEADLINE_MISSES,
+	PROP_SCENE_CUT_THRESHOLD,
+	PROP_SCENE_CUT_RESTART_GOP,
 	PROP_LAST
 };
 
+enum
+{
+	DROP_POLICY_BLOCK,
+	DROP_POLICY_OLDEST,
+	DROP_POLICY_NEWEST
+};
+
+#define DROP_POLICY_NAME_BLOCK "block"
+#define DROP_POLICY_NAME_OLDEST "drop-oldest"
+#define DROP_POLICY_NAME_NEWEST "drop-newest"
+
+enum
+{
+	STREAM_FORMAT_BYTE_STREAM,
+	STREAM_FORMAT_AVC
+};
+
+/* Settings changed while encoding */
+enum
+{
+	CHANGE_BITRATE = 1 << 0,
+	CHANGE_QUANT = 1 << 1,
+	CHANGE_I_VOP_INTERVAL = 1 << 2
+};
+
+#define STREAM_FORMAT_NAME_BYTE_STREAM "byte-stream"
+#define STREAM_FORMAT_NAME_AVC "avc"
+
 #define STREAM_TYPE_H264 "h264"
 #define STREAM_TYPE_MPEG4 "mpeg4"
 #define STREAM_TYPE_NONE ""
@@ -402,6 +717,22 @@ static gboolean	gst_sh_video_enc_activate_pull(GstPad *pad, gboolean active);
  */
 static GstFlowReturn gst_sh_video_enc_chain(GstPad *pad, GstBuffer *buffer);
 
+/** 
+ * Buffer allocation for upstream elements. Raw frames are allocated from
+ * the encoder input pool, so that they can be encoded without copying and 
+ * the memory is recycled when upstream is done with it.
+ * @param pad Gstreamer sink pad
+ * @param offset Offset of the buffer
+ * @param size Requested size of the buffer
+ * @param caps Caps of the buffer
+ * @param buf Allocated buffer
+ * @return returns GST_FLOW_OK, buf is NULL if the default allocation 
+ * should be used
+ */
+static GstFlowReturn gst_sh_video_enc_buffer_alloc(GstPad *pad, 
+				guint64 offset, guint size, GstCaps *caps, 
+				GstBuffer **buf);
+
 /** 
  * The encoder sink pad task
  * @param enc Gstreamer SH video encoder
@@ -430,13 +761,113 @@ static void gst_sh_video_enc_get_property(GObject * object, guint prop_id,
 					  GValue * value, GParamSpec * pspec);
 
 /** 
- * The encoder sink event handler and calls sink pad push event
+ * The encoder sink event handler. Serialized events are queued behind the
+ * encoded data, a flush stops the encoder and drops the queued data.
  * @param pad Gstreamer sink pad
  * @param event Event information
  * @return Returns the value of gst_pad_push_event()
  */
 static gboolean gst_sh_video_enc_sink_event(GstPad * pad, GstEvent * event);
 
+/** 
+ * The encoder source event handler. Takes the key unit requests, the other
+ * events go upstream.
+ * @param pad Gstreamer source pad
+ * @param event Event information
+ * @return Returns the value of gst_pad_event_default()
+ */
+static gboolean gst_sh_video_enc_src_event(GstPad * pad, GstEvent * event);
+
+/** 
+ * Marks a setting to be given to a running encoder before its next frame.
+ * Does nothing if the encoder has not been created yet, the setting is
+ * then used when it is initialized.
+ * @param enc Gstreamer SH video encoder
+ * @param change The CHANGE_* flag of the setting
+ */
+static void gst_sh_video_enc_request_change(GstSHVideoEnc *enc, gint change);
+
+/** 
+ * Gives the settings changed since the previous frame to the encoder. 
+ * Called on the encoder thread between frames.
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_apply_changes(GstSHVideoEnc *enc);
+
+/** 
+ * Feeds the rate controller with an encoded frame and passes a new bitrate
+ * on to the encoder
+ * @param enc Gstreamer SH video encoder
+ * @param timestamp Timestamp of the encoded frame
+ * @param size Size of the encoded frame in bytes
+ */
+static void gst_sh_video_enc_update_rate_control(GstSHVideoEnc *enc,
+						 GstClockTime timestamp,
+						 guint size);
+
+/** 
+ * Fills in what the rate controller knows about a frame and appends it to 
+ * the rate control trace
+ * @param enc Gstreamer SH video encoder
+ * @param sample The sample to fill in
+ * @param timestamp Timestamp of the frame
+ * @param size Size of the encoded frame in bytes, 0 if it was skipped
+ * @param skipped TRUE if the rate controller skipped the frame
+ */
+static void gst_sh_video_enc_rate_sample(GstSHVideoEnc *enc,
+					 rate_control_sample *sample,
+					 GstClockTime timestamp, guint size,
+					 gboolean skipped);
+
+/** 
+ * Adds the record of an encoded frame to the statistics and posts the
+ * statistics message when it is due
+ * @param enc Gstreamer SH video encoder
+ * @param timestamp Timestamp of the encoded frame
+ * @param size Size of the encoded frame in bytes
+ * @param type Frame type
+ */
+static void gst_sh_video_enc_record_stats(GstSHVideoEnc *enc, 
+					  GstClockTime timestamp, guint size,
+					  enc_stats_frame_type type);
+
+/** 
+ * Gets the type of an encoded frame for the statistics
+ * @param enc Gstreamer SH video encoder
+ * @param buffer The encoded frame
+ * @param sync_point TRUE for an IDR frame or I-VOP
+ * @return The frame type
+ */
+static enc_stats_frame_type gst_sh_video_enc_frame_type(GstSHVideoEnc *enc,
+							GstBuffer *buffer,
+							gboolean sync_point);
+
+/** 
+ * Records a complete encoded frame in the statistics and the rate 
+ * controller
+ * @param enc Gstreamer SH video encoder
+ * @param timestamp Timestamp of the encoded frame
+ * @param size Size of the encoded frame in bytes
+ * @param type Frame type
+ */
+static void gst_sh_video_enc_count_frame(GstSHVideoEnc *enc, 
+					 GstClockTime timestamp, guint size,
+					 enc_stats_frame_type type);
+
+/** 
+ * Counts the frame whose slices were pushed one by one in low latency 
+ * mode. Called once the encoder has finished the frame.
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_finish_slices(GstSHVideoEnc *enc);
+
+/** 
+ * Checks whether an event is a GstForceKeyUnit request
+ * @param event Event information
+ * @return TRUE for a key unit request
+ */
+static gboolean gst_sh_video_enc_is_force_key_unit(GstEvent * event);
+
 /** 
  * Gstreamer source pad query 
  * @param pad Gstreamer source pad
@@ -466,442 +897,905 @@ static int gst_sh_video_enc_write_output(SHCodecs_Encoder * encoder,
 					void *user_data);
 
 /** 
- * GStreamer state handling. We need this for pausing the encoder.
- * @param element GStreamer element
- * @param transition Flag indicating which transition to handle
- * @return GST_STATE_CHANGE_SUCCESS if everything is ok. Otherwise
- *         GST_STATE_CHANGE_FAILURE
+ * Remembers the timing of a frame given to the encoder. Called from the 
+ * encoder thread only.
+ * @param enc Gstreamer SH video encoder
+ * @param frame The frame given to the encoder
  */
-static GstStateChangeReturn
-gst_sh_video_enc_change_state(GstElement *element, GstStateChange transition);
+static void gst_sh_video_enc_store_frame_info(GstSHVideoEnc *enc, 
+					      GstSHVideoEncFrame *frame);
 
+/** 
+ * Sets the timestamp, duration and flags of an encoded frame from the input
+ * frame it was encoded from. Timestamps are presentation timestamps; for 
+ * B-VOP streams the push order is the decoding order.
+ * @param enc Gstreamer SH video encoder
+ * @param buffer The encoded frame
+ */
+static void gst_sh_video_enc_stamp_output(GstSHVideoEnc *enc, 
+					  GstBuffer *buffer);
 
-static void
-gst_sh_video_enc_init_class(gpointer g_class, gpointer data)
-{
-	parent_class = g_type_class_peek_parent(g_class);
-	gst_sh_video_enc_class_init((GstSHVideoEncClass *)g_class);
-}
+/** 
+ * Starts the source pad push task and the encoder thread
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_start_threads(GstSHVideoEnc *enc);
 
-GType gst_sh_video_enc_get_type(void)
-{
-	static GType object_type = 0;
+/** 
+ * Stops the encoder thread and returns to the state before the first 
+ * buffer, so that the next buffer starts a new stream
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_reset(GstSHVideoEnc *enc);
 
-	if (object_type == 0)
-	{
-		static const GTypeInfo object_info = 
-		{
-			sizeof(GstSHVideoEncClass),
-			gst_sh_video_enc_base_init,
-			NULL,
-			gst_sh_video_enc_init_class,
-			NULL,
-			NULL,
-			sizeof(GstSHVideoEnc),
-			0,
-			(GInstanceInitFunc)gst_sh_video_enc_init
-		};
-		
-		object_type =
-			g_type_register_static(GST_TYPE_ELEMENT, 
-						"gst-sh-mobile-enc", 
-						&object_info, (GTypeFlags)0);
-	}
-	
-	return object_type;
-}
+/** 
+ * The source pad task. Pushes the encoded buffers and the serialized 
+ * events, including the final EOS, downstream.
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_push_loop(GstSHVideoEnc *enc);
 
-static void
-gst_sh_video_enc_base_init(gpointer klass)
-{
-	static const GstElementDetails plugin_details =
-		GST_ELEMENT_DETAILS("SH hardware video encoder",
-			 "Codec/Encoder/Video",
-			 "Encode mpeg-based video stream(mpeg4, h264)",
-			 "Johannes Lahti <johannes.lahti@nomovok.com>");
-	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+/** 
+ * Appends an encoded buffer or an event to the output queue. Blocks while 
+ * the queue is full.
+ * @param enc Gstreamer SH video encoder
+ * @param item The buffer or event. Unreferenced if it can't be queued.
+ * @return FALSE if the output was stopped or downstream failed
+ */
+static gboolean gst_sh_video_enc_queue_output(GstSHVideoEnc *enc,
+					      GstMiniObject *item);
 
-	gst_element_class_add_pad_template(element_class,
-			gst_static_pad_template_get(&enc_src_factory));
-	gst_element_class_add_pad_template(element_class,
-			gst_static_pad_template_get(&enc_sink_factory));
-	gst_element_class_set_details(element_class, &plugin_details);
-}
+/** 
+ * Takes the oldest item from the output queue. Blocks while the queue is
+ * empty.
+ * @param enc Gstreamer SH video encoder
+ * @return The buffer or event, NULL if the output was stopped
+ */
+static GstMiniObject *gst_sh_video_enc_dequeue_output(GstSHVideoEnc *enc);
 
-static void
-gst_sh_video_enc_dispose(GObject * object)
-{
-	GstSHVideoEnc *enc = GST_SH_VIDEO_ENC(object);
+/** 
+ * Releases all the items in the output queue
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_flush_output(GstSHVideoEnc *enc);
 
-	if (enc->encoder != NULL)
-	{
-		shcodecs_encoder_close(enc->encoder);
-		enc->encoder = NULL;
-	}
+/** 
+ * Appends serialized events to the output queue in order
+ * @param enc Gstreamer SH video encoder
+ * @param events List of events, freed
+ * @return FALSE if the output was stopped or downstream failed
+ */
+static gboolean gst_sh_video_enc_queue_events(GstSHVideoEnc *enc,
+					      GList *events);
 
-	pthread_mutex_destroy(&enc->mutex);
-	pthread_mutex_destroy(&enc->cond_mutex);
-	pthread_cond_destroy(&enc->thread_condition);
+/** 
+ * Releases a list of events
+ * @param events List of events
+ */
+static void gst_sh_video_enc_free_events(GList *events);
 
-	G_OBJECT_CLASS(parent_class)->dispose(object);
-}
+/** 
+ * Appends encoded data to the access unit being assembled. The unit is 
+ * stamped when its first data arrives.
+ * @param enc Gstreamer SH video encoder
+ * @param data Encoded data
+ * @param length Length of the data
+ */
+static void gst_sh_video_enc_append_output(GstSHVideoEnc *enc, 
+					   unsigned char *data, guint length);
 
-static void
-gst_sh_video_enc_class_init(GstSHVideoEncClass * klass)
-{
-	GObjectClass *g_object_class;
-	GstElementClass *gst_element_class;
+/** 
+ * Makes room for more data in the access unit being assembled, starting a
+ * new unit if there is none. The caller writes the data and grows the 
+ * buffer size.
+ * @param enc Gstreamer SH video encoder
+ * @param length Number of bytes to be written
+ * @return where to write the data
+ */
+static guint8 *gst_sh_video_enc_reserve_output(GstSHVideoEnc *enc, 
+					       guint length);
 
-	g_object_class = (GObjectClass *)klass;
-	gst_element_class = (GstElementClass *)klass;
+/** 
+ * Appends encoded H.264 data in the avc stream-format. Each NAL unit gets 
+ * a four byte length prefix instead of its start code. SPS and PPS are 
+ * kept for codec_data and left out of the stream.
+ * @param enc Gstreamer SH video encoder
+ * @param data Encoded data, whole NAL units with start codes
+ * @param length Length of the data
+ */
+static void gst_sh_video_enc_append_avc(GstSHVideoEnc *enc, 
+					const guint8 *data, guint length);
 
-	g_object_class->dispose = gst_sh_video_enc_dispose;
-	g_object_class->set_property = gst_sh_video_enc_set_property;
-	g_object_class->get_property = gst_sh_video_enc_get_property;
+/** 
+ * Keeps a copy of a parameter set NAL unit. The avcC codec_data is rebuilt
+ * once both the SPS and the PPS are known.
+ * @param enc Gstreamer SH video encoder
+ * @param store Where the copy is kept, the previous copy is released
+ * @param data The NAL unit without start code
+ * @param size Size of the NAL unit
+ */
+static void gst_sh_video_enc_store_nal(GstSHVideoEnc *enc, GstBuffer **store,
+				       const guint8 *data, guint size);
 
-	GST_DEBUG_CATEGORY_INIT(gst_sh_mobile_debug, "gst-sh-mobile-enc",
-			0, "Encoder for H264/MPEG4 streams");
-	
-	g_object_class_install_property(g_object_class, PROP_CNTL_FILE,
-			g_param_spec_string("cntl-file", 
-					     		 "Control file location", 
-			                     "Location of the file including encoding parameters", 
-				             	 NULL, 
-                                 G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Updates the codec_data of the source caps if it has changed. The new 
+ * caps are set on the next buffer pushed.
+ * @param enc Gstreamer SH video encoder
+ * @param data The codec_data
+ * @param size Size of the codec_data
+ */
+static void gst_sh_video_enc_set_codec_data(GstSHVideoEnc *enc, 
+					    const guint8 *data, guint size);
 
-	g_object_class_install_property(g_object_class, PROP_STREAM_TYPE,
-			g_param_spec_string("stream-type", 
-					     		 "Stream type", 
-			                     "The type of the stream (h264/mpeg4)", 
-				             	 NULL, 
-                                 G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Picks the H.264 stream-format, byte-stream if downstream allows it
+ * @param enc Gstreamer SH video encoder
+ * @return STREAM_FORMAT_BYTE_STREAM or STREAM_FORMAT_AVC
+ */
+static gint gst_sh_video_enc_negotiate_stream_format(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_WIDTH,
-					 g_param_spec_long("width", 
-							    "Width", 
-							    "Width of the video frame", 
-							    0, G_MAXLONG, DEFAULT_WIDTH,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Creates the RTP packetizer and the application/x-rtp caps
+ * @param enc Gstreamer SH video encoder
+ * @return the caps
+ */
+static GstCaps *gst_sh_video_enc_get_rtp_caps(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_HEIGHT,
-					 g_param_spec_long("height", 
-							    "Height", 
-							    "Height of the video frame", 
-							    0, G_MAXLONG, DEFAULT_HEIGHT,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Adds the stream configuration receivers need to the RTP caps: 
+ * sprop-parameter-sets and profile-level-id for H.264, config and 
+ * profile-level-id for MPEG-4
+ * @param enc Gstreamer SH video encoder
+ * @param caps The caps to change
+ */
+static void gst_sh_video_enc_set_rtp_config(GstSHVideoEnc *enc, 
+					    GstCaps *caps);
 
-	g_object_class_install_property(g_object_class, PROP_FRAMERATE,
-					 g_param_spec_long("framerate", 
-							    "Framerate", 
-							    "Framerate of the video stream. Multiply with 10 fe. 30fps => 300", 
-							    0, G_MAXLONG, DEFAULT_FRAMERATE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Keeps the SPS and PPS of a byte-stream access unit for the RTP caps
+ * @param enc Gstreamer SH video encoder
+ * @param unit The access unit
+ */
+static void gst_sh_video_enc_store_parameter_sets(GstSHVideoEnc *enc, 
+						  GstBuffer *unit);
 
-	g_object_class_install_property(g_object_class, PROP_BITRATE,
-					 g_param_spec_long("bitrate", 
-							    "Bitrate", 
-							    "Bitrate of the video stream", 
-							    0, G_MAXLONG, DEFAULT_BITRATE_H264,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Checks whether each slice is pushed on its own. Low latency mode only
+ * applies to H.264, an MPEG-4 VOP is always pushed whole.
+ * @param enc Gstreamer SH video encoder
+ * @return TRUE if the output is pushed slice by slice
+ */
+static gboolean gst_sh_video_enc_slice_output(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_I_VOP_INTERVAL,
-					 g_param_spec_long("i-vop-interval", 
-							    "I VOP interval", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_I_VOP_INTERVAL,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Sets up the encoder for low latency mode: one call per NAL unit and 
+ * several slices per frame
+ * @param enc Gstreamer SH video encoder
+ * @return TRUE if low latency mode is on and the encoder took the settings
+ */
+static gboolean gst_sh_video_enc_set_slice_output(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_MV_MODE,
-					 g_param_spec_long("mv-mode", 
-							    "MV mode", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_MV_MODE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Packetizes an access unit and queues the packets for pushing. With 
+ * buffer lists the packets of a unit are queued and pushed together.
+ * @param enc Gstreamer SH video encoder
+ * @param unit The access unit
+ * @return FALSE if the output was stopped or downstream failed
+ */
+static gboolean gst_sh_video_enc_push_rtp(GstSHVideoEnc *enc, 
+					  GstBuffer *unit);
 
-	g_object_class_install_property(g_object_class, PROP_FCODE_FORWARD,
-					 g_param_spec_long("fcode-forward", 
-							    "I VOP interval", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_FCODE_FORWARD,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Adds a packet made by the RTP packetizer to the output
+ * @param header The RTP header
+ * @param payload The payload, a sub-buffer of the access unit or NULL
+ * @param user_data Gstreamer SH video encoder
+ * @return FALSE if the output was stopped or downstream failed
+ */
+static gboolean gst_sh_video_enc_add_packet(GstBuffer *header, 
+					    GstBuffer *payload,
+					    gpointer user_data);
 
-	g_object_class_install_property(g_object_class, PROP_SEARCH_MODE,
-					 g_param_spec_long("search-mode", 
-							    "Search mode", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_SEARCH_MODE_H264,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Queues the assembled access unit for pushing. IDR and I-VOP units are 
+ * marked as sync points, the others as delta units. The offsets are byte
+ * positions in the stream.
+ * @param enc Gstreamer SH video encoder
+ * @return FALSE if the output was stopped or downstream failed
+ */
+static gboolean gst_sh_video_enc_push_unit(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_SEARCH_TIME_FIXED,
-					 g_param_spec_long("search-time-fixed", 
-							    "Search time fixed", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_SEARCH_TIME_FIXED,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Allocates a buffer for encoded data, from the output pool if possible. 
+ * The pool is created on the first call, its buffers are as large as the 
+ * largest possible coded frame.
+ * @param enc Gstreamer SH video encoder
+ * @param size Number of bytes needed
+ * @return the buffer, at least size bytes
+ */
+static GstBuffer *gst_sh_video_enc_new_output_buffer(GstSHVideoEnc *enc,
+						     guint size);
 
-	g_object_class_install_property(g_object_class, PROP_RATECONTROL_SKIP_ENABLE,
-					 g_param_spec_long("ratecontrol-skip-enable", 
-							    "Rate control skip enable", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_RATECONTROL_SKIP_ENABLE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Gets the size of a packed input frame in the negotiated format
+ * @param enc Gstreamer SH video encoder
+ * @return the frame size in bytes
+ */
+static guint gst_sh_video_enc_get_frame_size(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_RATECONTROL_USE_PREVQUANT,
-					 g_param_spec_long("ratecontrol-use-prevquant", 
-							    "Rate control use prev quant", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_RATECONTROL_USE_PREVQUANT,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Converts a packed I420, YV12 or YUY2 frame to a NV12 frame for the encoder
+ * @param enc Gstreamer SH video encoder
+ * @param data The frame in the negotiated format
+ * @return the converted frame
+ */
+static GstSHVideoEncFrame *gst_sh_video_enc_convert_frame(GstSHVideoEnc *enc,
+							  const guint8 *data);
 
-	g_object_class_install_property(g_object_class, PROP_RATECONTROL_RESPECT_TYPE,
-					 g_param_spec_long("ratecontrol-respect-type", 
-							    "Rate control respect type", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_RATECONTROL_RESPECT_TYPE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Reads the memory layout of a NV12 frame. The layout is taken from the 
+ * buffer caps if they have it, otherwise from the sink pad caps.
+ * @param enc Gstreamer SH video encoder
+ * @param buffer Buffer holding the frame
+ * @param rowstride Bytes from the start of a row to the start of the next
+ * @param chroma_offset Offset of the CbCr plane from the start of the buffer
+ */
+static void gst_sh_video_enc_get_layout(GstSHVideoEnc *enc, GstBuffer *buffer,
+					gint *rowstride, gint *chroma_offset);
 
-	g_object_class_install_property(g_object_class, PROP_RATECONTROL_INTRA_THR_CHANGEABLE,
-					 g_param_spec_long("ratecontrol-intra-thr-changeable", 
-							    "Rate control intra THR changeable", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_RATECONTROL_INTRA_THR_CHANGEABLE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Copies padded rows to a packed plane
+ * @param dst Destination plane
+ * @param src Source plane
+ * @param width Bytes to copy from each row
+ * @param rows Number of rows
+ * @param rowstride Bytes between the source rows
+ */
+static void gst_sh_video_enc_copy_rows(guchar *dst, const guchar *src, 
+				       gint width, gint rows, gint rowstride);
 
-	g_object_class_install_property(g_object_class, PROP_CONTROL_BITRATE_LENGTH,
-					 g_param_spec_long("control-bitrate-length", 
-							    "Control bitrate length", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_CONTROL_BITRATE_LENGTH,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Allocates memory for a packed raw frame, from the input pool if possible
+ * @param enc Gstreamer SH video encoder
+ * @param size Size of the frame
+ * @return the buffer
+ */
+static GstBuffer *gst_sh_video_enc_new_frame_buffer(GstSHVideoEnc *enc, 
+						    guint size);
 
-	g_object_class_install_property(g_object_class, PROP_INTRA_MACROBLOCK_REFRESH_CYCLE,
-					 g_param_spec_long("intra-macroblock-refresh-cycle", 
-							    "Intra macroblock refresh cycle", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_INTRA_MACROBLOCK_REFRESH_CYCLE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Appends a raw frame to the input queue. When the queue is full, blocks or
+ * drops a frame depending on the drop policy.
+ * @param enc Gstreamer SH video encoder
+ * @param frame The frame to queue. Freed if it is dropped.
+ * @return FALSE if encoding was stopped while waiting, otherwise TRUE
+ */
+static gboolean gst_sh_video_enc_queue_frame(GstSHVideoEnc *enc,
+					GstSHVideoEncFrame *frame);
 
-	g_object_class_install_property(g_object_class, PROP_VIDEO_FORMAT,
-					 g_param_spec_long("video-format", 
-							    "Video format", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_VIDEO_FORMAT,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Frees a frame that could not be queued and reports it with a QoS message.
+ * The events that came before the frame are sent with the next frame.
+ * @param enc Gstreamer SH video encoder
+ * @param frame The dropped frame
+ */
+static void gst_sh_video_enc_drop_frame(GstSHVideoEnc *enc,
+					GstSHVideoEncFrame *frame);
 
-	g_object_class_install_property(g_object_class, PROP_FRAME_NUM_RESOLUTION,
-					 g_param_spec_long("frame-num-resolution", 
-							    "Frame number resolution", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_FRAME_NUM_RESOLUTION,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Takes the oldest raw frame from the input queue. Blocks while the queue
+ * is empty.
+ * @param enc Gstreamer SH video encoder
+ * @return The frame or NULL if there will be no more input
+ */
+static GstSHVideoEncFrame *gst_sh_video_enc_dequeue_frame(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_NOISE_REDUCTION,
-					 g_param_spec_long("noise-reduction", 
-							    "Noise reduction", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_NOISE_REDUCTION,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Releases a raw frame and its buffers
+ * @param frame The frame to free
+ */
+static void gst_sh_video_enc_free_frame(GstSHVideoEncFrame *frame);
 
-	g_object_class_install_property(g_object_class, PROP_REACTION_PARAM_COEFF,
-					 g_param_spec_long("reaction-param-coeff", 
-							    "Reaction parameter coefficient", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_REACTION_PARAM_COEFF,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Releases all the frames in the input queue
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_flush_queue(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_WEIGHTED_Q_MODE,
-					 g_param_spec_long("weighted-q-mode", 
-							    "Weighted Q-mode", 
-							    "", 
-							    0, G_MAXLONG, DEFAULT_WEIGHTED_Q_MODE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Wakes up the threads waiting for the input queue
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_wake_threads(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_I_VOP_QUANT_INITIAL_VALUE,
-					 g_param_spec_ulong("i-vop-quant-initial-value", 
-							    "I-VOP quantization intitial value", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_I_VOP_QUANT_INITIAL_VALUE_H264,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Marks the end of the input. The queued frames are still encoded and the
+ * encoder thread sends EOS downstream when it is done.
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_end_of_input(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_P_VOP_QUANT_INITIAL_VALUE,
-					 g_param_spec_ulong("p-vop-quant-initial-value", 
-							    "P-VOP quantization intitial value", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_P_VOP_QUANT_INITIAL_VALUE_H264,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Gets the I-VOP interval for libshcodecs. It is 0 when the element places
+ * the periodic key frames itself for scene-cut-restart-gop, unless a 
+ * forced key frame has failed to come out in this stream.
+ * @param enc Gstreamer SH video encoder
+ * @return the interval
+ */
+static glong gst_sh_video_enc_vop_interval(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_USE_D_QUANT,
-					 g_param_spec_ulong("use-d-quant", 
-							    "Use D-quantization", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_USE_D_QUANT,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * GStreamer state handling. We need this for pausing the encoder.
+ * @param element GStreamer element
+ * @param transition Flag indicating which transition to handle
+ * @return GST_STATE_CHANGE_SUCCESS if everything is ok. Otherwise
+ *         GST_STATE_CHANGE_FAILURE
+ */
+static GstStateChangeReturn
+gst_sh_video_enc_change_state(GstElement *element, GstStateChange transition);
 
-	g_object_class_install_property(g_object_class, PROP_CLIP_D_QUANT_FRAME,
-					 g_param_spec_ulong("clip-d-quant-frame", 
-							     "Clip D-quantized frame", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_USE_D_QUANT,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Creates a src_%d pad and the child encoder of its simulcast profile
+ * @param element GStreamer element
+ * @param templ Template of the pad
+ * @param name Name of the pad or NULL for the first free one
+ * @return the new pad or NULL if there is no such profile
+ */
+static GstPad *gst_sh_video_enc_request_new_pad(GstElement *element, 
+						GstPadTemplate *templ, 
+						const gchar *name);
 
-	g_object_class_install_property(g_object_class, PROP_QUANT_MIN,
-					 g_param_spec_ulong("quant-min", 
-							    "Minimum quantization", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_QUANT_MIN_H264,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Removes a src_%d pad and closes its child encoder
+ * @param element GStreamer element
+ * @param pad The pad
+ */
+static void gst_sh_video_enc_release_pad(GstElement *element, GstPad *pad);
 
-	g_object_class_install_property(g_object_class, PROP_QUANT_MIN_I_VOP_UNDER_RANGE,
-					 g_param_spec_ulong("quant-min-i-vop-under-range", 
-							    "", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_QUANT_MIN_I_VOP_UNDER_RANGE_H264,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Parses the simulcast property into the profiles. Called with the object
+ * lock held.
+ * @param enc Gstreamer SH video encoder
+ */
+static void gst_sh_video_enc_parse_simulcast(GstSHVideoEnc *enc);
 
-	g_object_class_install_property(g_object_class, PROP_QUANT_MAX,
-					 g_param_spec_ulong("quant-max", 
-							    "Maximum quantization", 
-							    "", 
-							     0, G_MAXULONG, DEFAULT_QUANT_MAX_H264,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Downscales a frame for each simulcast rendition and hands the copies to
+ * the child encoders
+ * @param enc Gstreamer SH video encoder
+ * @param frame The frame queued for the main stream
+ */
+static void gst_sh_video_enc_feed_renditions(GstSHVideoEnc *enc, 
+					     GstSHVideoEncFrame *frame);
 
-	g_object_class_install_property(g_object_class, PROP_PARAM_CHANGEABLE,
-					 g_param_spec_ulong("param-changeable", 
-							    "", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_PARAM_CHANGEABLE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Sends an event to the sink pads of the child encoders
+ * @param enc Gstreamer SH video encoder
+ * @param event The event, not consumed
+ */
+static void gst_sh_video_enc_forward_event(GstSHVideoEnc *enc, 
+					   GstEvent *event);
 
-	g_object_class_install_property(g_object_class, PROP_CHANGEABLE_MAX_BITRATE,
-					 g_param_spec_ulong("changeable-max-bitrate", 
-							    "Maximum changeable bitrate", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_CHANGEABLE_MAX_BITRATE,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+/** 
+ * Configures the child encoders and takes them to a new state
+ * @param enc Gstreamer SH video encoder
+ * @param state The state
+ */
+static void gst_sh_video_enc_set_renditions_state(GstSHVideoEnc *enc, 
+						  GstState state);
 
-        //MPEG4
+/** 
+ * Stops the child encoder of a rendition and frees the rendition
+ * @param rendition The rendition, already removed from the list
+ */
+static void gst_sh_video_enc_free_rendition(GstSHVideoEncRendition *rendition);
 
-	g_object_class_install_property(g_object_class, PROP_OUT_VOS,
-					 g_param_spec_ulong("out-vos", 
-							    "Out VOS", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_OUT_VOS,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_OUT_GOV,
-					 g_param_spec_ulong("out-gov", 
-							    "Out GOV", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_OUT_GOV,
-							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+static void
+gst_sh_video_enc_init_class(gpointer g_class, gpointer data)
+{
+	parent_class = g_type_class_peek_parent(g_class);
+	gst_sh_video_enc_class_init((GstSHVideoEncClass *)g_class);
+}
 
-	g_object_class_install_property(g_object_class, PROP_ASPECT_RATIO_INFO_TYPE,
-					 g_param_spec_ulong("aspect-ratio-info-type", 
-							    "Aspect ration info type", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_ASPECT_RATIO_INFO_TYPE,
+GType gst_sh_video_enc_get_type(void)
+{
+	static GType object_type = 0;
+
+	if (object_type == 0)
+	{
+		static const GTypeInfo object_info = 
+		{
+			sizeof(GstSHVideoEncClass),
+			gst_sh_video_enc_base_init,
+			NULL,
+			gst_sh_video_enc_init_class,
+			NULL,
+			NULL,
+			sizeof(GstSHVideoEnc),
+			0,
+			(GInstanceInitFunc)gst_sh_video_enc_init
+		};
+		
+		object_type =
+			g_type_register_static(GST_TYPE_ELEMENT, 
+						"gst-sh-mobile-enc", 
+						&object_info, (GTypeFlags)0);
+	}
+	
+	return object_type;
+}
+
+static void
+gst_sh_video_enc_base_init(gpointer klass)
+{
+	static const GstElementDetails plugin_details =
+		GST_ELEMENT_DETAILS("SH hardware video encoder",
+			 "Codec/Encoder/Video",
+			 "Encode mpeg-based video stream(mpeg4, h264)",
+			 "Johannes Lahti <johannes.lahti@nomovok.com>");
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+
+	gst_element_class_add_pad_template(element_class,
+			gst_static_pad_template_get(&enc_src_factory));
+	gst_element_class_add_pad_template(element_class,
+			gst_static_pad_template_get(&enc_request_src_factory));
+	gst_element_class_add_pad_template(element_class,
+			gst_static_pad_template_get(&enc_sink_factory));
+	gst_element_class_set_details(element_class, &plugin_details);
+}
+
+static void
+gst_sh_video_enc_dispose(GObject * object)
+{
+	GstSHVideoEnc *enc = GST_SH_VIDEO_ENC(object);
+
+	if (enc->encoder != NULL)
+	{
+		encoder_pool_release(enc->encoder, enc->encoder_clean);
+		enc->encoder = NULL;
+	}
+
+	// The request pads themselves are removed by GstElement
+	g_list_foreach(enc->renditions, (GFunc)gst_sh_video_enc_free_rendition,
+		       NULL);
+	g_list_free(enc->renditions);
+	enc->renditions = NULL;
+	g_free(enc->simulcast);
+	enc->simulcast = NULL;
+
+	vpu_sched_client_free(enc->vpu);
+	enc->vpu = NULL;
+
+	scene_cut_free(enc->scene_cut);
+	enc->scene_cut = NULL;
+
+	if (enc->input_queue != NULL)
+	{
+		gst_sh_video_enc_flush_queue(enc);
+		ring_buffer_free(enc->input_queue);
+		enc->input_queue = NULL;
+	}
+
+	if (enc->input_pool != NULL)
+	{
+		gst_sh_buffer_pool_free(enc->input_pool);
+		enc->input_pool = NULL;
+	}
+
+	if (enc->pending_unit != NULL)
+	{
+		gst_buffer_unref(enc->pending_unit);
+		enc->pending_unit = NULL;
+	}
+
+	if (enc->output_queue != NULL)
+	{
+		gst_sh_video_enc_flush_output(enc);
+		ring_buffer_free(enc->output_queue);
+		enc->output_queue = NULL;
+	}
+
+	if (enc->output_pool != NULL)
+	{
+		gst_sh_buffer_pool_free(enc->output_pool);
+		enc->output_pool = NULL;
+	}
+
+	gst_caps_replace(&enc->src_caps, NULL);
+	gst_buffer_replace(&enc->codec_data, NULL);
+	gst_buffer_replace(&enc->sps, NULL);
+	gst_buffer_replace(&enc->pps, NULL);
+
+	if (enc->packetizer != NULL)
+	{
+		gst_sh_rtp_packetizer_free(enc->packetizer);
+		enc->packetizer = NULL;
+	}
+
+	if (enc->rate_control != NULL)
+	{
+		rate_control_free(enc->rate_control);
+		enc->rate_control = NULL;
+	}
+
+	if (enc->rate_trace != NULL)
+	{
+		fclose(enc->rate_trace);
+		enc->rate_trace = NULL;
+	}
+	g_free(enc->rate_trace_name);
+	enc->rate_trace_name = NULL;
+
+	if (enc->stats != NULL)
+	{
+		enc_stats_free(enc->stats);
+		enc->stats = NULL;
+	}
+
+	pthread_mutex_destroy(&enc->mutex);
+	pthread_mutex_destroy(&enc->cond_mutex);
+	pthread_cond_destroy(&enc->thread_condition);
+
+	G_OBJECT_CLASS(parent_class)->dispose(object);
+}
+
+static void
+gst_sh_video_enc_class_init(GstSHVideoEncClass * klass)
+{
+	GObjectClass *g_object_class;
+	GstElementClass *gst_element_class;
+
+	g_object_class = (GObjectClass *)klass;
+	gst_element_class = (GstElementClass *)klass;
+
+	g_object_class->dispose = gst_sh_video_enc_dispose;
+	g_object_class->set_property = gst_sh_video_enc_set_property;
+	g_object_class->get_property = gst_sh_video_enc_get_property;
+
+	GST_DEBUG_CATEGORY_INIT(gst_sh_mobile_debug, "gst-sh-mobile-enc",
+			0, "Encoder for H264/MPEG4 streams");
+	
+	g_object_class_install_property(g_object_class, PROP_CNTL_FILE,
+			g_param_spec_string("cntl-file", 
+					     		 "Control file location", 
+			                     "Location of the file including encoding parameters", 
+				             	 NULL, 
+                                 G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_STREAM_TYPE,
+			g_param_spec_string("stream-type", 
+					     		 "Stream type", 
+			                     "The type of the stream (h264/mpeg4)", 
+				             	 NULL, 
+                                 G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_WIDTH,
+					 g_param_spec_long("width", 
+							    "Width", 
+							    "Width of the video frame", 
+							    0, G_MAXLONG, DEFAULT_WIDTH,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_ASPECT_RATIO_INFO_VALUE,
-					 g_param_spec_ulong("aspect-ratio-info-value", 
-							    "Aspect ration info value", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_ASPECT_RATIO_INFO_VALUE,
+	g_object_class_install_property(g_object_class, PROP_HEIGHT,
+					 g_param_spec_long("height", 
+							    "Height", 
+							    "Height of the video frame", 
+							    0, G_MAXLONG, DEFAULT_HEIGHT,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VOS_PROFILE_LEVEL_TYPE,
-					 g_param_spec_ulong("vos-profile-level-type", 
-							    "VOS proile level type", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_VOS_PROFILE_LEVEL_TYPE,
+	g_object_class_install_property(g_object_class, PROP_FRAMERATE,
+					 g_param_spec_long("framerate", 
+							    "Framerate", 
+							    "Framerate of the video stream. Multiply with 10 fe. 30fps => 300", 
+							    0, G_MAXLONG, DEFAULT_FRAMERATE,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VOS_PROFILE_LEVEL_VALUE,
-					 g_param_spec_ulong("vos-profile-level-value", 
-							    "VOS proile level value", 
-							    "", 
-							    0, G_MAXULONG, DEFAULT_VOS_PROFILE_LEVEL_VALUE,
+	g_object_class_install_property(g_object_class, PROP_BITRATE,
+					 g_param_spec_long("bitrate", 
+							    "Bitrate", 
+							    "Bitrate of the video stream", 
+							    0, G_MAXLONG, DEFAULT_BITRATE_H264,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_OUT_VISUAL_OBJECT_IDENTIFIER,
-					 g_param_spec_ulong("out-visual-object-identifier", 
-							    "Out visual object identifier", 
+	g_object_class_install_property(g_object_class, PROP_I_VOP_INTERVAL,
+					 g_param_spec_long("i-vop-interval", 
+							    "I VOP interval", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_OUT_VISUAL_OBJECT_IDENTIFIER,
+							    0, G_MAXLONG, DEFAULT_I_VOP_INTERVAL,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VISUAL_OBJECT_VERID,
-					 g_param_spec_ulong("visual-object-verid", 
-							    "Visual object verid", 
+	g_object_class_install_property(g_object_class, PROP_MV_MODE,
+					 g_param_spec_long("mv-mode", 
+							    "MV mode", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_VISUAL_OBJECT_VERID,
+							    0, G_MAXLONG, DEFAULT_MV_MODE,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VISUAL_OBJECT_PRIORITY,
-					 g_param_spec_ulong("visual-object-priority", 
-							    "Visual object priority", 
+	g_object_class_install_property(g_object_class, PROP_FCODE_FORWARD,
+					 g_param_spec_long("fcode-forward", 
+							    "I VOP interval", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_VISUAL_OBJECT_PRIORITY,
+							    0, G_MAXLONG, DEFAULT_FCODE_FORWARD,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VIDEO_OBJECT_TYPE_INDICATION,
-					 g_param_spec_ulong("visual-object-type-indication", 
-							    "Visual object type indication", 
+	g_object_class_install_property(g_object_class, PROP_SEARCH_MODE,
+					 g_param_spec_long("search-mode", 
+							    "Search mode", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_VIDEO_OBJECT_TYPE_INDICATION,
+							    0, G_MAXLONG, DEFAULT_SEARCH_MODE_H264,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_OUT_OBJECT_LAYER_IDENTIFIER,
-					 g_param_spec_ulong("out-object-layer-identifier", 
-							    "Out object layer identifier", 
+	g_object_class_install_property(g_object_class, PROP_SEARCH_TIME_FIXED,
+					 g_param_spec_long("search-time-fixed", 
+							    "Search time fixed", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_OUT_OBJECT_LAYER_IDENTIFIER,
+							    0, G_MAXLONG, DEFAULT_SEARCH_TIME_FIXED,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VIDEO_OBJECT_LAYER_VERID,
-					 g_param_spec_ulong("video-object-layer-verid", 
-							    "Video object layer verid", 
+	g_object_class_install_property(g_object_class, PROP_RATECONTROL_SKIP_ENABLE,
+					 g_param_spec_long("ratecontrol-skip-enable", 
+							    "Rate control skip enable", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_VIDEO_OBJECT_LAYER_VERID,
+							    0, G_MAXLONG, DEFAULT_RATECONTROL_SKIP_ENABLE,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VIDEO_OBJECT_LAYER_PRIORITY,
-					 g_param_spec_ulong("video-object-layer-priority", 
-							    "Video object layer priority", 
+	g_object_class_install_property(g_object_class, PROP_RATECONTROL_USE_PREVQUANT,
+					 g_param_spec_long("ratecontrol-use-prevquant", 
+							    "Rate control use prev quant", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_VIDEO_OBJECT_LAYER_PRIORITY,
+							    0, G_MAXLONG, DEFAULT_RATECONTROL_USE_PREVQUANT,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
-	
-	g_object_class_install_property(g_object_class, PROP_ERROR_RESILIENCE_MODE,
-					 g_param_spec_ulong("error-resilience-mode", 
-							    "Error resilience mode", 
+
+	g_object_class_install_property(g_object_class, PROP_RATECONTROL_RESPECT_TYPE,
+					 g_param_spec_long("ratecontrol-respect-type", 
+							    "Rate control respect type", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_ERROR_RESILIENCE_MODE,
+							    0, G_MAXLONG, DEFAULT_RATECONTROL_RESPECT_TYPE,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VIDEO_PACKET_SIZE_MB,
-					 g_param_spec_ulong("video-packet-size-mb", 
-							    "Video packet size MB", 
+	g_object_class_install_property(g_object_class, PROP_RATECONTROL_INTRA_THR_CHANGEABLE,
+					 g_param_spec_long("ratecontrol-intra-thr-changeable", 
+							    "Rate control intra THR changeable", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_VIDEO_PACKET_SIZE_MB,
+							    0, G_MAXLONG, DEFAULT_RATECONTROL_INTRA_THR_CHANGEABLE,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VIDEO_PACKET_SIZE_BIT,
-					 g_param_spec_ulong("video-packet-size-bit", 
-							    "Video packet size bit", 
+	g_object_class_install_property(g_object_class, PROP_CONTROL_BITRATE_LENGTH,
+					 g_param_spec_long("control-bitrate-length", 
+							    "Control bitrate length", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_VIDEO_PACKET_SIZE_BIT,
+							    0, G_MAXLONG, DEFAULT_CONTROL_BITRATE_LENGTH,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_VIDEO_PACKET_HEADER_EXTENTION,
-					 g_param_spec_ulong("video-packet-header-extention", 
-							    "Video packet header extention", 
+	g_object_class_install_property(g_object_class, PROP_INTRA_MACROBLOCK_REFRESH_CYCLE,
+					 g_param_spec_long("intra-macroblock-refresh-cycle", 
+							    "Intra macroblock refresh cycle", 
 							    "", 
-							    0, G_MAXULONG, DEFAULT_VIDEO_PACKET_HEADER_EXTENTION,
+							    0, G_MAXLONG, DEFAULT_INTRA_MACROBLOCK_REFRESH_CYCLE,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
-	g_object_class_install_property(g_object_class, PROP_DATA_PARTITIONED,
-					 g_param_spec_ulong("data-partitioned", 
+	g_object_class_install_property(g_object_class, PROP_VIDEO_FORMAT,
+					 g_param_spec_long("video-format", 
+							    "Video format", 
+							    "", 
+							    0, G_MAXLONG, DEFAULT_VIDEO_FORMAT,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_FRAME_NUM_RESOLUTION,
+					 g_param_spec_long("frame-num-resolution", 
+							    "Frame number resolution", 
+							    "", 
+							    0, G_MAXLONG, DEFAULT_FRAME_NUM_RESOLUTION,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_NOISE_REDUCTION,
+					 g_param_spec_long("noise-reduction", 
+							    "Noise reduction", 
+							    "", 
+							    0, G_MAXLONG, DEFAULT_NOISE_REDUCTION,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_REACTION_PARAM_COEFF,
+					 g_param_spec_long("reaction-param-coeff", 
+							    "Reaction parameter coefficient", 
+							    "", 
+							    0, G_MAXLONG, DEFAULT_REACTION_PARAM_COEFF,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_WEIGHTED_Q_MODE,
+					 g_param_spec_long("weighted-q-mode", 
+							    "Weighted Q-mode", 
+							    "", 
+							    0, G_MAXLONG, DEFAULT_WEIGHTED_Q_MODE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_I_VOP_QUANT_INITIAL_VALUE,
+					 g_param_spec_ulong("i-vop-quant-initial-value", 
+							    "I-VOP quantization intitial value", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_I_VOP_QUANT_INITIAL_VALUE_H264,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_P_VOP_QUANT_INITIAL_VALUE,
+					 g_param_spec_ulong("p-vop-quant-initial-value", 
+							    "P-VOP quantization intitial value", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_P_VOP_QUANT_INITIAL_VALUE_H264,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_USE_D_QUANT,
+					 g_param_spec_ulong("use-d-quant", 
+							    "Use D-quantization", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_USE_D_QUANT,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_CLIP_D_QUANT_FRAME,
+					 g_param_spec_ulong("clip-d-quant-frame", 
+							     "Clip D-quantized frame", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_USE_D_QUANT,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_QUANT_MIN,
+					 g_param_spec_ulong("quant-min", 
+							    "Minimum quantization", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_QUANT_MIN_H264,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_QUANT_MIN_I_VOP_UNDER_RANGE,
+					 g_param_spec_ulong("quant-min-i-vop-under-range", 
+							    "", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_QUANT_MIN_I_VOP_UNDER_RANGE_H264,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_QUANT_MAX,
+					 g_param_spec_ulong("quant-max", 
+							    "Maximum quantization", 
+							    "", 
+							     0, G_MAXULONG, DEFAULT_QUANT_MAX_H264,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_PARAM_CHANGEABLE,
+					 g_param_spec_ulong("param-changeable", 
+							    "", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_PARAM_CHANGEABLE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_CHANGEABLE_MAX_BITRATE,
+					 g_param_spec_ulong("changeable-max-bitrate", 
+							    "Maximum changeable bitrate", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_CHANGEABLE_MAX_BITRATE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+        //MPEG4
+
+	g_object_class_install_property(g_object_class, PROP_OUT_VOS,
+					 g_param_spec_ulong("out-vos", 
+							    "Out VOS", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_OUT_VOS,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_OUT_GOV,
+					 g_param_spec_ulong("out-gov", 
+							    "Out GOV", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_OUT_GOV,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_ASPECT_RATIO_INFO_TYPE,
+					 g_param_spec_ulong("aspect-ratio-info-type", 
+							    "Aspect ration info type", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_ASPECT_RATIO_INFO_TYPE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_ASPECT_RATIO_INFO_VALUE,
+					 g_param_spec_ulong("aspect-ratio-info-value", 
+							    "Aspect ration info value", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_ASPECT_RATIO_INFO_VALUE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VOS_PROFILE_LEVEL_TYPE,
+					 g_param_spec_ulong("vos-profile-level-type", 
+							    "VOS proile level type", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VOS_PROFILE_LEVEL_TYPE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VOS_PROFILE_LEVEL_VALUE,
+					 g_param_spec_ulong("vos-profile-level-value", 
+							    "VOS proile level value", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VOS_PROFILE_LEVEL_VALUE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_OUT_VISUAL_OBJECT_IDENTIFIER,
+					 g_param_spec_ulong("out-visual-object-identifier", 
+							    "Out visual object identifier", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_OUT_VISUAL_OBJECT_IDENTIFIER,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VISUAL_OBJECT_VERID,
+					 g_param_spec_ulong("visual-object-verid", 
+							    "Visual object verid", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VISUAL_OBJECT_VERID,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VISUAL_OBJECT_PRIORITY,
+					 g_param_spec_ulong("visual-object-priority", 
+							    "Visual object priority", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VISUAL_OBJECT_PRIORITY,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VIDEO_OBJECT_TYPE_INDICATION,
+					 g_param_spec_ulong("visual-object-type-indication", 
+							    "Visual object type indication", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VIDEO_OBJECT_TYPE_INDICATION,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_OUT_OBJECT_LAYER_IDENTIFIER,
+					 g_param_spec_ulong("out-object-layer-identifier", 
+							    "Out object layer identifier", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_OUT_OBJECT_LAYER_IDENTIFIER,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VIDEO_OBJECT_LAYER_VERID,
+					 g_param_spec_ulong("video-object-layer-verid", 
+							    "Video object layer verid", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VIDEO_OBJECT_LAYER_VERID,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VIDEO_OBJECT_LAYER_PRIORITY,
+					 g_param_spec_ulong("video-object-layer-priority", 
+							    "Video object layer priority", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VIDEO_OBJECT_LAYER_PRIORITY,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	
+	g_object_class_install_property(g_object_class, PROP_ERROR_RESILIENCE_MODE,
+					 g_param_spec_ulong("error-resilience-mode", 
+							    "Error resilience mode", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_ERROR_RESILIENCE_MODE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VIDEO_PACKET_SIZE_MB,
+					 g_param_spec_ulong("video-packet-size-mb", 
+							    "Video packet size MB", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VIDEO_PACKET_SIZE_MB,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VIDEO_PACKET_SIZE_BIT,
+					 g_param_spec_ulong("video-packet-size-bit", 
+							    "Video packet size bit", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VIDEO_PACKET_SIZE_BIT,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VIDEO_PACKET_HEADER_EXTENTION,
+					 g_param_spec_ulong("video-packet-header-extention", 
+							    "Video packet header extention", 
+							    "", 
+							    0, G_MAXULONG, DEFAULT_VIDEO_PACKET_HEADER_EXTENTION,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_DATA_PARTITIONED,
+					 g_param_spec_ulong("data-partitioned", 
 							    "Data partitioned", 
 							    "", 
 							    0, G_MAXULONG, DEFAULT_DATA_PARTITIONED,
@@ -1272,8 +2166,231 @@ gst_sh_video_enc_class_init(GstSHVideoEncClass * klass)
 							    "", 
 							    0, G_MAXULONG, DEFAULT_CONSTRAINED_INTRA_PRED,
 							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_QUEUE_DEPTH,
+					 g_param_spec_uint("queue-depth", 
+							    "Input queue depth", 
+							    "Number of raw frames that can wait for the encoder", 
+							    1, MAX_QUEUE_DEPTH, DEFAULT_QUEUE_DEPTH,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_QUEUE_LEVEL,
+					 g_param_spec_uint("queue-level", 
+							    "Input queue level", 
+							    "Number of raw frames currently waiting for the encoder", 
+							    0, MAX_QUEUE_DEPTH, 0,
+							    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_READ_AHEAD,
+					 g_param_spec_uint("read-ahead", 
+							    "Read ahead", 
+							    "Number of frames fetched with one request in pull mode", 
+							    1, MAX_QUEUE_DEPTH, DEFAULT_READ_AHEAD,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_POOL_SIZE,
+					 g_param_spec_uint("pool-size", 
+							    "Input pool size", 
+							    "Number of frame buffers handed out to upstream (0 disables)", 
+							    0, MAX_POOL_SIZE, DEFAULT_POOL_SIZE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_DROP_POLICY,
+			g_param_spec_string("drop-policy", 
+					    "Drop policy", 
+					    "Frame to drop when the input queue is full (block/drop-oldest/drop-newest)", 
+					    DEFAULT_DROP_POLICY, 
+					    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_FRAMES_DROPPED,
+					 g_param_spec_uint("frames-dropped", 
+							    "Frames dropped", 
+							    "Number of frames dropped because the input queue was full or skipped by the rate controller", 
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_FRAMES_ENCODED,
+					 g_param_spec_uint("frames-encoded", 
+							    "Frames encoded", 
+							    "Number of encoded frames pushed", 
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_LOW_LATENCY,
+					 g_param_spec_boolean("low-latency", 
+							      "Low latency", 
+							      "Push every H.264 slice as soon as it is encoded", 
+							      DEFAULT_LOW_LATENCY,
+							      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_OUTPUT_QUEUE_SIZE,
+					 g_param_spec_uint("output-queue-size", 
+							    "Output queue size", 
+							    "Number of encoded buffers that can wait to be pushed", 
+							    1, MAX_OUTPUT_QUEUE_SIZE, DEFAULT_OUTPUT_QUEUE_SIZE,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_OUTPUT_QUEUE_HIGH_WATER,
+					 g_param_spec_uint("output-queue-high-water", 
+							    "Output queue high water mark", 
+							    "Largest number of encoded buffers waiting to be pushed", 
+							    0, MAX_OUTPUT_QUEUE_SIZE, 0,
+							    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_RTP,
+					 g_param_spec_boolean("rtp", 
+							      "RTP", 
+							      "Output RTP packets", 
+							      DEFAULT_RTP,
+							      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_MTU,
+					 g_param_spec_uint("mtu", 
+							    "MTU", 
+							    "Maximum size of an RTP packet", 
+							    MIN_MTU, MAX_MTU, DEFAULT_MTU,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_PT,
+					 g_param_spec_uint("pt", 
+							    "Payload type", 
+							    "RTP payload type", 
+							    MIN_PT, MAX_PT, DEFAULT_PT,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_SSRC,
+					 g_param_spec_uint("ssrc", 
+							    "SSRC", 
+							    "RTP synchronization source, 0 for random", 
+							    0, G_MAXUINT32, DEFAULT_SSRC,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_RATE_CONTROL,
+			g_param_spec_string("rate-control", 
+					    "Rate control", 
+					    "Adaptive bitrate policy (none/aimd)", 
+					    DEFAULT_RATE_CONTROL, 
+					    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_TARGET_BITRATE,
+					 g_param_spec_long("target-bitrate", 
+							   "Target bitrate", 
+							   "Highest bitrate of the rate controller, 0 for bitrate", 
+							   0, 10000000, DEFAULT_TARGET_BITRATE,
+							   G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_RATE_CONTROL_TRACE,
+			g_param_spec_string("rate-control-trace", 
+					    "Rate control trace", 
+					    "File to record the rate controller input to", 
+					    NULL, 
+					    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_STATS_FPS,
+					 g_param_spec_double("stats-fps", 
+							     "Frames per second", 
+							     "Encoded frames per second", 
+							     0, G_MAXDOUBLE, 0,
+							     G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_STATS_BITRATE,
+					 g_param_spec_uint("stats-bitrate", 
+							    "Output bitrate", 
+							    "Encoded bits per second", 
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_STATS_LATENCY_P50,
+					 g_param_spec_uint("stats-latency-p50", 
+							    "Median latency", 
+							    "Median encoding latency in microseconds", 
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_STATS_LATENCY_P99,
+					 g_param_spec_uint("stats-latency-p99", 
+							    "99th percentile latency", 
+							    "99th percentile encoding latency in microseconds", 
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_STATS_ENCODER_LOAD,
+					 g_param_spec_double("stats-encoder-load", 
+							     "Encoder load", 
+							     "Share of the time the encoder is busy", 
+							     0, 1, 0,
+							     G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_STATS_INTERVAL,
+					 g_param_spec_uint("stats-interval", 
+							    "Statistics interval", 
+							    "Milliseconds between statistics messages, 0 for none", 
+							    0, G_MAXUINT, DEFAULT_STATS_INTERVAL,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_PRESET,
+					 g_param_spec_string("preset", 
+							    "Preset", 
+							    "Parameter set for a use case (none/zero-latency/archival/streaming)", 
+							    DEFAULT_PRESET,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_SIMULCAST,
+					 g_param_spec_string("simulcast", 
+							    "Simulcast profiles", 
+							    "Profiles of the src_%d pads, WIDTHxHEIGHT@BITRATE separated by commas", 
+							    NULL,
+							    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VPU_PRIORITY,
+					 g_param_spec_int("vpu-priority", 
+							  "VPU priority", 
+							  "Priority on the VPU shared with the other encoders and decoders", 
+							  0, VPU_SCHED_MAX_PRIORITY, 
+							  VPU_SCHED_DEFAULT_PRIORITY,
+							  G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VPU_WEIGHT,
+					 g_param_spec_uint("vpu-weight", 
+							   "VPU weight", 
+							   "Share of the VPU relative to the instances of the same priority", 
+							   1, VPU_SCHED_MAX_WEIGHT, 
+							   VPU_SCHED_DEFAULT_WEIGHT,
+							   G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VPU_LOAD,
+					 g_param_spec_double("vpu-load", 
+							     "VPU load", 
+							     "Share of the time the encoder had the VPU", 
+							     0, 1, 0,
+							     G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_VPU_DEADLINE_MISSES,
+					 g_param_spec_uint("vpu-deadline-misses", 
+							   "VPU deadline misses", 
+							   "Number of frames encoded after their deadline", 
+							   0, G_MAXUINT, 0,
+							   G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_SCENE_CUT_THRESHOLD,
+					 g_param_spec_uint("scene-cut-threshold", 
+							   "Scene cut threshold", 
+							   "Mean luma difference of a scene cut, 0 to disable", 
+							   0, 255, DEFAULT_SCENE_CUT_THRESHOLD,
+							   G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(g_object_class, PROP_SCENE_CUT_RESTART_GOP,
+					 g_param_spec_boolean("scene-cut-restart-gop", 
+							      "Restart GOP at scene cuts", 
+							      "Count the I-VOP interval from the latest key frame", 
+							      DEFAULT_SCENE_CUT_RESTART_GOP,
+							      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_assert(PROP_LAST <= GST_SH_VIDEO_ENC_PROPS_SET_SIZE * 32);
 	
 	gst_element_class->change_state = gst_sh_video_enc_change_state;
+	gst_element_class->request_new_pad = gst_sh_video_enc_request_new_pad;
+	gst_element_class->release_pad = gst_sh_video_enc_release_pad;
 }
 
 static void
@@ -1300,20 +2417,96 @@ gst_sh_video_enc_init(GstSHVideoEnc * enc,
 				   gst_sh_video_enc_sink_event);
 	gst_pad_set_chain_function(enc->sinkpad, 
 				   gst_sh_video_enc_chain);
+	gst_pad_set_bufferalloc_function(enc->sinkpad,
+				   gst_sh_video_enc_buffer_alloc);
 	enc->srcpad = gst_pad_new_from_template(
 					gst_element_class_get_pad_template(klass, "src"), "src");
 	gst_pad_use_fixed_caps(enc->srcpad);
 
 	gst_pad_set_query_function(enc->srcpad,
 			GST_DEBUG_FUNCPTR(gst_sh_video_enc_src_query));
+	gst_pad_set_event_function(enc->srcpad,
+			GST_DEBUG_FUNCPTR(gst_sh_video_enc_src_event));
 
 	gst_element_add_pad(GST_ELEMENT(enc), enc->srcpad);
 
 	enc->encoder = NULL;
 	enc->caps_set = FALSE;
+	enc->variable_framerate = FALSE;
 	enc->enc_thread = 0;
-	enc->buffer_yuv = NULL;
-	enc->buffer_cbcr = NULL;
+	enc->input_queue = NULL;
+	enc->queue_depth = DEFAULT_QUEUE_DEPTH;
+	enc->encoder_waiting = FALSE;
+	enc->chain_waiting = FALSE;
+	enc->read_ahead = DEFAULT_READ_AHEAD;
+	enc->input_pool = NULL;
+	enc->pool_size = DEFAULT_POOL_SIZE;
+	enc->output_pool = NULL;
+	enc->output_buffer_size = 0;
+	enc->output_queue = NULL;
+	enc->output_queue_size = DEFAULT_OUTPUT_QUEUE_SIZE;
+	enc->output_high_water = 0;
+	enc->output_waiting = FALSE;
+	enc->push_waiting = FALSE;
+	enc->output_stopped = FALSE;
+	enc->output_flow = GST_FLOW_OK;
+	enc->pending_events = NULL;
+	enc->carried_events = NULL;
+	enc->pending_unit = NULL;
+	enc->pending_capacity = 0;
+	enc->pending_sync = FALSE;
+	enc->bytes_out = 0;
+	enc->stream_format = STREAM_FORMAT_BYTE_STREAM;
+	enc->src_caps = NULL;
+	enc->codec_data = NULL;
+	enc->sps = NULL;
+	enc->pps = NULL;
+	enc->rtp = DEFAULT_RTP;
+	enc->mtu = DEFAULT_MTU;
+	enc->pt = DEFAULT_PT;
+	enc->ssrc = DEFAULT_SSRC;
+	enc->packetizer = NULL;
+	enc->drop_policy = DROP_POLICY_BLOCK;
+	enc->frames_dropped = 0;
+	enc->preset = enc_preset_find(DEFAULT_PRESET);
+	enc->simulcast = NULL;
+	enc->n_profiles = 0;
+	enc->renditions = NULL;
+	enc->vpu = vpu_sched_client_new();
+	enc->vpu_priority = VPU_SCHED_DEFAULT_PRIORITY;
+	enc->vpu_weight = VPU_SCHED_DEFAULT_WEIGHT;
+	enc->scene_cut = scene_cut_new();
+	enc->scene_cut_threshold = DEFAULT_SCENE_CUT_THRESHOLD;
+	enc->scene_cut_restart_gop = DEFAULT_SCENE_CUT_RESTART_GOP;
+	enc->scene_cut_pending = FALSE;
+	enc->frames_since_key = 0;
+	enc->key_frame_out = FALSE;
+	enc->vop_interval_fallback = FALSE;
+	memset(enc->props_set, 0, sizeof(enc->props_set));
+	enc->low_latency = DEFAULT_LOW_LATENCY;
+	enc->slice_output = FALSE;
+	enc->key_unit_next_frame = FALSE;
+	enc->force_key_unit = FALSE;
+	enc->key_unit_forced = FALSE;
+	enc->key_unit_announce = FALSE;
+	enc->key_unit_attempts = 0;
+	enc->pending_changes = 0;
+	enc->rate_policy = rate_control_find_policy(DEFAULT_RATE_CONTROL);
+	enc->rate_control = NULL;
+	enc->applied_bitrate = 0;
+	enc->target_bitrate = DEFAULT_TARGET_BITRATE;
+	enc->rate_trace_name = NULL;
+	enc->rate_trace = NULL;
+	enc->qos_proportion = 0;
+	enc->stats = enc_stats_new();
+	enc->stats_interval = DEFAULT_STATS_INTERVAL;
+	enc->stats_last_post = 0;
+	enc->encode_start = 0;
+	enc->pending_arrival = 0;
+	enc->slices_pending = FALSE;
+	enc->slices_timestamp = GST_CLOCK_TIME_NONE;
+	enc->slices_size = 0;
+	enc->slices_type = ENC_STATS_FRAME_P;
 
 	pthread_mutex_init(&enc->mutex, NULL);
 	pthread_mutex_init(&enc->cond_mutex, NULL);
@@ -1323,12 +2516,21 @@ gst_sh_video_enc_init(GstSHVideoEnc * enc,
 	enc->out_caps = NULL;
 	enc->width = 0;
 	enc->height = 0;
+	enc->fourcc = GST_MAKE_FOURCC('N', 'V', '1', '2');
+	enc->rowstride = 0;
+	enc->chroma_offset = 0;
 	enc->fps_numerator = 0;
 	enc->fps_denominator = 0;
+	enc->last_input_timestamp = GST_CLOCK_TIME_NONE;
+	enc->frame_interval = 0;
+	enc->applied_interval = 0;
 	enc->frame_number = 0;
+	enc->input_frames = 0;
+	enc->cycle_outputs = 0;
 
 	enc->stream_stopped = FALSE;
 	enc->eos = FALSE;
+	enc->encoder_clean = TRUE;
 
 	/* PROPERTIES */
 	/* common */
@@ -1441,6 +2643,9 @@ gst_sh_video_enc_set_property(GObject * object, guint prop_id,
 	
 	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
 
+	// Presets don't touch properties set by the application
+	enc->props_set[prop_id / 32] |= 1U << (prop_id % 32);
+
 	switch (prop_id) 
 	{
 		case PROP_CNTL_FILE:
@@ -1476,18 +2681,22 @@ gst_sh_video_enc_set_property(GObject * object, guint prop_id,
 		}
 		case PROP_FRAMERATE:
 		{
+			// 0 leaves the framerate unset, it is not variable framerate
 			enc->fps_numerator = g_value_get_long(value);
-			enc->fps_denominator = 10;
+			enc->fps_denominator = enc->fps_numerator ? 10 : 0;
+			enc->variable_framerate = FALSE;
 			break;
 		}
 		case PROP_BITRATE:
 		{
 			enc->bitrate = g_value_get_long(value);
+			gst_sh_video_enc_request_change(enc, CHANGE_BITRATE);
 			break;
 		}
 		case PROP_I_VOP_INTERVAL:
 		{
 			enc->i_vop_interval = g_value_get_long(value);
+			gst_sh_video_enc_request_change(enc, CHANGE_I_VOP_INTERVAL);
 			break;
 		}
 		case PROP_MV_MODE:
@@ -1588,6 +2797,7 @@ gst_sh_video_enc_set_property(GObject * object, guint prop_id,
 		case PROP_QUANT_MIN:
 		{
 			enc->quant_min = g_value_get_ulong(value);
+			gst_sh_video_enc_request_change(enc, CHANGE_QUANT);
 			break;
 		}
 		case PROP_QUANT_MIN_I_VOP_UNDER_RANGE:
@@ -1598,6 +2808,7 @@ gst_sh_video_enc_set_property(GObject * object, guint prop_id,
 		case PROP_QUANT_MAX:
 		{
 			enc->quant_max = g_value_get_ulong(value);
+			gst_sh_video_enc_request_change(enc, CHANGE_QUANT);
 			break;
 		}
 		case PROP_PARAM_CHANGEABLE:
@@ -1962,21 +3173,180 @@ gst_sh_video_enc_set_property(GObject * object, guint prop_id,
 			enc->constrained_intra_pred = g_value_get_ulong(value);
 			break;
 		}
-		default:
+	/* ELEMENT */
+		case PROP_QUEUE_DEPTH:
 		{
-			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, 
-							   pspec);
+			enc->queue_depth = g_value_get_uint(value);
 			break;
 		}
-	}
-}
-
-static void
-gst_sh_video_enc_get_property(GObject * object, guint prop_id,
-		GValue * value, GParamSpec * pspec)
-{
-	GstSHVideoEnc *enc = GST_SH_VIDEO_ENC(object);
-
+		case PROP_READ_AHEAD:
+		{
+			enc->read_ahead = g_value_get_uint(value);
+			break;
+		}
+		case PROP_POOL_SIZE:
+		{
+			enc->pool_size = g_value_get_uint(value);
+			break;
+		}
+		case PROP_LOW_LATENCY:
+		{
+			enc->low_latency = g_value_get_boolean(value);
+			break;
+		}
+		case PROP_OUTPUT_QUEUE_SIZE:
+		{
+			enc->output_queue_size = g_value_get_uint(value);
+			break;
+		}
+		case PROP_RTP:
+		{
+			enc->rtp = g_value_get_boolean(value);
+			break;
+		}
+		case PROP_MTU:
+		{
+			enc->mtu = g_value_get_uint(value);
+			break;
+		}
+		case PROP_PT:
+		{
+			enc->pt = g_value_get_uint(value);
+			break;
+		}
+		case PROP_SSRC:
+		{
+			enc->ssrc = g_value_get_uint(value);
+			break;
+		}
+		case PROP_DROP_POLICY:
+		{
+			string = g_value_get_string(value);
+
+			if (!string)
+			{
+				GST_WARNING_OBJECT(enc, "No drop policy given");
+			}
+			else if (!strcmp(string, DROP_POLICY_NAME_BLOCK))
+			{
+				enc->drop_policy = DROP_POLICY_BLOCK;
+			}
+			else if (!strcmp(string, DROP_POLICY_NAME_OLDEST))
+			{
+				enc->drop_policy = DROP_POLICY_OLDEST;
+			}
+			else if (!strcmp(string, DROP_POLICY_NAME_NEWEST))
+			{
+				enc->drop_policy = DROP_POLICY_NEWEST;
+			}
+			else
+			{
+				GST_WARNING_OBJECT(enc, "Unknown drop policy %s",
+						   string);
+			}
+			break;
+		}
+		case PROP_RATE_CONTROL:
+		{
+			const rate_control_policy *policy;
+
+			string = g_value_get_string(value);
+			policy = string ? rate_control_find_policy(string) : NULL;
+			if (policy)
+			{
+				enc->rate_policy = policy;
+			}
+			else
+			{
+				GST_WARNING_OBJECT(enc, "Unknown rate control policy %s",
+						   string ? string : "(null)");
+			}
+			break;
+		}
+		case PROP_TARGET_BITRATE:
+		{
+			enc->target_bitrate = g_value_get_long(value);
+			break;
+		}
+		case PROP_RATE_CONTROL_TRACE:
+		{
+			g_free(enc->rate_trace_name);
+			enc->rate_trace_name = g_value_dup_string(value);
+			break;
+		}
+		case PROP_STATS_INTERVAL:
+		{
+			enc->stats_interval = g_value_get_uint(value);
+			break;
+		}
+		case PROP_PRESET:
+		{
+			const enc_preset *preset;
+
+			string = g_value_get_string(value);
+			preset = string ? enc_preset_find(string) : NULL;
+			if (preset)
+			{
+				enc->preset = preset;
+			}
+			else
+			{
+				GST_WARNING_OBJECT(enc, "Unknown preset %s", 
+						   string ? string : "(null)");
+			}
+			break;
+		}
+		case PROP_SIMULCAST:
+		{
+			GST_OBJECT_LOCK(enc);
+			g_free(enc->simulcast);
+			enc->simulcast = g_value_dup_string(value);
+			gst_sh_video_enc_parse_simulcast(enc);
+			GST_OBJECT_UNLOCK(enc);
+			break;
+		}
+		case PROP_VPU_PRIORITY:
+		{
+			enc->vpu_priority = g_value_get_int(value);
+			vpu_sched_client_set_share(enc->vpu, enc->vpu_priority, 
+						   enc->vpu_weight);
+			break;
+		}
+		case PROP_VPU_WEIGHT:
+		{
+			enc->vpu_weight = g_value_get_uint(value);
+			vpu_sched_client_set_share(enc->vpu, enc->vpu_priority, 
+						   enc->vpu_weight);
+			break;
+		}
+		case PROP_SCENE_CUT_THRESHOLD:
+		{
+			enc->scene_cut_threshold = g_value_get_uint(value);
+			// Who places the periodic key frames may change
+			gst_sh_video_enc_request_change(enc, CHANGE_I_VOP_INTERVAL);
+			break;
+		}
+		case PROP_SCENE_CUT_RESTART_GOP:
+		{
+			enc->scene_cut_restart_gop = g_value_get_boolean(value);
+			gst_sh_video_enc_request_change(enc, CHANGE_I_VOP_INTERVAL);
+			break;
+		}
+		default:
+		{
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, 
+							   pspec);
+			break;
+		}
+	}
+}
+
+static void
+gst_sh_video_enc_get_property(GObject * object, guint prop_id,
+		GValue * value, GParamSpec * pspec)
+{
+	GstSHVideoEnc *enc = GST_SH_VIDEO_ENC(object);
+
 	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
 
 	switch (prop_id) 
@@ -2348,734 +3718,3477 @@ gst_sh_video_enc_get_property(GObject * object, guint prop_id,
 		}
 		case PROP_RATECONTROL_CPB_I_VOP_NOSKIP:
 		{
-			g_value_set_ulong(value, enc->ratecontrol_cpb_i_vop_noskip);
-			break;
+			g_value_set_ulong(value, enc->ratecontrol_cpb_i_vop_noskip);
+			break;
+		}
+		case PROP_RATECONTROL_CPB_REMAIN_ZERO_SKIP_ENABLE:
+		{
+			g_value_set_ulong(value, enc->ratecontrol_cpb_remain_zero_skip_enable);
+			break;
+		}
+		case PROP_RATECONTROL_CPB_BUFFER_UNIT_SIZE:
+		{
+			g_value_set_ulong(value, enc->ratecontrol_cpb_buffer_unit_size);
+			break;
+		}
+		case PROP_RATECONTROL_CPB_BUFFER_MODE:
+		{
+			g_value_set_ulong(value, enc->ratecontrol_cpb_buffer_mode);
+			break;
+		}
+		case PROP_RATECONTROL_CPB_MAX_SIZE:
+		{
+			g_value_set_ulong(value, enc->ratecontrol_cpb_max_size);
+			break;
+		}
+		case PROP_RATECONTROL_CPB_OFFSET:
+		{
+			g_value_set_ulong(value, enc->ratecontrol_cpb_offset);
+			break;
+		}
+		case PROP_RATECONTROL_CPB_OFFSET_RATE:
+		{
+			g_value_set_ulong(value, enc->ratecontrol_cpb_offset_rate);
+			break;
+		}
+		case PROP_INTRA_THR_1:
+		{
+			g_value_set_ulong(value, enc->intra_thr_1);
+			break;
+		}
+		case PROP_INTRA_THR_2:
+		{
+			g_value_set_ulong(value, enc->intra_thr_2);
+			break;
+		}
+		case PROP_SAD_INTRA_BIAS:
+		{
+			g_value_set_ulong(value, enc->sad_intra_bias);
+			break;
+		}
+		case PROP_REGULARLY_INSERTED_I_TYPE:
+		{
+			g_value_set_ulong(value, enc->regularly_inserted_i_type);
+			break;
+		}
+		case PROP_CALL_UNIT:
+		{
+			g_value_set_ulong(value, enc->call_unit);
+			break;
+		}
+		case PROP_USE_SLICE:
+		{
+			g_value_set_ulong(value, enc->use_slice);
+			break;
+		}
+		case PROP_SLICE_SIZE_MB:
+		{
+			g_value_set_ulong(value, enc->slice_size_mb);
+			break;
+		}
+		case PROP_SLICE_SIZE_BIT:
+		{
+			g_value_set_ulong(value, enc->slice_size_bit);
+			break;
+		}
+		case PROP_SLICE_TYPE_VALUE_PATTERN:
+		{
+			g_value_set_ulong(value, enc->slice_type_value_pattern);
+			break;
+		}
+		case PROP_USE_MB_PARTITION:
+		{
+			g_value_set_ulong(value, enc->use_mb_partition);
+			break;
+		}
+		case PROP_MB_PARTITION_VECTOR_THR:
+		{
+			g_value_set_ulong(value, enc->mb_partition_vector_thr);
+			break;
+		}
+		case PROP_DEBLOCKING_MODE:
+		{
+			g_value_set_ulong(value, enc->deblocking_mode);
+			break;
+		}
+		case PROP_USE_DEBLOCKING_FILTER_CONTROL:
+		{
+			g_value_set_ulong(value, enc->use_deblocking_filter_control);
+			break;
+		}
+		case PROP_DEBLOCKING_ALPHA_OFFSET:
+		{
+			g_value_set_long(value, enc->deblocking_alpha_offset);
+			break;
+		}
+		case PROP_DEBLOCKING_BETA_OFFSET:
+		{
+			g_value_set_long(value, enc->deblocking_beta_offset);
+			break;
+		}	
+		case PROP_ME_SKIP_MODE:
+		{
+			g_value_set_ulong(value, enc->me_skip_mode);
+			break;
+		}
+		case PROP_PUT_START_CODE:
+		{
+			g_value_set_ulong(value, enc->put_start_code);
+			break;
+		}
+		case PROP_SEQ_PARAM_SET_ID:
+		{
+			g_value_set_ulong(value, enc->seq_param_set_id);
+			break;
+		}
+		case PROP_PROFILE:
+		{
+			g_value_set_ulong(value, enc->profile);
+			break;
+		}
+		case PROP_CONSTRAINT_SET_FLAG:
+		{
+			g_value_set_ulong(value, enc->constraint_set_flag);
+			break;
+		}
+		case PROP_LEVEL_TYPE:
+		{
+			g_value_set_ulong(value, enc->level_type);
+			break;
+		}
+		case PROP_LEVEL_VALUE:
+		{
+			g_value_set_ulong(value, enc->level_value);
+			break;
+		}
+		case PROP_OUT_VUI_PARAMETERS:
+		{
+			g_value_set_ulong(value, enc->out_vui_parameters);
+			break;
+		}
+		case PROP_CHROMA_QP_INDEX_OFFSET:
+		{
+			g_value_set_ulong(value, enc->chroma_qp_index_offset);
+			break;
+		}
+		case PROP_CONSTRAINED_INTRA_PRED:
+		{
+			g_value_set_ulong(value, enc->constrained_intra_pred);
+			break;
+		}
+	/* ELEMENT */
+		case PROP_QUEUE_DEPTH:
+		{
+			g_value_set_uint(value, enc->queue_depth);
+			break;
+		}
+		case PROP_QUEUE_LEVEL:
+		{
+			g_value_set_uint(value, enc->input_queue ? 
+				ring_buffer_get_fill_level(enc->input_queue) : 0);
+			break;
+		}
+		case PROP_READ_AHEAD:
+		{
+			g_value_set_uint(value, enc->read_ahead);
+			break;
+		}
+		case PROP_POOL_SIZE:
+		{
+			g_value_set_uint(value, enc->pool_size);
+			break;
+		}
+		case PROP_DROP_POLICY:
+		{
+			switch (enc->drop_policy)
+			{
+				case DROP_POLICY_OLDEST:
+				{
+					g_value_set_string(value, DROP_POLICY_NAME_OLDEST);
+					break;
+				}
+				case DROP_POLICY_NEWEST:
+				{
+					g_value_set_string(value, DROP_POLICY_NAME_NEWEST);
+					break;
+				}
+				default:
+				{
+					g_value_set_string(value, DROP_POLICY_NAME_BLOCK);
+					break;
+				}
+			}
+			break;
+		}
+		case PROP_RATE_CONTROL:
+		{
+			g_value_set_string(value, enc->rate_policy->name);
+			break;
+		}
+		case PROP_TARGET_BITRATE:
+		{
+			g_value_set_long(value, enc->target_bitrate);
+			break;
+		}
+		case PROP_RATE_CONTROL_TRACE:
+		{
+			g_value_set_string(value, enc->rate_trace_name);
+			break;
+		}
+		case PROP_STATS_FPS:
+		case PROP_STATS_BITRATE:
+		case PROP_STATS_LATENCY_P50:
+		case PROP_STATS_LATENCY_P99:
+		case PROP_STATS_ENCODER_LOAD:
+		{
+			enc_stats_summary summary;
+
+			enc_stats_summarize(enc->stats, STATS_WINDOW, &summary);
+			if (prop_id == PROP_STATS_FPS)
+			{
+				g_value_set_double(value, summary.fps);
+			}
+			else if (prop_id == PROP_STATS_BITRATE)
+			{
+				g_value_set_uint(value, summary.bitrate);
+			}
+			else if (prop_id == PROP_STATS_LATENCY_P50)
+			{
+				g_value_set_uint(value, summary.latency_p50);
+			}
+			else if (prop_id == PROP_STATS_LATENCY_P99)
+			{
+				g_value_set_uint(value, summary.latency_p99);
+			}
+			else
+			{
+				g_value_set_double(value, summary.load);
+			}
+			break;
+		}
+		case PROP_STATS_INTERVAL:
+		{
+			g_value_set_uint(value, enc->stats_interval);
+			break;
+		}
+		case PROP_PRESET:
+		{
+			g_value_set_string(value, enc->preset->name);
+			break;
+		}
+		case PROP_SIMULCAST:
+		{
+			g_value_set_string(value, enc->simulcast);
+			break;
+		}
+		case PROP_VPU_PRIORITY:
+		{
+			g_value_set_int(value, enc->vpu_priority);
+			break;
+		}
+		case PROP_VPU_WEIGHT:
+		{
+			g_value_set_uint(value, enc->vpu_weight);
+			break;
+		}
+		case PROP_SCENE_CUT_THRESHOLD:
+		{
+			g_value_set_uint(value, enc->scene_cut_threshold);
+			break;
+		}
+		case PROP_SCENE_CUT_RESTART_GOP:
+		{
+			g_value_set_boolean(value, enc->scene_cut_restart_gop);
+			break;
+		}
+		case PROP_VPU_LOAD:
+		case PROP_VPU_DEADLINE_MISSES:
+		{
+			vpu_sched_stats vpu_stats;
+
+			vpu_sched_client_get_stats(enc->vpu, &vpu_stats);
+			if (prop_id == PROP_VPU_LOAD)
+			{
+				g_value_set_double(value, vpu_stats.load);
+			}
+			else
+			{
+				g_value_set_uint(value, vpu_stats.missed);
+			}
+			break;
+		}
+		case PROP_FRAMES_DROPPED:
+		{
+			g_value_set_uint(value, g_atomic_int_get(&enc->frames_dropped));
+			break;
+		}
+		case PROP_LOW_LATENCY:
+		{
+			g_value_set_boolean(value, enc->low_latency);
+			break;
+		}
+		case PROP_OUTPUT_QUEUE_SIZE:
+		{
+			g_value_set_uint(value, enc->output_queue_size);
+			break;
+		}
+		case PROP_RTP:
+		{
+			g_value_set_boolean(value, enc->rtp);
+			break;
+		}
+		case PROP_MTU:
+		{
+			g_value_set_uint(value, enc->mtu);
+			break;
+		}
+		case PROP_PT:
+		{
+			g_value_set_uint(value, enc->pt);
+			break;
+		}
+		case PROP_SSRC:
+		{
+			g_value_set_uint(value, enc->ssrc);
+			break;
+		}
+		case PROP_OUTPUT_QUEUE_HIGH_WATER:
+		{
+			g_value_set_uint(value, enc->output_high_water);
+			break;
+		}
+		case PROP_FRAMES_ENCODED:
+		{
+			g_value_set_uint(value, enc->frame_number);
+			break;
+		}
+		default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+	}
+}
+
+static gboolean 
+gst_sh_video_enc_sink_event(GstPad * pad, GstEvent * event)
+{
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));  
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	gst_sh_video_enc_forward_event(enc, event);
+
+	if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START)
+	{
+		/* Unblocks downstream first, so that the push task can be 
+		   stopped. The encoder thread ends its stream. */
+		GST_DEBUG_OBJECT(enc, "Flushing");
+		enc->stream_stopped = TRUE;
+		enc->output_stopped = TRUE;
+		vpu_sched_client_set_flushing(enc->vpu, TRUE);
+		gst_sh_video_enc_wake_threads(enc);
+		gst_pad_push_event(enc->srcpad, event);
+		gst_pad_stop_task(enc->srcpad);
+		return TRUE;
+	}
+	else if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
+	{
+		/* The data after the flush is encoded as a new stream */
+		gst_sh_video_enc_reset(enc);
+		return gst_pad_push_event(enc->srcpad, event);
+	}
+	else if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) 
+	{
+		if (enc->enc_thread)
+		{
+			/* The encoder thread sends EOS after the queued frames */
+			gst_sh_video_enc_end_of_input(enc);
+			gst_event_unref(event);
+			return TRUE;
+		}
+		enc->eos = TRUE;
+	}
+	else if (gst_sh_video_enc_is_force_key_unit(event))
+	{
+		/* Serialized with the buffers, it tags the next frame. A new
+		   event is sent downstream in front of the key frame. */
+		GST_DEBUG_OBJECT(enc, "Key unit requested by upstream");
+		enc->key_unit_next_frame = TRUE;
+		gst_event_unref(event);
+		return TRUE;
+	}
+	else if (GST_EVENT_IS_SERIALIZED(event) && enc->enc_thread)
+	{
+		/* Must not overtake the frames still in the queues, the event
+		   travels with the next frame */
+		pthread_mutex_lock(&enc->mutex);
+		enc->pending_events = g_list_append(enc->pending_events, event);
+		pthread_mutex_unlock(&enc->mutex);
+		return TRUE;
+	}
+
+	return gst_pad_push_event(enc->srcpad, event);
+}
+
+static gboolean
+gst_sh_video_enc_src_event(GstPad * pad, GstEvent * event)
+{
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));  
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	if (gst_sh_video_enc_is_force_key_unit(event))
+	{
+		// The encoder thread takes it with the next frame
+		GST_DEBUG_OBJECT(enc, "Key unit requested by downstream");
+		g_atomic_int_set(&enc->force_key_unit, TRUE);
+		gst_event_unref(event);
+		return TRUE;
+	}
+
+	if (GST_EVENT_TYPE(event) == GST_EVENT_QOS)
+	{
+		gdouble proportion;
+		GstClockTimeDiff diff;
+		GstClockTime timestamp;
+
+		// Read by the rate controller, upstream gets the event too
+		gst_event_parse_qos(event, &proportion, &diff, &timestamp);
+		g_atomic_int_set(&enc->qos_proportion, (gint)(proportion * 1000));
+	}
+
+	return gst_pad_event_default(pad, event);
+}
+
+static void
+gst_sh_video_enc_request_change(GstSHVideoEnc *enc, gint change)
+{
+	gint changes;
+
+	if (!enc->encoder)
+	{
+		return;
+	}
+
+	do
+	{
+		changes = g_atomic_int_get(&enc->pending_changes);
+	}
+	while (!g_atomic_int_compare_and_exchange(&enc->pending_changes, changes,
+						  changes | change));
+}
+
+static enc_stats_frame_type
+gst_sh_video_enc_frame_type(GstSHVideoEnc *enc, GstBuffer *buffer, 
+			    gboolean sync_point)
+{
+	gint vop_type;
+
+	if (sync_point)
+	{
+		return ENC_STATS_FRAME_I;
+	}
+
+	// The H.264 encoder makes no B slices
+	vop_type = enc->format == SHCodecs_Format_MPEG4 && !enc->rtp ?
+		bitstream_mpeg4_vop_type(GST_BUFFER_DATA(buffer),
+					 GST_BUFFER_SIZE(buffer)) : -1;
+	return vop_type == MPEG4_VOP_B ? ENC_STATS_FRAME_B : ENC_STATS_FRAME_P;
+}
+
+static void
+gst_sh_video_enc_count_frame(GstSHVideoEnc *enc, GstClockTime timestamp, 
+			     guint size, enc_stats_frame_type type)
+{
+	gst_sh_video_enc_record_stats(enc, timestamp, size, type);
+
+	if (enc->rate_control)
+	{
+		gst_sh_video_enc_update_rate_control(enc, timestamp, size);
+	}
+}
+
+static void
+gst_sh_video_enc_finish_slices(GstSHVideoEnc *enc)
+{
+	if (!enc->slices_pending)
+	{
+		return;
+	}
+	enc->slices_pending = FALSE;
+
+	gst_sh_video_enc_count_frame(enc, enc->slices_timestamp, 
+				     enc->slices_size, enc->slices_type);
+}
+
+static void
+gst_sh_video_enc_record_stats(GstSHVideoEnc *enc, GstClockTime timestamp,
+			      guint size, enc_stats_frame_type type)
+{
+	enc_stats_record record;
+	enc_stats_summary summary;
+
+	record.timestamp = timestamp;
+	record.output_time = enc_stats_now();
+	record.size = size;
+	record.type = type;
+	record.latency = enc->pending_arrival ? 
+		record.output_time - enc->pending_arrival : 0;
+	record.busy = enc->encode_start ?
+		record.output_time - enc->encode_start : 0;
+
+	enc_stats_add(enc->stats, &record);
+
+	if (!enc->stats_interval || 
+	    record.output_time - enc->stats_last_post < 
+	    (guint64)enc->stats_interval * 1000)
+	{
+		return;
+	}
+	enc->stats_last_post = record.output_time;
+
+	enc_stats_summarize(enc->stats, STATS_WINDOW, &summary);
+	gst_element_post_message(GST_ELEMENT(enc),
+		gst_message_new_element(GST_OBJECT(enc),
+			gst_structure_new("GstSHVideoEncStats",
+					  "frames", G_TYPE_UINT, 
+					  (guint) enc->frame_number,
+					  "fps", G_TYPE_DOUBLE, summary.fps,
+					  "bitrate", G_TYPE_UINT, summary.bitrate,
+					  "latency-p50", G_TYPE_UINT, 
+					  summary.latency_p50,
+					  "latency-p99", G_TYPE_UINT, 
+					  summary.latency_p99,
+					  "encoder-load", G_TYPE_DOUBLE, summary.load,
+					  "frames-dropped", G_TYPE_UINT,
+					  g_atomic_int_get(&enc->frames_dropped),
+					  NULL)));
+}
+
+static void
+gst_sh_video_enc_update_rate_control(GstSHVideoEnc *enc, 
+				     GstClockTime timestamp, guint size)
+{
+	rate_control_sample sample;
+
+	gst_sh_video_enc_rate_sample(enc, &sample, timestamp, size, FALSE);
+
+	if (rate_control_update(enc->rate_control, &sample))
+	{
+		GST_DEBUG_OBJECT(enc, "Rate control: %ld bps, skip interval %d",
+				 enc->rate_control->bitrate, 
+				 enc->rate_control->skip_interval);
+		// The bitrate property stays as the user set it
+		enc->applied_bitrate = enc->rate_control->bitrate;
+		gst_sh_video_enc_request_change(enc, CHANGE_BITRATE);
+	}
+}
+
+static void
+gst_sh_video_enc_rate_sample(GstSHVideoEnc *enc, rate_control_sample *sample,
+			     GstClockTime timestamp, guint size, 
+			     gboolean skipped)
+{
+	sample->timestamp = timestamp;
+	sample->frame_bytes = size;
+	sample->queue_level = ring_buffer_get_fill_level(enc->output_queue);
+	sample->queue_size = ring_buffer_get_capacity(enc->output_queue);
+	sample->qos_proportion = 
+		g_atomic_int_get(&enc->qos_proportion) / 1000.0;
+	sample->target_bitrate = enc->target_bitrate ? enc->target_bitrate : 
+		enc->bitrate;
+	sample->skipped = skipped;
+
+	if (enc->rate_trace)
+	{
+		rate_control_write_sample(enc->rate_trace, sample);
+	}
+}
+
+/* Bitrate for libshcodecs, the one chosen by the rate controller if any. 
+   libshcodecs assumes VFR_FRAMERATE with variable framerate input. */
+static glong
+gst_sh_video_enc_encoder_bitrate(GstSHVideoEnc *enc)
+{
+	glong bitrate = enc->applied_bitrate ? enc->applied_bitrate : 
+		enc->bitrate;
+
+	if (enc->fps_numerator || !enc->applied_interval)
+	{
+		return bitrate;
+	}
+	return gst_util_uint64_scale(bitrate, 
+			enc->applied_interval * VFR_FRAMERATE, 10 * GST_SECOND);
+}
+
+static void
+gst_sh_video_enc_apply_changes(GstSHVideoEnc *enc)
+{
+	gint changes;
+	glong bitrate;
+	gint ret_min, ret_max;
+
+	do
+	{
+		changes = g_atomic_int_get(&enc->pending_changes);
+	}
+	while (changes && 
+	       !g_atomic_int_compare_and_exchange(&enc->pending_changes, 
+						  changes, 0));
+
+	if (changes & CHANGE_BITRATE)
+	{
+		bitrate = gst_sh_video_enc_encoder_bitrate(enc);
+		if (enc->changeable_max_bitrate && 
+		    bitrate > (glong)enc->changeable_max_bitrate)
+		{
+			GST_WARNING_OBJECT(enc, "Bitrate %ld limited to %lu", bitrate,
+					   enc->changeable_max_bitrate);
+			bitrate = enc->changeable_max_bitrate;
+		}
+
+		if (!enc->param_changeable && !enc->variable_framerate)
+		{
+			GST_WARNING_OBJECT(enc, "param-changeable is 0, the rate "
+					   "control may keep the old bitrate");
+		}
+
+		GST_DEBUG_OBJECT(enc, "Changing bitrate to %ld", bitrate);
+		if (shcodecs_encoder_set_bitrate(enc->encoder, bitrate) == -1)
+		{
+			GST_WARNING_OBJECT(enc, "Bitrate %ld not accepted", bitrate);
+		}
+	}
+
+	// 0 stands for the default, which was set at init
+	if ((changes & CHANGE_QUANT) && enc->quant_min && enc->quant_max)
+	{
+		GST_DEBUG_OBJECT(enc, "Changing quantizer range to %lu-%lu", 
+				 enc->quant_min, enc->quant_max);
+		// The setters return the old value or -1
+		if (enc->format == SHCodecs_Format_H264)
+		{
+			ret_min = shcodecs_encoder_set_h264_quant_min(enc->encoder, 
+								     enc->quant_min);
+			ret_max = shcodecs_encoder_set_h264_quant_max(enc->encoder, 
+								     enc->quant_max);
+		}
+		else
+		{
+			ret_min = shcodecs_encoder_set_mpeg4_quant_min(enc->encoder, 
+								      enc->quant_min);
+			ret_max = shcodecs_encoder_set_mpeg4_quant_max(enc->encoder, 
+								      enc->quant_max);
+		}
+		if (ret_min == -1)
+		{
+			GST_WARNING_OBJECT(enc, "quant-min %lu not accepted", 
+					   enc->quant_min);
+		}
+		if (ret_max == -1)
+		{
+			GST_WARNING_OBJECT(enc, "quant-max %lu not accepted", 
+					   enc->quant_max);
+		}
+	}
+
+	if (changes & CHANGE_I_VOP_INTERVAL)
+	{
+		GST_DEBUG_OBJECT(enc, "Changing I-VOP interval to %ld", 
+				 enc->i_vop_interval);
+		if (shcodecs_encoder_set_I_vop_interval(enc->encoder, 
+				gst_sh_video_enc_vop_interval(enc)) == -1)
+		{
+			GST_WARNING_OBJECT(enc, "I-VOP interval not accepted");
+		}
+	}
+}
+
+static gboolean
+gst_sh_video_enc_is_force_key_unit(GstEvent * event)
+{
+	const GstStructure *structure;
+
+	if (GST_EVENT_TYPE(event) != GST_EVENT_CUSTOM_DOWNSTREAM &&
+	    GST_EVENT_TYPE(event) != GST_EVENT_CUSTOM_UPSTREAM)
+	{
+		return FALSE;
+	}
+
+	structure = gst_event_get_structure(event);
+	return structure && gst_structure_has_name(structure, "GstForceKeyUnit");
+}
+
+static gboolean
+gst_sh_video_enc_set_caps(GstPad * pad, GstCaps * caps)
+{
+	gboolean ret;
+	GstStructure *structure;
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));
+
+    if (enc->caps_set)
+	{
+		return TRUE;
+	}
+
+	ret = TRUE;
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	// get input size
+	structure = gst_caps_get_structure(caps, 0);
+	ret = gst_structure_get_int(structure, "width", &enc->width);
+	ret &= gst_structure_get_int(structure, "height", &enc->height);
+	ret &= gst_structure_get_fraction(structure, "framerate", 
+						 &enc->fps_numerator, 
+						 &enc->fps_denominator);
+	enc->variable_framerate = ret && !enc->fps_numerator && 
+		enc->fps_denominator == 1;
+
+	gst_structure_get_fourcc(structure, "format", &enc->fourcc);
+
+	// Padded frames, optional
+	gst_structure_get_int(structure, "rowstride", &enc->rowstride);
+	gst_structure_get_int(structure, "chroma-offset", &enc->chroma_offset);
+
+	if (!ret) 
+	{
+		return ret;
+	}
+
+	gst_sh_video_enc_read_src_caps(enc);
+	gst_sh_video_enc_init_encoder(enc);
+	if (!enc->encoder)
+	{
+		return FALSE;
+	}
+
+	// RTP caps don't depend on what downstream accepts
+	if (enc->rtp || !gst_caps_is_any(enc->out_caps))
+	{
+		ret = gst_sh_video_enc_set_src_caps(enc);
+	}
+		
+	if (ret) 
+	{
+		enc->caps_set = TRUE;
+	}
+
+	return ret;
+}
+
+void
+gst_sh_video_enc_read_sink_caps(GstSHVideoEnc * enc)
+{
+	GstStructure *structure;
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	// get the caps of the previous element in chain
+	enc->out_caps = gst_pad_peer_get_caps(enc->sinkpad);
+	
+	if (!gst_caps_is_any(enc->out_caps))
+	{
+		structure = gst_caps_get_structure(enc->out_caps, 0);
+        if (!enc->width)
+		{
+	    	gst_structure_get_int(structure, "width", &enc->width);
+		}
+        if (!enc->height)
+		{
+		    gst_structure_get_int(structure, "height", &enc->height);
+		}
+        if (!enc->fps_numerator)
+		{
+		    if (gst_structure_get_fraction(structure, "framerate", 
+										 &enc->fps_numerator, 
+										 &enc->fps_denominator))
+			{
+				enc->variable_framerate = !enc->fps_numerator && 
+					enc->fps_denominator == 1;
+			}
+		}
+		gst_structure_get_fourcc(structure, "format", &enc->fourcc);
+		if (!enc->rowstride)
+		{
+			gst_structure_get_int(structure, "rowstride", &enc->rowstride);
+		}
+		if (!enc->chroma_offset)
+		{
+			gst_structure_get_int(structure, "chroma-offset", 
+					      &enc->chroma_offset);
+		}
+	}
+}
+
+void
+gst_sh_video_enc_read_src_caps(GstSHVideoEnc * enc)
+{
+	GstStructure *structure;
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	// get the caps of the next element in chain
+	enc->out_caps = gst_pad_peer_get_caps(enc->srcpad);
+	
+	if (!gst_caps_is_any(enc->out_caps) && 
+		enc->format == SHCodecs_Format_NONE)
+	{
+		structure = gst_caps_get_structure(enc->out_caps, 0);
+		if (!strcmp(gst_structure_get_name(structure), "video/mpeg")) 
+		{
+			enc->format = SHCodecs_Format_MPEG4;
+		}
+		else if (!strcmp(gst_structure_get_name(structure), 
+				  "video/x-h264")) 
+		{
+			enc->format = SHCodecs_Format_H264;
+		}
+	}
+}
+
+gboolean
+gst_sh_video_enc_set_src_caps(GstSHVideoEnc * enc)
+{
+	GstCaps* caps = NULL;
+	gboolean ret = TRUE;
+	
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	if (enc->rtp && enc->format != SHCodecs_Format_NONE)
+	{
+		caps = gst_sh_video_enc_get_rtp_caps(enc);
+	}
+	else if (enc->format == SHCodecs_Format_MPEG4)
+	{
+		caps = gst_caps_new_simple("video/mpeg", "width", G_TYPE_INT, 
+				enc->width, "height", G_TYPE_INT, 
+				enc->height, "framerate", 
+				GST_TYPE_FRACTION, enc->fps_numerator, 
+				enc->fps_denominator, "mpegversion", 
+				G_TYPE_INT, 4, NULL);
+	}
+	else if (enc->format == SHCodecs_Format_H264)
+	{
+		caps = gst_caps_new_simple("video/x-h264", "width", G_TYPE_INT, 
+				enc->width, "height", G_TYPE_INT, 
+				enc->height, "framerate", 
+				GST_TYPE_FRACTION, enc->fps_numerator, 
+				enc->fps_denominator, NULL);
+
+		enc->stream_format = 
+			gst_sh_video_enc_negotiate_stream_format(enc);
+		gst_caps_set_simple(caps, "stream-format", G_TYPE_STRING, 
+				    enc->stream_format == STREAM_FORMAT_AVC ?
+				    STREAM_FORMAT_NAME_AVC : 
+				    STREAM_FORMAT_NAME_BYTE_STREAM, NULL);
+		if (gst_sh_video_enc_slice_output(enc))
+		{
+			// Buffers hold single NAL units, not whole frames
+			gst_caps_set_simple(caps, "alignment", G_TYPE_STRING, "nal", 
+					    NULL);
+		}
+	}
+	else
+	{
+		GST_ELEMENT_ERROR((GstElement*)enc, CORE, NEGOTIATION,
+					("Format undefined."), (NULL));
+	}
+
+	if (!gst_pad_set_caps(enc->srcpad, caps))
+	{
+		GST_ELEMENT_ERROR((GstElement*)enc, CORE, NEGOTIATION,
+					("Source pad not linked."), (NULL));
+		ret = FALSE;
+	}
+	if (!gst_pad_set_caps(gst_pad_get_peer(enc->srcpad), caps))
+	{
+		GST_ELEMENT_ERROR((GstElement*)enc, CORE, NEGOTIATION,
+					("Source pad not linked."), (NULL));
+		ret = FALSE;
+	}
+
+	// Kept for the buffers, codec_data is added when it is known
+	gst_caps_replace(&enc->src_caps, caps);
+	gst_buffer_replace(&enc->codec_data, NULL);
+	gst_caps_unref(caps);
+	return ret;
+}
+
+static GstCaps *
+gst_sh_video_enc_get_rtp_caps(GstSHVideoEnc *enc)
+{
+	if (enc->packetizer)
+	{
+		gst_sh_rtp_packetizer_free(enc->packetizer);
+	}
+	enc->packetizer = gst_sh_rtp_packetizer_new(enc->mtu, enc->pt, 
+					enc->ssrc ? enc->ssrc : g_random_int());
+
+	// The packetizer splits byte-stream NAL units
+	enc->stream_format = STREAM_FORMAT_BYTE_STREAM;
+
+	/* The parameter sets or the VOS and VOL headers are added once the 
+	   encoder has written them */
+	return gst_caps_new_simple("application/x-rtp", 
+				   "media", G_TYPE_STRING, "video",
+				   "clock-rate", G_TYPE_INT, RTP_VIDEO_CLOCK_RATE,
+				   "encoding-name", G_TYPE_STRING, 
+				   enc->format == SHCodecs_Format_H264 ? 
+				   "H264" : "MP4V-ES",
+				   "payload", G_TYPE_INT, enc->pt,
+				   "ssrc", G_TYPE_UINT, enc->packetizer->ssrc,
+				   "clock-base", G_TYPE_UINT, 
+				   enc->packetizer->clock_base,
+				   "seqnum-base", G_TYPE_UINT, 
+				   enc->packetizer->seqnum_base,
+				   NULL);
+}
+
+static void
+gst_sh_video_enc_set_rtp_config(GstSHVideoEnc *enc, GstCaps *caps)
+{
+	const guint8 *data;
+	gchar *sps, *pps, *sets, *profile, *config;
+	guint i, size;
+
+	if (enc->format == SHCodecs_Format_H264)
+	{
+		data = GST_BUFFER_DATA(enc->sps);
+		sps = g_base64_encode(data, GST_BUFFER_SIZE(enc->sps));
+		pps = g_base64_encode(GST_BUFFER_DATA(enc->pps), 
+				      GST_BUFFER_SIZE(enc->pps));
+		sets = g_strdup_printf("%s,%s", sps, pps);
+		// profile_idc, constraint flags and level_idc of the SPS
+		profile = g_strdup_printf("%02x%02x%02x", data[1], data[2], 
+					  data[3]);
+
+		gst_caps_set_simple(caps, "sprop-parameter-sets", G_TYPE_STRING,
+				    sets, "profile-level-id", G_TYPE_STRING, 
+				    profile, "packetization-mode", G_TYPE_STRING,
+				    "1", NULL);
+
+		g_free(sps);
+		g_free(pps);
+		g_free(sets);
+		g_free(profile);
+	}
+	else
+	{
+		data = GST_BUFFER_DATA(enc->codec_data);
+		size = GST_BUFFER_SIZE(enc->codec_data);
+
+		config = g_malloc(size * 2 + 1);
+		for (i = 0; i < size; i++)
+		{
+			sprintf(config + i * 2, "%02x", data[i]);
+		}
+		gst_caps_set_simple(caps, "config", G_TYPE_STRING, config, NULL);
+		g_free(config);
+
+		// profile_and_level_indication of the VOS header
+		if (size > 4 && data[0] == 0 && data[1] == 0 && data[2] == 1 && 
+		    data[3] == MPEG4_VOS_START)
+		{
+			profile = g_strdup_printf("%d", data[4]);
+			gst_caps_set_simple(caps, "profile-level-id", 
+					    G_TYPE_STRING, profile, NULL);
+			g_free(profile);
+		}
+	}
+}
+
+static void
+gst_sh_video_enc_store_parameter_sets(GstSHVideoEnc *enc, GstBuffer *unit)
+{
+	const guint8 *end = GST_BUFFER_DATA(unit) + GST_BUFFER_SIZE(unit);
+	const guint8 *nal;
+	const guint8 *next;
+	guint size;
+
+	nal = bitstream_find_start_code(GST_BUFFER_DATA(unit), end);
+	while (nal < end)
+	{
+		nal += 3;
+		next = bitstream_find_start_code(nal, end);
+
+		size = next - nal;
+		while (size && nal[size - 1] == 0)
+		{
+			size--;
+		}
+
+		if (size && (nal[0] & 0x1f) == H264_NAL_SPS)
+		{
+			gst_sh_video_enc_store_nal(enc, &enc->sps, nal, size);
+		}
+		else if (size && (nal[0] & 0x1f) == H264_NAL_PPS)
+		{
+			gst_sh_video_enc_store_nal(enc, &enc->pps, nal, size);
+		}
+		nal = next;
+	}
+}
+
+static gint
+gst_sh_video_enc_negotiate_stream_format(GstSHVideoEnc *enc)
+{
+	GstCaps *allowed;
+	GstStructure *structure;
+	const gchar *format;
+	gint ret = STREAM_FORMAT_BYTE_STREAM;
+	guint i;
+
+	allowed = gst_pad_get_allowed_caps(enc->srcpad);
+	if (!allowed)
+	{
+		return ret;
+	}
+
+	for (i = 0; i < gst_caps_get_size(allowed); i++)
+	{
+		structure = gst_caps_get_structure(allowed, i);
+		if (!gst_structure_has_name(structure, "video/x-h264"))
+		{
+			continue;
+		}
+
+		if (gst_structure_has_field(structure, "stream-format"))
+		{
+			structure = gst_structure_copy(structure);
+			gst_structure_fixate_field_string(structure, 
+					"stream-format", 
+					STREAM_FORMAT_NAME_BYTE_STREAM);
+			format = gst_structure_get_string(structure, 
+							  "stream-format");
+			if (format && !strcmp(format, STREAM_FORMAT_NAME_AVC))
+			{
+				ret = STREAM_FORMAT_AVC;
+			}
+			gst_structure_free(structure);
+		}
+		break;
+	}
+	gst_caps_unref(allowed);
+
+	GST_DEBUG_OBJECT(enc, "Using stream-format %s", 
+			 ret == STREAM_FORMAT_AVC ? STREAM_FORMAT_NAME_AVC :
+			 STREAM_FORMAT_NAME_BYTE_STREAM);
+	return ret;
+}
+
+/* Sets the preset values of the properties the application hasn't set */
+static void
+gst_sh_video_enc_apply_preset(GstSHVideoEnc *enc)
+{
+	const enc_preset_param *param;
+	GParamSpec *pspec;
+	GValue value = { 0, };
+
+	param = enc->format == SHCodecs_Format_H264 ? 
+		enc->preset->h264 : enc->preset->mpeg4;
+
+	for (; param->name; param++)
+	{
+		pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(enc), 
+						     param->name);
+		g_assert(pspec != NULL);
+
+		if (enc->props_set[pspec->param_id / 32] & 
+		    (1U << (pspec->param_id % 32)))
+		{
+			GST_DEBUG_OBJECT(enc, "%s set, preset value ignored", 
+					 param->name);
+			continue;
+		}
+
+		g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+		if (gst_value_deserialize(&value, param->value))
+		{
+			gst_sh_video_enc_set_property(G_OBJECT(enc), pspec->param_id,
+						      &value, pspec);
+			// Another preset may replace it later
+			enc->props_set[pspec->param_id / 32] &= 
+				~(1U << (pspec->param_id % 32));
+		}
+		g_value_unset(&value);
+	}
+
+	GST_DEBUG_OBJECT(enc, "Preset %s applied", enc->preset->name);
+}
+
+void
+gst_sh_video_enc_init_encoder(GstSHVideoEnc * enc)
+{
+	gint ret = 0;
+	glong fmt = 0;
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	if (strlen(enc->ainfo.ctrl_file_name_buf))
+	{
+
+		ret = GetFromCtrlFTop((const char *)
+				enc->ainfo.ctrl_file_name_buf,
+				&enc->ainfo,
+				&fmt);
+		if (ret < 0) 
+		{
+			GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
+				  ("Error reading the top of control file."), 
+				  (NULL));
+		}
+
+		if (enc->format == SHCodecs_Format_NONE)
+		{
+			enc->format = fmt;
+		}
+
+		if (!enc->width)
+		{
+			enc->width = enc->ainfo.xpic;
+		}
+
+		if (!enc->height)
+		{
+			enc->height = enc->ainfo.ypic;
+		}
+		// The control file gives the rate in tenths of a frame
+		if (!enc->fps_numerator && !enc->variable_framerate && 
+		    enc->ainfo.frame_rate)
+		{
+			enc->fps_numerator = enc->ainfo.frame_rate;
+			enc->fps_denominator = 10;
+		}
+
+		// Needed by the rate controller and the VFR bitrate scaling
+		if (!enc->bitrate)
+		{
+			enc->bitrate = enc->ainfo.bitrate;
+		}
+	}
+
+	// Only framerate=0/1 caps stand for variable framerate
+    if (enc->format == SHCodecs_Format_NONE ||
+		!(enc->width && enc->height)||
+		(!enc->fps_numerator && !enc->variable_framerate))
+	{
+		GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
+			("Key parameters are not set."), 
+			("Encoding parameters undefined. Stream format:%d, width:%d, height:%d and framerate: %d/%d",
+			 enc->format, enc->width, enc->height,
+			 enc->fps_numerator, enc->fps_denominator));
+    }
+
+	gst_sh_video_enc_apply_preset(enc);
+
+	/* A context left by a completed stream of this or another element is
+	   reused, the parameters below are set again in any case */
+	if (enc->encoder)
+	{
+		if (enc->enc_thread)
+		{
+			GST_WARNING_OBJECT(enc, "Encoder running, keeping its parameters");
+			return;
+		}
+		encoder_pool_release(enc->encoder, enc->encoder_clean);
+	}
+	enc->encoder = encoder_pool_acquire(enc->width, enc->height, enc->format,
+					    enc->ainfo.ctrl_file_name_buf);
+	enc->encoder_clean = TRUE;
+	if (!enc->encoder)
+	{
+		GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
+			("Initializing the encoder failed."), 
+			("%dx%d format:%d", enc->width, enc->height, enc->format));
+		return;
+	}
+
+	if (!enc->input_queue)
+	{
+		enc->input_queue = ring_buffer_new(enc->queue_depth);
+	}
+	else if (ring_buffer_get_capacity(enc->input_queue) != enc->queue_depth)
+	{
+		/* queue-depth changed since the ring was made, frames already
+		   queued are moved over and the oldest ones dropped if they
+		   don't fit */
+		ring_buffer *queue = ring_buffer_new(enc->queue_depth);
+		GstSHVideoEncFrame *frame;
+
+		GST_DEBUG_OBJECT(enc, "Input queue depth %u -> %u",
+				 ring_buffer_get_capacity(enc->input_queue),
+				 enc->queue_depth);
+		while ((frame = ring_buffer_pop(enc->input_queue)))
+		{
+			if (ring_buffer_is_full(queue))
+			{
+				gst_sh_video_enc_free_frame(ring_buffer_pop(queue));
+			}
+			ring_buffer_push(queue, frame);
+		}
+		ring_buffer_free(enc->input_queue);
+		enc->input_queue = queue;
+	}
+	if (!enc->output_queue)
+	{
+		enc->output_queue = ring_buffer_new(enc->output_queue_size);
+	}
+
+	/* libshcodecs takes tenths of a frame per second, 30000/1001 is 
+	   rounded to 300 instead of being truncated to 290 */
+	if (enc->fps_numerator)
+	{
+		shcodecs_encoder_set_frame_rate(enc->encoder,
+			((gint64)enc->fps_numerator * 10 + enc->fps_denominator / 2) /
+			enc->fps_denominator);
+	}
+	else
+	{
+		GST_DEBUG_OBJECT(enc, "Variable framerate, bitrate follows the "
+				 "frame intervals");
+		shcodecs_encoder_set_frame_rate(enc->encoder, VFR_FRAMERATE);
+	}
+
+	shcodecs_encoder_set_xpic_size(enc->encoder,enc->width);
+	shcodecs_encoder_set_ypic_size(enc->encoder,enc->height);
+
+	shcodecs_encoder_set_input_callback(enc->encoder, 
+					    gst_sh_video_enc_get_input, enc);
+	shcodecs_encoder_set_output_callback(enc->encoder, 
+					     gst_sh_video_enc_write_output, enc);
+
+	if (strlen(enc->ainfo.ctrl_file_name_buf))
+	{
+		ret = GetFromCtrlFtoEncParam(enc->encoder, &enc->ainfo);
+		
+		if (ret < 0) 
+		{
+			GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
+				  ("Error reading parameters from control file."), 
+				  (NULL));
+		}
+	}
+	else
+	{
+		if (!gst_sh_video_enc_set_encoding_properties(enc))
+		{
+			GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
+				  ("Setting SHCodecs encoder properties failed."), 
+				  (NULL));
+		}		
+	}
+
+	// Also overrides the slice settings of a control file
+	enc->slice_output = gst_sh_video_enc_set_slice_output(enc);
+
+	/* With variable framerate the bitrate given to the encoder follows the
+	   frame intervals, which needs a changeable bitrate */
+	if (enc->variable_framerate)
+	{
+		ret = enc->format == SHCodecs_Format_H264 ?
+			shcodecs_encoder_set_h264_param_changeable(enc->encoder, 1) :
+			shcodecs_encoder_set_mpeg4_param_changeable(enc->encoder, 1);
+		if (ret == -1)
+		{
+			GST_WARNING_OBJECT(enc, "param-changeable not accepted, the "
+					   "bitrate won't follow the framerate");
+		}
+	}
+
+	GST_DEBUG_OBJECT(enc, "Encoder init: %ldx%ld %ldfps format:%ld",
+			 shcodecs_encoder_get_xpic_size(enc->encoder),
+			 shcodecs_encoder_get_ypic_size(enc->encoder),
+			 shcodecs_encoder_get_frame_rate(enc->encoder) / 10,
+			 shcodecs_encoder_get_stream_type(enc->encoder)); 
+}
+
+static gboolean
+gst_sh_video_enc_activate(GstPad * pad)
+{
+	gboolean ret;
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+	if (gst_pad_check_pull_range(pad)) 
+	{
+		GST_LOG_OBJECT(enc, "PULL mode");
+		ret = gst_pad_activate_pull(pad, TRUE);
+	} 
+	else 
+	{  
+		GST_LOG_OBJECT(enc, "PUSH mode");
+		ret = gst_pad_activate_push(pad, TRUE);
+	}
+	return ret;
+}
+
+/* Returns to the state before the first buffer, so that the next 
+   READY to PAUSED cycle starts a new stream */
+static void
+gst_sh_video_enc_reset(GstSHVideoEnc *enc)
+{
+	GList *item;
+
+	// The encoder thread has been told to stop, wait for it to return
+	if (enc->enc_thread)
+	{
+		pthread_join(enc->enc_thread, NULL);
+		enc->enc_thread = 0;
+	}
+	vpu_sched_client_set_flushing(enc->vpu, FALSE);
+	gst_sh_video_enc_flush_queue(enc);
+	gst_sh_video_enc_flush_output(enc);
+
+	gst_sh_video_enc_free_events(enc->pending_events);
+	enc->pending_events = NULL;
+	gst_sh_video_enc_free_events(enc->carried_events);
+	enc->carried_events = NULL;
+
+	// Only a context whose stream was completed is given to others
+	if (enc->encoder)
+	{
+		encoder_pool_release(enc->encoder, enc->encoder_clean);
+		enc->encoder = NULL;
+	}
+
+	if (enc->pending_unit)
+	{
+		gst_buffer_unref(enc->pending_unit);
+		enc->pending_unit = NULL;
+	}
+	enc->pending_sync = FALSE;
+	enc->bytes_out = 0;
+	enc->slices_pending = FALSE;
+
+	if (enc->rate_trace)
+	{
+		fclose(enc->rate_trace);
+		enc->rate_trace = NULL;
+	}
+
+	gst_caps_replace(&enc->src_caps, NULL);
+	gst_buffer_replace(&enc->codec_data, NULL);
+	gst_buffer_replace(&enc->sps, NULL);
+	gst_buffer_replace(&enc->pps, NULL);
+
+	enc->key_unit_next_frame = FALSE;
+	enc->force_key_unit = FALSE;
+	enc->key_unit_forced = FALSE;
+	enc->key_unit_announce = FALSE;
+	enc->key_unit_attempts = 0;
+	enc->pending_changes = 0;
+	enc->scene_cut_pending = FALSE;
+	enc->frames_since_key = 0;
+	enc->key_frame_out = FALSE;
+	enc->vop_interval_fallback = FALSE;
+	scene_cut_reset(enc->scene_cut);
+
+	enc->caps_set = FALSE;
+	enc->offset = 0;
+	enc->frame_number = 0;
+	enc->input_frames = 0;
+	enc->cycle_outputs = 0;
+	enc->last_input_timestamp = GST_CLOCK_TIME_NONE;
+	enc->frame_interval = 0;
+	enc->applied_interval = 0;
+	enc->stream_stopped = FALSE;
+	enc->eos = FALSE;
+
+	// The input size may change for the next stream
+	GST_OBJECT_LOCK(enc);
+	for (item = enc->renditions; item; item = item->next)
+	{
+		gst_caps_replace(&((GstSHVideoEncRendition *)item->data)->sink_caps,
+				 NULL);
+		gst_buffer_replace(&((GstSHVideoEncRendition *)item->data)->columns,
+				   NULL);
+	}
+	GST_OBJECT_UNLOCK(enc);
+}
+
+static GstStateChangeReturn
+gst_sh_video_enc_change_state(GstElement *element, GstStateChange transition)
+{
+	GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+	GstSHVideoEnc *enc = GST_SH_VIDEO_ENC(element);
+
+	/* Child encoders are stopped first, so that a blocked child can't 
+	   hold up our streaming thread */
+	gst_sh_video_enc_set_renditions_state(enc, 
+					      GST_STATE_TRANSITION_NEXT(transition));
+
+	ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, 
+							      transition);
+	if (ret == GST_STATE_CHANGE_FAILURE)
+	{
+		return ret;
+	}
+
+	switch (transition) 
+	{
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+		{
+			GST_DEBUG_OBJECT(enc, "Stopping encoding.");
+			enc->stream_stopped = TRUE;        
+			enc->output_stopped = TRUE;
+			vpu_sched_client_set_flushing(enc->vpu, TRUE);
+			gst_sh_video_enc_wake_threads(enc);
+			gst_pad_stop_task(enc->srcpad);
+			gst_sh_video_enc_flush_output(enc);
+			gst_sh_video_enc_reset(enc);
+			break;
+		}
+		default:
+			break;
+	}
+	return ret;
+}
+
+static void
+gst_sh_video_enc_parse_simulcast(GstSHVideoEnc *enc)
+{
+	gchar **items;
+	GstSHVideoEncProfile *profile;
+	guint i;
+
+	enc->n_profiles = 0;
+	if (!enc->simulcast)
+	{
+		return;
+	}
+
+	items = g_strsplit(enc->simulcast, ",", 0);
+	for (i = 0; items[i]; i++)
+	{
+		if (enc->n_profiles == GST_SH_VIDEO_ENC_MAX_PROFILES)
+		{
+			GST_WARNING_OBJECT(enc, "Only %d simulcast profiles supported",
+					   GST_SH_VIDEO_ENC_MAX_PROFILES);
+			break;
+		}
+
+		profile = &enc->profiles[enc->n_profiles];
+		if (sscanf(items[i], " %dx%d@%ld", &profile->width, 
+			   &profile->height, &profile->bitrate) != 3 ||
+		    profile->width < 48 || profile->height < 48 ||
+		    (profile->width & 1) || (profile->height & 1))
+		{
+			/* Skipping it would move the later profiles to other 
+			   src_%d pads */
+			GST_WARNING_OBJECT(enc, "Invalid simulcast profile \"%s\", "
+					   "simulcast disabled", items[i]);
+			enc->n_profiles = 0;
+			break;
+		}
+		enc->n_profiles++;
+	}
+	g_strfreev(items);
+}
+
+static GstFlowReturn
+gst_sh_video_enc_rendition_chain(GstPad *pad, GstBuffer *buffer)
+{
+	GstSHVideoEncRendition *rendition = gst_pad_get_element_private(pad);
+
+	return gst_pad_push(rendition->srcpad, buffer);
+}
+
+static gboolean
+gst_sh_video_enc_rendition_event(GstPad *pad, GstEvent *event)
+{
+	GstSHVideoEncRendition *rendition = gst_pad_get_element_private(pad);
+
+	return gst_pad_push_event(rendition->srcpad, event);
+}
+
+static GstCaps *
+gst_sh_video_enc_rendition_getcaps(GstPad *pad)
+{
+	GstSHVideoEncRendition *rendition = gst_pad_get_element_private(pad);
+	GstCaps *caps;
+
+	// The child encoder negotiates with whatever is linked to src_%d
+	caps = gst_pad_peer_get_caps(rendition->srcpad);
+	if (!caps)
+	{
+		caps = gst_caps_new_any();
+	}
+	return caps;
+}
+
+static gboolean
+gst_sh_video_enc_rendition_setcaps(GstPad *pad, GstCaps *caps)
+{
+	GstSHVideoEncRendition *rendition = gst_pad_get_element_private(pad);
+
+	return gst_pad_set_caps(rendition->srcpad, caps);
+}
+
+static gboolean
+gst_sh_video_enc_rendition_src_event(GstPad *pad, GstEvent *event)
+{
+	GstSHVideoEncRendition *rendition = gst_pad_get_element_private(pad);
+
+	// Key unit requests and QoS go upstream to the child encoder
+	return gst_pad_push_event(rendition->proxy, event);
+}
+
+static void
+gst_sh_video_enc_set_rendition_state(GstSHVideoEnc *enc, 
+				     GstSHVideoEncRendition *rendition,
+				     GstState state)
+{
+	GstBus *bus;
+
+	// Errors of the child encoders are posted on the pipeline bus
+	bus = gst_element_get_bus(GST_ELEMENT(enc));
+	if (bus)
+	{
+		gst_element_set_bus(GST_ELEMENT(rendition->encoder), bus);
+		gst_object_unref(bus);
+	}
+
+	if (state > GST_STATE_READY && 
+	    GST_STATE(rendition->encoder) <= GST_STATE_READY)
+	{
+		/* The frames are chained from our streaming thread, a child 
+		   must never block it */
+		g_object_set(rendition->encoder, 
+			     "bitrate", enc->profiles[rendition->index].bitrate,
+			     "preset", enc->preset->name, 
+			     "rtp", enc->rtp, 
+			     "drop-policy", enc->drop_policy == DROP_POLICY_NEWEST ?
+			     DROP_POLICY_NAME_NEWEST : DROP_POLICY_NAME_OLDEST, 
+			     "vpu-priority", enc->vpu_priority,
+			     "vpu-weight", enc->vpu_weight, NULL);
+
+		if (enc->format != SHCodecs_Format_NONE)
+		{
+			g_object_set(rendition->encoder, "stream-type", 
+				     enc->format == SHCodecs_Format_H264 ? 
+				     STREAM_TYPE_H264 : STREAM_TYPE_MPEG4, NULL);
+		}
+	}
+
+	gst_element_set_state(GST_ELEMENT(rendition->encoder), state);
+}
+
+static void
+gst_sh_video_enc_set_renditions_state(GstSHVideoEnc *enc, GstState state)
+{
+	GList *item;
+
+	// Pads are only requested and released from the application thread
+	for (item = enc->renditions; item; item = item->next)
+	{
+		gst_sh_video_enc_set_rendition_state(enc, 
+				(GstSHVideoEncRendition *)item->data, state);
+	}
+}
+
+static void
+gst_sh_video_enc_free_rendition(GstSHVideoEncRendition *rendition)
+{
+	gst_element_set_state(GST_ELEMENT(rendition->encoder), GST_STATE_NULL);
+	gst_pad_unlink(rendition->encoder->srcpad, rendition->proxy);
+	gst_pad_set_active(rendition->proxy, FALSE);
+	gst_object_unref(rendition->proxy);
+	gst_object_unref(rendition->encoder);
+	gst_caps_replace(&rendition->sink_caps, NULL);
+	gst_buffer_replace(&rendition->columns, NULL);
+	g_free(rendition);
+}
+
+static GstPad *
+gst_sh_video_enc_request_new_pad(GstElement *element, GstPadTemplate *templ,
+				 const gchar *name)
+{
+	GstSHVideoEnc *enc = GST_SH_VIDEO_ENC(element);
+	GstSHVideoEncRendition *rendition;
+	GList *item;
+	guint index, used;
+	gchar *pad_name, *child_name;
+
+	used = 0;
+	for (item = enc->renditions; item; item = item->next)
+	{
+		used |= 1 << ((GstSHVideoEncRendition *)item->data)->index;
+	}
+
+	if (name)
+	{
+		if (sscanf(name, "src_%u", &index) != 1)
+		{
+			GST_WARNING_OBJECT(enc, "Invalid pad name %s", name);
+			return NULL;
+		}
+	}
+	else
+	{
+		for (index = 0; used & (1 << index); index++);
+	}
+
+	if (index >= enc->n_profiles || (used & (1 << index)))
+	{
+		GST_WARNING_OBJECT(enc, "No free simulcast profile %u, %u set", 
+				   index, enc->n_profiles);
+		return NULL;
+	}
+
+	rendition = g_new0(GstSHVideoEncRendition, 1);
+	rendition->index = index;
+
+	pad_name = g_strdup_printf("src_%u", index);
+	rendition->srcpad = gst_pad_new_from_template(templ, pad_name);
+	gst_pad_use_fixed_caps(rendition->srcpad);
+	gst_pad_set_element_private(rendition->srcpad, rendition);
+	gst_pad_set_event_function(rendition->srcpad,
+			GST_DEBUG_FUNCPTR(gst_sh_video_enc_rendition_src_event));
+
+	child_name = g_strdup_printf("%s-%s", GST_ELEMENT_NAME(enc), pad_name);
+	rendition->encoder = g_object_new(GST_TYPE_SH_VIDEO_ENC, 
+					  "name", child_name, NULL);
+	gst_object_ref(rendition->encoder);
+	gst_object_sink(rendition->encoder);
+	g_free(child_name);
+	g_free(pad_name);
+
+	/* The child is not in a bin, its source pad is linked to a pad of 
+	   our own that forwards everything to src_%d */
+	rendition->proxy = gst_pad_new("proxy", GST_PAD_SINK);
+	gst_pad_set_element_private(rendition->proxy, rendition);
+	gst_pad_set_chain_function(rendition->proxy, 
+				   gst_sh_video_enc_rendition_chain);
+	gst_pad_set_event_function(rendition->proxy, 
+				   gst_sh_video_enc_rendition_event);
+	gst_pad_set_getcaps_function(rendition->proxy, 
+				     gst_sh_video_enc_rendition_getcaps);
+	gst_pad_set_setcaps_function(rendition->proxy, 
+				     gst_sh_video_enc_rendition_setcaps);
+	gst_pad_set_active(rendition->proxy, TRUE);
+	gst_pad_link(rendition->encoder->srcpad, rendition->proxy);
+
+	if (GST_STATE(enc) > GST_STATE_READY)
+	{
+		gst_pad_set_active(rendition->srcpad, TRUE);
+	}
+	gst_element_add_pad(element, rendition->srcpad);
+
+	GST_OBJECT_LOCK(enc);
+	enc->renditions = g_list_append(enc->renditions, rendition);
+	GST_OBJECT_UNLOCK(enc);
+
+	gst_sh_video_enc_set_rendition_state(enc, rendition, GST_STATE(enc));
+
+	GST_DEBUG_OBJECT(enc, "Simulcast rendition %u: %dx%d %ld bps", index,
+			 enc->profiles[index].width, enc->profiles[index].height,
+			 enc->profiles[index].bitrate);
+	return rendition->srcpad;
+}
+
+static void
+gst_sh_video_enc_release_pad(GstElement *element, GstPad *pad)
+{
+	GstSHVideoEnc *enc = GST_SH_VIDEO_ENC(element);
+	GstSHVideoEncRendition *rendition = gst_pad_get_element_private(pad);
+
+	GST_OBJECT_LOCK(enc);
+	enc->renditions = g_list_remove(enc->renditions, rendition);
+	GST_OBJECT_UNLOCK(enc);
+
+	// Stops the child encoder threads, nothing is pushed to pad after this
+	gst_sh_video_enc_free_rendition(rendition);
+
+	gst_pad_set_active(pad, FALSE);
+	gst_element_remove_pad(element, pad);
+}
+
+static void
+gst_sh_video_enc_forward_event(GstSHVideoEnc *enc, GstEvent *event)
+{
+	GstSHVideoEnc *children[GST_SH_VIDEO_ENC_MAX_PROFILES];
+	GList *item;
+	guint n, i;
+
+	n = 0;
+	GST_OBJECT_LOCK(enc);
+	for (item = enc->renditions; item; item = item->next)
+	{
+		children[n++] = gst_object_ref(
+			((GstSHVideoEncRendition *)item->data)->encoder);
+	}
+	GST_OBJECT_UNLOCK(enc);
+
+	for (i = 0; i < n; i++)
+	{
+		gst_pad_send_event(children[i]->sinkpad, gst_event_ref(event));
+		gst_object_unref(children[i]);
+	}
+}
+
+static void
+gst_sh_video_enc_feed_renditions(GstSHVideoEnc *enc, 
+				 GstSHVideoEncFrame *frame)
+{
+	GstSHVideoEnc *children[GST_SH_VIDEO_ENC_MAX_PROFILES];
+	GstCaps *caps[GST_SH_VIDEO_ENC_MAX_PROFILES];
+	GstBuffer *columns[GST_SH_VIDEO_ENC_MAX_PROFILES];
+	GstSHVideoEncProfile profiles[GST_SH_VIDEO_ENC_MAX_PROFILES];
+	GstSHVideoEncRendition *rendition;
+	GstBuffer *buffer;
+	GstFlowReturn ret;
+	GList *item;
+	guint n, i;
+	gint size;
+
+	if (!enc->renditions)
+	{
+		return;
+	}
+
+	n = 0;
+	GST_OBJECT_LOCK(enc);
+	for (item = enc->renditions; item; item = item->next)
+	{
+		rendition = (GstSHVideoEncRendition *)item->data;
+		if (rendition->index >= enc->n_profiles)
+		{
+			continue;
 		}
-		case PROP_RATECONTROL_CPB_REMAIN_ZERO_SKIP_ENABLE:
+		profiles[n] = enc->profiles[rendition->index];
+
+		if (!rendition->sink_caps)
 		{
-			g_value_set_ulong(value, enc->ratecontrol_cpb_remain_zero_skip_enable);
-			break;
+			rendition->sink_caps = gst_caps_new_simple("video/x-raw-yuv",
+				"format", GST_TYPE_FOURCC, 
+				GST_MAKE_FOURCC('N', 'V', '1', '2'),
+				"width", G_TYPE_INT, profiles[n].width,
+				"height", G_TYPE_INT, profiles[n].height,
+				"framerate", GST_TYPE_FRACTION, enc->fps_numerator, 
+				MAX(enc->fps_denominator, 1), NULL);
+
+			gst_buffer_replace(&rendition->columns, NULL);
+			rendition->columns = gst_buffer_new_and_alloc(
+				SCALE_NV12_COLUMNS(profiles[n].width) * sizeof(gint));
+			scale_nv12_columns((gint *)GST_BUFFER_DATA(rendition->columns),
+					   profiles[n].width, enc->width);
 		}
-		case PROP_RATECONTROL_CPB_BUFFER_UNIT_SIZE:
+		caps[n] = gst_caps_ref(rendition->sink_caps);
+		columns[n] = gst_buffer_ref(rendition->columns);
+		children[n] = gst_object_ref(rendition->encoder);
+		n++;
+	}
+	GST_OBJECT_UNLOCK(enc);
+
+	for (i = 0; i < n; i++)
+	{
+		size = profiles[i].width * profiles[i].height;
+
+		// The child sink pad has no peer, so its allocator is called as
+		// upstream would. It hands out buffers of the child's input pool.
+		gst_sh_video_enc_buffer_alloc(children[i]->sinkpad, 
+					      GST_BUFFER_OFFSET_NONE, size * 3 / 2,
+					      caps[i], &buffer);
+		if (!buffer)
 		{
-			g_value_set_ulong(value, enc->ratecontrol_cpb_buffer_unit_size);
-			break;
+			buffer = gst_buffer_new_and_alloc(size * 3 / 2);
+			gst_buffer_set_caps(buffer, caps[i]);
 		}
-		case PROP_RATECONTROL_CPB_BUFFER_MODE:
+		scale_nv12(GST_BUFFER_DATA(buffer), GST_BUFFER_DATA(buffer) + size,
+			   profiles[i].width, profiles[i].height, 
+			   frame->y, frame->cbcr, enc->width, enc->height,
+			   (const gint *)GST_BUFFER_DATA(columns[i]));
+
+		GST_BUFFER_TIMESTAMP(buffer) = frame->timestamp;
+		GST_BUFFER_DURATION(buffer) = frame->duration;
+		if (frame->discont)
 		{
-			g_value_set_ulong(value, enc->ratecontrol_cpb_buffer_mode);
-			break;
+			GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
 		}
-		case PROP_RATECONTROL_CPB_MAX_SIZE:
+
+		// A rendition that can't keep up must not stop the main stream
+		ret = gst_pad_chain(children[i]->sinkpad, buffer);
+		if (ret != GST_FLOW_OK)
 		{
-			g_value_set_ulong(value, enc->ratecontrol_cpb_max_size);
-			break;
+			GST_LOG_OBJECT(enc, "Rendition %dx%d returned %s", 
+				       profiles[i].width, profiles[i].height,
+				       gst_flow_get_name(ret));
 		}
-		case PROP_RATECONTROL_CPB_OFFSET:
+
+		gst_caps_unref(caps[i]);
+		gst_buffer_unref(columns[i]);
+		gst_object_unref(children[i]);
+	}
+}
+
+static GstFlowReturn 
+gst_sh_video_enc_chain(GstPad * pad, GstBuffer * buffer)
+{
+	gint yuv_size, cbcr_size;
+	gint rowstride, chroma_offset;
+	guint required;
+	GstClockTime timestamp, duration;
+	gboolean discont;
+	GstSHVideoEncFrame *frame;
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));  
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	if (enc->stream_stopped)
+	{
+		gst_buffer_unref(buffer);
+		return GST_FLOW_UNEXPECTED;
+	}
+
+	if (!enc->caps_set)
+	{
+		gst_sh_video_enc_read_sink_caps(enc);
+		gst_sh_video_enc_read_src_caps(enc);
+		gst_sh_video_enc_init_encoder(enc);
+		if (!enc->encoder)
 		{
-			g_value_set_ulong(value, enc->ratecontrol_cpb_offset);
-			break;
+			gst_buffer_unref(buffer);
+			return GST_FLOW_ERROR;
 		}
-		case PROP_RATECONTROL_CPB_OFFSET_RATE:
+		// RTP caps don't depend on what downstream accepts
+		if (enc->rtp || !gst_caps_is_any(enc->out_caps))
 		{
-			g_value_set_ulong(value, enc->ratecontrol_cpb_offset_rate);
-			break;
+			if (!gst_sh_video_enc_set_src_caps(enc))
+			{
+				gst_buffer_unref(buffer);
+				return GST_FLOW_UNEXPECTED;
+			}
 		}
-		case PROP_INTRA_THR_1:
+		enc->caps_set = TRUE;
+	}
+
+	yuv_size = enc->width * enc->height;
+	cbcr_size = enc->width * enc->height / 2;
+
+	if (enc->fourcc == GST_MAKE_FOURCC('N', 'V', '1', '2'))
+	{
+		gst_sh_video_enc_get_layout(enc, buffer, &rowstride, &chroma_offset);
+		required = chroma_offset + rowstride * (enc->height / 2 - 1) + 
+			enc->width;
+
+		if (rowstride < enc->width || 
+		    chroma_offset < rowstride * (enc->height - 1) + enc->width)
 		{
-			g_value_set_ulong(value, enc->intra_thr_1);
-			break;
+			required = G_MAXINT;
 		}
-		case PROP_INTRA_THR_2:
+	}
+	else
+	{
+		rowstride = chroma_offset = 0;
+		required = gst_sh_video_enc_get_frame_size(enc);
+	}
+
+	// Check that we have got enough data
+	if (GST_BUFFER_SIZE(buffer) < required)
+	{
+		GST_DEBUG_OBJECT(enc, "Not enough data");
+		gst_buffer_unref(buffer);
+		// If we can't continue we can issue EOS
+		gst_sh_video_enc_end_of_input(enc);
+		return GST_FLOW_UNEXPECTED;
+	}  
+
+	timestamp = GST_BUFFER_TIMESTAMP(buffer);
+	duration = GST_BUFFER_DURATION(buffer);
+	discont = GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+
+	if (!rowstride)
+	{
+		/* Conversion to NV12 doubles as the input copy */
+		frame = gst_sh_video_enc_convert_frame(enc, GST_BUFFER_DATA(buffer));
+		gst_buffer_unref(buffer);
+	}
+	else if (rowstride == enc->width)
+	{
+		/* The frame takes over our reference, the planes are read
+		   straight from the upstream buffer */
+		frame = g_new0(GstSHVideoEncFrame, 1);
+		frame->buffer_yuv = buffer;
+		frame->y = GST_BUFFER_DATA(buffer);
+		frame->cbcr = GST_BUFFER_DATA(buffer) + chroma_offset;
+	}
+	else
+	{
+		/* The VPU reads packed rows only */
+		GST_LOG_OBJECT(enc, "Repacking rows, stride %d", rowstride);
+
+		frame = g_new0(GstSHVideoEncFrame, 1);
+		frame->buffer_yuv = 
+			gst_sh_video_enc_new_frame_buffer(enc, yuv_size + cbcr_size);
+		frame->y = GST_BUFFER_DATA(frame->buffer_yuv);
+		frame->cbcr = frame->y + yuv_size;
+
+		gst_sh_video_enc_copy_rows(frame->y, GST_BUFFER_DATA(buffer),
+					   enc->width, enc->height, rowstride);
+		gst_sh_video_enc_copy_rows(frame->cbcr, 
+					   GST_BUFFER_DATA(buffer) + chroma_offset,
+					   enc->width, enc->height / 2, rowstride);
+		gst_buffer_unref(buffer);
+	}
+
+	frame->timestamp = timestamp;
+	frame->duration = duration;
+	frame->discont = discont;
+
+	/* Blocks only if the encoder is queue-depth frames behind */
+	if (!gst_sh_video_enc_queue_frame(enc, frame))
+	{
+		gst_sh_video_enc_free_frame(frame);
+		return GST_FLOW_UNEXPECTED;
+	}
+	
+	if (!enc->enc_thread)
+	{
+		gst_sh_video_enc_start_threads(enc);
+	}
+
+	return GST_FLOW_OK;
+}
+
+static guint
+gst_sh_video_enc_get_frame_size(GstSHVideoEnc *enc)
+{
+	GstVideoFormat format = gst_video_format_from_fourcc(enc->fourcc);
+
+	// The rows of I420, YV12 and YUY2 are padded, NV12 is packed
+	if (enc->fourcc != GST_MAKE_FOURCC('N', 'V', '1', '2') &&
+	    format != GST_VIDEO_FORMAT_UNKNOWN)
+	{
+		return gst_video_format_get_size(format, enc->width, enc->height);
+	}
+	return enc->width * enc->height * 3 / 2;
+}
+
+static GstSHVideoEncFrame *
+gst_sh_video_enc_convert_frame(GstSHVideoEnc *enc, const guint8 *data)
+{
+	GstSHVideoEncFrame *frame;
+	gint yuv_size = enc->width * enc->height;
+	GstVideoFormat format = gst_video_format_from_fourcc(enc->fourcc);
+
+	frame = g_new0(GstSHVideoEncFrame, 1);
+	frame->buffer_yuv = 
+		gst_sh_video_enc_new_frame_buffer(enc, yuv_size * 3 / 2);
+	frame->y = GST_BUFFER_DATA(frame->buffer_yuv);
+	frame->cbcr = frame->y + yuv_size;
+
+	/* The strides and plane offsets are rounded up as in GStreamer, the
+	   component offsets also swap the chroma planes of YV12 */
+	switch (format)
+	{
+		case GST_VIDEO_FORMAT_I420:
+		case GST_VIDEO_FORMAT_YV12:
 		{
-			g_value_set_ulong(value, enc->intra_thr_2);
+			convert_planar_to_nv12(frame->y, frame->cbcr, 
+				data + gst_video_format_get_component_offset(format, 
+						0, enc->width, enc->height),
+				data + gst_video_format_get_component_offset(format, 
+						1, enc->width, enc->height),
+				data + gst_video_format_get_component_offset(format, 
+						2, enc->width, enc->height),
+				enc->width, enc->height, 
+				gst_video_format_get_row_stride(format, 0, enc->width),
+				gst_video_format_get_row_stride(format, 1, enc->width));
 			break;
 		}
-		case PROP_SAD_INTRA_BIAS:
+		case GST_VIDEO_FORMAT_YUY2:
 		{
-			g_value_set_ulong(value, enc->sad_intra_bias);
+			convert_yuy2_to_nv12(frame->y, frame->cbcr, data,
+				enc->width, enc->height, 
+				gst_video_format_get_row_stride(format, 0, enc->width));
 			break;
 		}
-		case PROP_REGULARLY_INSERTED_I_TYPE:
+		default:
 		{
-			g_value_set_ulong(value, enc->regularly_inserted_i_type);
+			memcpy(frame->y, data, yuv_size * 3 / 2);
 			break;
 		}
-		case PROP_CALL_UNIT:
+	}
+	return frame;
+}
+
+static void
+gst_sh_video_enc_get_layout(GstSHVideoEnc *enc, GstBuffer *buffer,
+			gint *rowstride, gint *chroma_offset)
+{
+	GstStructure *structure;
+
+	*rowstride = enc->rowstride ? enc->rowstride : enc->width;
+	*chroma_offset = enc->chroma_offset;
+
+	if (GST_BUFFER_CAPS(buffer) && 
+	    gst_caps_get_size(GST_BUFFER_CAPS(buffer)) > 0)
+	{
+		structure = gst_caps_get_structure(GST_BUFFER_CAPS(buffer), 0);
+		gst_structure_get_int(structure, "rowstride", rowstride);
+		gst_structure_get_int(structure, "chroma-offset", chroma_offset);
+	}
+
+	if (!*chroma_offset)
+	{
+		*chroma_offset = *rowstride * enc->height;
+	}
+}
+
+static void
+gst_sh_video_enc_copy_rows(guchar *dst, const guchar *src, gint width,
+			gint rows, gint rowstride)
+{
+	gint i;
+
+	for (i = 0; i < rows; i++)
+	{
+		memcpy(dst, src, width);
+		dst += width;
+		src += rowstride;
+	}
+}
+
+static GstBuffer *
+gst_sh_video_enc_new_frame_buffer(GstSHVideoEnc *enc, guint size)
+{
+	GstBuffer *buffer = NULL;
+
+	if (enc->pool_size)
+	{
+		pthread_mutex_lock(&enc->mutex);
+		if (!enc->input_pool)
 		{
-			g_value_set_ulong(value, enc->call_unit);
-			break;
+			enc->input_pool = gst_sh_buffer_pool_new(enc->pool_size);
 		}
-		case PROP_USE_SLICE:
+		buffer = gst_sh_buffer_pool_get(enc->input_pool, size);
+		pthread_mutex_unlock(&enc->mutex);
+	}
+
+	if (!buffer)
+	{
+		buffer = gst_buffer_new_and_alloc(size);
+	}
+	return buffer;
+}
+
+static GstFlowReturn
+gst_sh_video_enc_buffer_alloc(GstPad *pad, guint64 offset, guint size,
+			GstCaps *caps, GstBuffer **buf)
+{
+	GstStructure *structure;
+	gint width, height;
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));
+
+	GST_LOG_OBJECT(enc, "Buffer requested. Offset: %lld, size: %d",
+			offset, size);
+
+	*buf = NULL;
+
+	if (!enc->pool_size || !caps || gst_caps_get_size(caps) < 1)
+	{
+		return GST_FLOW_OK;
+	}
+
+	structure = gst_caps_get_structure(caps, 0);
+
+	if (!(gst_structure_get_int(structure, "width", &width)
+	&& gst_structure_get_int(structure, "height", &height))) 
+	{
+		GST_DEBUG_OBJECT(enc, "%s no width/height, using default allocation",
+				 __FUNCTION__);
+		return GST_FLOW_OK;
+	}
+
+	// Only whole NV12 frames are taken from the pool
+	if (size != width * height * 3 / 2)
+	{
+		return GST_FLOW_OK;
+	}
+
+	pthread_mutex_lock(&enc->mutex);
+	if (!enc->input_pool)
+	{
+		enc->input_pool = gst_sh_buffer_pool_new(enc->pool_size);
+	}
+	*buf = gst_sh_buffer_pool_get(enc->input_pool, size);
+	pthread_mutex_unlock(&enc->mutex);
+
+	if (*buf)
+	{
+		GST_BUFFER_OFFSET(*buf) = offset;
+		gst_buffer_set_caps(*buf, caps);
+	}
+	else
+	{
+		GST_DEBUG_OBJECT(enc, "Input pool exhausted, using default allocation");
+	}
+
+	return GST_FLOW_OK;
+}
+
+static gboolean
+gst_sh_video_enc_activate_pull(GstPad  *pad,
+					 gboolean active)
+{
+	GstSHVideoEnc *enc = 
+		(GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	if (active) 
+	{
+		enc->offset = 0;
+		return gst_pad_start_task(pad,
+				(GstTaskFunction)gst_sh_video_enc_loop, enc);
+	} 
+	else 
+	{
+		return gst_pad_stop_task(pad);
+	}
+}
+
+static void
+gst_sh_video_enc_loop(GstSHVideoEnc *enc)
+{
+	GstFlowReturn ret;
+	gint yuv_size, frame_size;
+	guint frames, i;
+	GstBuffer *buffer;
+	GstSHVideoEncFrame *frame;
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	if (!enc->caps_set)
+	{
+		gst_sh_video_enc_read_sink_caps(enc);
+		gst_sh_video_enc_read_src_caps(enc);
+		gst_sh_video_enc_init_encoder(enc);
+		if (!enc->encoder)
 		{
-			g_value_set_ulong(value, enc->use_slice);
-			break;
+			gst_pad_pause_task(enc->sinkpad);
+			return;
 		}
-		case PROP_SLICE_SIZE_MB:
+		// RTP caps don't depend on what downstream accepts
+		if (enc->rtp || !gst_caps_is_any(enc->out_caps))
 		{
-			g_value_set_ulong(value, enc->slice_size_mb);
-			break;
+			if (!gst_sh_video_enc_set_src_caps(enc))
+			{
+				gst_pad_pause_task(enc->sinkpad);
+				return;
+			}
 		}
-		case PROP_SLICE_SIZE_BIT:
-		{
-			g_value_set_ulong(value, enc->slice_size_bit);
-			break;
+		enc->caps_set = TRUE;
+	}
+
+	yuv_size = enc->width * enc->height;
+	frame_size = gst_sh_video_enc_get_frame_size(enc);
+
+	/* Both planes of read-ahead frames are fetched with one request */
+	ret = gst_pad_pull_range(enc->sinkpad, enc->offset,
+			frame_size * enc->read_ahead, &buffer);
+
+	if (ret != GST_FLOW_OK) 
+	{
+		GST_DEBUG_OBJECT(enc, "pull_range failed: %s", gst_flow_get_name(ret));
+		gst_pad_pause_task(enc->sinkpad);
+		gst_sh_video_enc_end_of_input(enc);
+		return;
+	}
+
+	frames = GST_BUFFER_SIZE(buffer) / frame_size;
+	enc->offset += frames * frame_size;
+
+	for (i = 0; i < frames; i++)
+	{
+		if (enc->fourcc == GST_MAKE_FOURCC('N', 'V', '1', '2'))
+		{
+			frame = g_new0(GstSHVideoEncFrame, 1);
+			frame->buffer_yuv = gst_buffer_create_sub(buffer, i * frame_size, 
+								  frame_size);
+			frame->y = GST_BUFFER_DATA(frame->buffer_yuv);
+			frame->cbcr = frame->y + yuv_size;
 		}
-		case PROP_SLICE_TYPE_VALUE_PATTERN:
+		else
 		{
-			g_value_set_ulong(value, enc->slice_type_value_pattern);
-			break;
+			frame = gst_sh_video_enc_convert_frame(enc, 
+					GST_BUFFER_DATA(buffer) + i * frame_size);
 		}
-		case PROP_USE_MB_PARTITION:
+
+		// Raw files carry no timing, it is derived from the frame rate
+		frame->timestamp = GST_CLOCK_TIME_NONE;
+		frame->duration = GST_CLOCK_TIME_NONE;
+		frame->discont = FALSE;
+
+		/* Reading ahead stops here when the input queue is full */
+		if (!gst_sh_video_enc_queue_frame(enc, frame))
 		{
-			g_value_set_ulong(value, enc->use_mb_partition);
-			break;
+			gst_sh_video_enc_free_frame(frame);
+			gst_buffer_unref(buffer);
+			gst_pad_pause_task(enc->sinkpad);
+			return;
 		}
-		case PROP_MB_PARTITION_VECTOR_THR:
+
+		if (!enc->enc_thread)
 		{
-			g_value_set_ulong(value, enc->mb_partition_vector_thr);
-			break;
+			gst_sh_video_enc_start_threads(enc);
 		}
-		case PROP_DEBLOCKING_MODE:
+	}
+
+	gst_buffer_unref(buffer);
+
+	if (frames < enc->read_ahead)
+	{
+		GST_DEBUG_OBJECT(enc, "Not enough data");
+		gst_pad_pause_task(enc->sinkpad);
+		gst_sh_video_enc_end_of_input(enc);
+	}
+}
+
+void *
+gst_sh_video_launch_encoder_thread(void *data)
+{
+	gint ret;
+	GList *events;
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)data;
+
+	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+
+	ret = shcodecs_encoder_run(enc->encoder);
+	vpu_sched_release(enc->vpu);
+
+	// The run was not cut short by a flush, a state change or an error
+	enc->encoder_clean = !ret && enc->eos && !enc->stream_stopped && 
+		enc->output_flow == GST_FLOW_OK;
+
+	// The last frame has no following input to complete it
+	gst_sh_video_enc_push_unit(enc);
+	gst_sh_video_enc_finish_slices(enc);
+
+	// Events that came after the last frame
+	pthread_mutex_lock(&enc->mutex);
+	events = g_list_concat(enc->carried_events, enc->pending_events);
+	enc->carried_events = NULL;
+	enc->pending_events = NULL;
+	pthread_mutex_unlock(&enc->mutex);
+	gst_sh_video_enc_queue_events(enc, events);
+
+	GST_DEBUG_OBJECT(enc, "shcodecs_encoder_run returned %d\n", ret);
+	GST_DEBUG_OBJECT(enc, "%d frames encoded.", enc->frame_number);
+
+	// The encoder won't take any more input, release the waiting thread
+	enc->stream_stopped = TRUE;
+	gst_sh_video_enc_wake_threads(enc);
+	gst_sh_video_enc_flush_queue(enc);
+
+	// Calling stop task won't do any harm if we are in push mode
+	gst_pad_stop_task(enc->sinkpad);
+
+	// EOS from upstream is held back until the queue has been drained
+	enc->eos = TRUE;
+	gst_sh_video_enc_queue_output(enc, 
+				      GST_MINI_OBJECT(gst_event_new_eos()));
+
+	return NULL;
+}
+
+static void
+gst_sh_video_enc_start_threads(GstSHVideoEnc *enc)
+{
+	glong bitrate;
+
+	enc->encoder_clean = FALSE;
+	enc->output_stopped = FALSE;
+	enc->output_flow = GST_FLOW_OK;
+
+	if (enc->rate_control)
+	{
+		rate_control_free(enc->rate_control);
+		enc->rate_control = NULL;
+	}
+	enc->applied_bitrate = 0;
+	bitrate = enc->target_bitrate ? enc->target_bitrate : enc->bitrate;
+	if (bitrate)
+	{
+		enc->rate_control = rate_control_new(enc->rate_policy, bitrate);
+	}
+	else
+	{
+		GST_WARNING_OBJECT(enc, "No bitrate known, rate control %s is off",
+				   enc->rate_policy->name);
+	}
+
+	// Each stream gets a new trace, the file name may have changed
+	if (enc->rate_trace_name && *enc->rate_trace_name && !enc->rate_trace)
+	{
+		enc->rate_trace = fopen(enc->rate_trace_name, "w");
+		if (!enc->rate_trace)
 		{
-			g_value_set_ulong(value, enc->deblocking_mode);
-			break;
+			GST_WARNING_OBJECT(enc, "Can't write the rate control trace %s",
+					   enc->rate_trace_name);
 		}
-		case PROP_USE_DEBLOCKING_FILTER_CONTROL:
+	}
+
+	gst_pad_start_task(enc->srcpad, 
+			   (GstTaskFunction)gst_sh_video_enc_push_loop, enc);
+
+	/* We'll have to launch the encoder in 
+	   a separate thread to keep the pipeline running */
+	pthread_create(&enc->enc_thread, NULL, 
+		       gst_sh_video_launch_encoder_thread, enc);
+}
+
+static void
+gst_sh_video_enc_push_loop(GstSHVideoEnc *enc)
+{
+	GstMiniObject *item;
+	GstFlowReturn ret;
+
+	item = gst_sh_video_enc_dequeue_output(enc);
+
+	if (!item)
+	{
+		gst_pad_pause_task(enc->srcpad);
+		return;
+	}
+
+	if (GST_IS_EVENT(item))
+	{
+		if (GST_EVENT_TYPE(GST_EVENT_CAST(item)) == GST_EVENT_EOS)
 		{
-			g_value_set_ulong(value, enc->use_deblocking_filter_control);
-			break;
+			gst_pad_pause_task(enc->srcpad);
 		}
-		case PROP_DEBLOCKING_ALPHA_OFFSET:
+		gst_pad_push_event(enc->srcpad, GST_EVENT_CAST(item));
+		return;
+	}
+
+#if GST_CHECK_VERSION(0,10,24)
+	if (GST_IS_BUFFER_LIST(item))
+	{
+		ret = gst_pad_push_list(enc->srcpad, GST_BUFFER_LIST_CAST(item));
+	}
+	else
+#endif
+	{
+		ret = gst_pad_push(enc->srcpad, GST_BUFFER_CAST(item));
+	}
+
+	if (ret != GST_FLOW_OK) 
+	{
+		GST_DEBUG_OBJECT(enc, "pad_push failed: %s", gst_flow_get_name(ret));
+
+		// The encoder stops at its next output
+		enc->output_flow = ret;
+		gst_sh_video_enc_wake_threads(enc);
+		gst_pad_pause_task(enc->srcpad);
+	}
+}
+
+static gboolean
+gst_sh_video_enc_queue_output(GstSHVideoEnc *enc, GstMiniObject *item)
+{
+	guint level;
+
+	while (!ring_buffer_push(enc->output_queue, item))
+	{
+		pthread_mutex_lock(&enc->cond_mutex);
+		g_atomic_int_set(&enc->output_waiting, TRUE);
+		while (ring_buffer_is_full(enc->output_queue) && 
+		       !enc->output_stopped && enc->output_flow == GST_FLOW_OK)
 		{
-			g_value_set_long(value, enc->deblocking_alpha_offset);
-			break;
+			pthread_cond_wait(&enc->thread_condition, &enc->cond_mutex);
 		}
-		case PROP_DEBLOCKING_BETA_OFFSET:
+		g_atomic_int_set(&enc->output_waiting, FALSE);
+		pthread_mutex_unlock(&enc->cond_mutex);
+
+		if (enc->output_stopped || enc->output_flow != GST_FLOW_OK)
 		{
-			g_value_set_long(value, enc->deblocking_beta_offset);
-			break;
-		}	
-		case PROP_ME_SKIP_MODE:
+			gst_mini_object_unref(item);
+			return FALSE;
+		}
+	}
+
+	level = ring_buffer_get_fill_level(enc->output_queue);
+	if (level > enc->output_high_water)
+	{
+		enc->output_high_water = level;
+	}
+
+	if (g_atomic_int_get(&enc->push_waiting))
+	{
+		gst_sh_video_enc_wake_threads(enc);
+	}
+	return TRUE;
+}
+
+static GstMiniObject *
+gst_sh_video_enc_dequeue_output(GstSHVideoEnc *enc)
+{
+	GstMiniObject *item;
+
+	while (!(item = ring_buffer_pop(enc->output_queue)))
+	{
+		if (enc->output_stopped)
 		{
-			g_value_set_ulong(value, enc->me_skip_mode);
-			break;
+			return NULL;
 		}
-		case PROP_PUT_START_CODE:
+
+		pthread_mutex_lock(&enc->cond_mutex);
+		g_atomic_int_set(&enc->push_waiting, TRUE);
+		while (!ring_buffer_get_fill_level(enc->output_queue) && 
+		       !enc->output_stopped)
 		{
-			g_value_set_ulong(value, enc->put_start_code);
-			break;
+			pthread_cond_wait(&enc->thread_condition, &enc->cond_mutex);
 		}
-		case PROP_SEQ_PARAM_SET_ID:
+		g_atomic_int_set(&enc->push_waiting, FALSE);
+		pthread_mutex_unlock(&enc->cond_mutex);
+	}
+
+	if (g_atomic_int_get(&enc->output_waiting))
+	{
+		gst_sh_video_enc_wake_threads(enc);
+	}
+	return item;
+}
+
+static void
+gst_sh_video_enc_flush_output(GstSHVideoEnc *enc)
+{
+	GstMiniObject *item;
+
+	if (!enc->output_queue)
+	{
+		return;
+	}
+	while ((item = ring_buffer_pop(enc->output_queue)))
+	{
+		gst_mini_object_unref(item);
+	}
+}
+
+static gboolean
+gst_sh_video_enc_queue_events(GstSHVideoEnc *enc, GList *events)
+{
+	GList *item;
+	gboolean ret = TRUE;
+
+	for (item = events; item; item = item->next)
+	{
+		if (!ret)
 		{
-			g_value_set_ulong(value, enc->seq_param_set_id);
-			break;
+			gst_event_unref(GST_EVENT_CAST(item->data));
+			continue;
 		}
-		case PROP_PROFILE:
+		ret = gst_sh_video_enc_queue_output(enc, GST_MINI_OBJECT(item->data));
+	}
+	g_list_free(events);
+	return ret;
+}
+
+static void
+gst_sh_video_enc_free_events(GList *events)
+{
+	GList *item;
+
+	for (item = events; item; item = item->next)
+	{
+		gst_event_unref(GST_EVENT_CAST(item->data));
+	}
+	g_list_free(events);
+}
+
+static void
+gst_sh_video_enc_drop_frame(GstSHVideoEnc *enc, GstSHVideoEncFrame *frame)
+{
+	GstMessage *message;
+	gint dropped;
+
+	dropped = g_atomic_int_exchange_and_add(&enc->frames_dropped, 1) + 1;
+
+	GST_DEBUG_OBJECT(enc, "Dropping frame %" GST_TIME_FORMAT
+			 " (%d dropped)", GST_TIME_ARGS(frame->timestamp), dropped);
+
+#if GST_CHECK_VERSION(0,10,29)
+	message = gst_message_new_qos(GST_OBJECT(enc), TRUE, 
+				      GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE,
+				      frame->timestamp, frame->duration);
+	gst_message_set_qos_stats(message, GST_FORMAT_BUFFERS, 
+				  enc->frame_number, dropped);
+#else
+	message = gst_message_new_element(GST_OBJECT(enc),
+			gst_structure_new("GstSHVideoEncQoS",
+					  "timestamp", G_TYPE_UINT64, frame->timestamp,
+					  "duration", G_TYPE_UINT64, frame->duration,
+					  "processed", G_TYPE_UINT64, 
+					  (guint64) enc->frame_number,
+					  "dropped", G_TYPE_UINT64, (guint64) dropped,
+					  NULL));
+#endif
+	gst_element_post_message(GST_ELEMENT(enc), message);
+
+	// The key frame request moves on to the encoder's next frame
+	if (frame->force_key_unit)
+	{
+		g_atomic_int_set(&enc->force_key_unit, TRUE);
+	}
+	if (frame->scene_cut)
+	{
+		g_atomic_int_set(&enc->scene_cut_pending, TRUE);
+	}
+	if (frame->events)
+	{
+		pthread_mutex_lock(&enc->mutex);
+		enc->carried_events = g_list_concat(enc->carried_events, 
+						    frame->events);
+		pthread_mutex_unlock(&enc->mutex);
+		frame->events = NULL;
+	}
+
+	gst_sh_video_enc_free_frame(frame);
+}
+
+static gboolean
+gst_sh_video_enc_queue_frame(GstSHVideoEnc *enc, GstSHVideoEncFrame *frame)
+{
+	GstSHVideoEncFrame *oldest;
+	gint policy = enc->drop_policy;
+
+	gst_sh_video_enc_feed_renditions(enc, frame);
+
+	frame->arrival = enc_stats_now();
+
+	pthread_mutex_lock(&enc->mutex);
+	frame->events = enc->pending_events;
+	enc->pending_events = NULL;
+	pthread_mutex_unlock(&enc->mutex);
+
+	if (enc->key_unit_next_frame)
+	{
+		frame->force_key_unit = TRUE;
+		enc->key_unit_next_frame = FALSE;
+	}
+
+	/* Done here so that it overlaps with the encoding of the previous 
+	   frames. The planes are packed by now. */
+	if (enc->scene_cut_threshold)
+	{
+		frame->scene_cut = scene_cut_detect(enc->scene_cut, frame->y, 
+						    enc->width, enc->height,
+						    enc->scene_cut_threshold);
+	}
+
+	/* Live sources must not be stalled by the encoder */
+	while (policy != DROP_POLICY_BLOCK &&
+	       !ring_buffer_push(enc->input_queue, frame))
+	{
+		if (policy == DROP_POLICY_NEWEST)
 		{
-			g_value_set_ulong(value, enc->profile);
-			break;
+			// The older frames still queued come before the events
+			pthread_mutex_lock(&enc->mutex);
+			enc->pending_events = g_list_concat(frame->events,
+							    enc->pending_events);
+			pthread_mutex_unlock(&enc->mutex);
+			frame->events = NULL;
+			gst_sh_video_enc_drop_frame(enc, frame);
+			return TRUE;
 		}
-		case PROP_CONSTRAINT_SET_FLAG:
+		oldest = ring_buffer_pop(enc->input_queue);
+		if (oldest)
 		{
-			g_value_set_ulong(value, enc->constraint_set_flag);
-			break;
+			gst_sh_video_enc_drop_frame(enc, oldest);
 		}
-		case PROP_LEVEL_TYPE:
+	}
+
+	while (policy == DROP_POLICY_BLOCK &&
+	       !ring_buffer_push(enc->input_queue, frame))
+	{
+		pthread_mutex_lock(&enc->cond_mutex);
+		g_atomic_int_set(&enc->chain_waiting, TRUE);
+		while (ring_buffer_is_full(enc->input_queue) && !enc->stream_stopped)
 		{
-			g_value_set_ulong(value, enc->level_type);
-			break;
+			pthread_cond_wait(&enc->thread_condition, &enc->cond_mutex);
 		}
-		case PROP_LEVEL_VALUE:
+		g_atomic_int_set(&enc->chain_waiting, FALSE);
+		pthread_mutex_unlock(&enc->cond_mutex);
+
+		if (enc->stream_stopped)
 		{
-			g_value_set_ulong(value, enc->level_value);
-			break;
+			return FALSE;
 		}
-		case PROP_OUT_VUI_PARAMETERS:
+	}
+
+	/* The lock is only needed if the encoder is sleeping on the queue */
+	if (g_atomic_int_get(&enc->encoder_waiting))
+	{
+		gst_sh_video_enc_wake_threads(enc);
+	}
+	return TRUE;
+}
+
+static GstSHVideoEncFrame *
+gst_sh_video_enc_dequeue_frame(GstSHVideoEnc *enc)
+{
+	GstSHVideoEncFrame *frame;
+
+	while (!(frame = ring_buffer_pop(enc->input_queue)))
+	{
+		if (enc->stream_stopped)
 		{
-			g_value_set_ulong(value, enc->out_vui_parameters);
-			break;
+			return NULL;
 		}
-		case PROP_CHROMA_QP_INDEX_OFFSET:
+		if (enc->eos)
 		{
-			g_value_set_ulong(value, enc->chroma_qp_index_offset);
+			// The last frame may have been queued right before EOS
+			frame = ring_buffer_pop(enc->input_queue);
 			break;
 		}
-		case PROP_CONSTRAINED_INTRA_PRED:
+
+		pthread_mutex_lock(&enc->cond_mutex);
+		g_atomic_int_set(&enc->encoder_waiting, TRUE);
+		while (!ring_buffer_get_fill_level(enc->input_queue) && 
+			   !enc->stream_stopped && !enc->eos)
 		{
-			g_value_set_ulong(value, enc->constrained_intra_pred);
-			break;
+			pthread_cond_wait(&enc->thread_condition, &enc->cond_mutex);
 		}
-		default:
-		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		g_atomic_int_set(&enc->encoder_waiting, FALSE);
+		pthread_mutex_unlock(&enc->cond_mutex);
+	}
+
+	if (frame && g_atomic_int_get(&enc->chain_waiting))
+	{
+		gst_sh_video_enc_wake_threads(enc);
 	}
+	return frame;
 }
 
-static gboolean 
-gst_sh_video_enc_sink_event(GstPad * pad, GstEvent * event)
+static void
+gst_sh_video_enc_free_frame(GstSHVideoEncFrame *frame)
 {
-	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));  
+	if (frame->buffer_yuv)
+	{
+		gst_buffer_unref(frame->buffer_yuv);
+	}
+	if (frame->buffer_cbcr)
+	{
+		gst_buffer_unref(frame->buffer_cbcr);
+	}
+	gst_sh_video_enc_free_events(frame->events);
+	g_free(frame);
+}
 
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+static void
+gst_sh_video_enc_flush_queue(GstSHVideoEnc *enc)
+{
+	GstSHVideoEncFrame *frame;
 
-	if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) 
+	if (!enc->input_queue)
 	{
-		enc->eos = TRUE;
+		return;
+	}
+	while ((frame = ring_buffer_pop(enc->input_queue)))
+	{
+		gst_sh_video_enc_free_frame(frame);
 	}
+}
 
-	return gst_pad_push_event(enc->srcpad, event);
+static void
+gst_sh_video_enc_wake_threads(GstSHVideoEnc *enc)
+{
+	pthread_mutex_lock(&enc->cond_mutex);
+	pthread_cond_broadcast(&enc->thread_condition);
+	pthread_mutex_unlock(&enc->cond_mutex);
 }
 
-static gboolean
-gst_sh_video_enc_set_caps(GstPad * pad, GstCaps * caps)
+static void
+gst_sh_video_enc_end_of_input(GstSHVideoEnc *enc)
 {
-	gboolean ret;
-	GstStructure *structure;
-	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));
+	pthread_mutex_lock(&enc->cond_mutex);
+	enc->eos = TRUE;
+	pthread_cond_broadcast(&enc->thread_condition);
+	pthread_mutex_unlock(&enc->cond_mutex);
 
-    if (enc->caps_set)
+	if (!enc->enc_thread)
 	{
-		return TRUE;
+		// Nothing was encoded, nobody else will send EOS
+		gst_pad_push_event(enc->srcpad, gst_event_new_eos());
 	}
+}
 
-	ret = TRUE;
-
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
-
-	// get input size
-	structure = gst_caps_get_structure(caps, 0);
-	ret = gst_structure_get_int(structure, "width", &enc->width);
-	ret &= gst_structure_get_int(structure, "height", &enc->height);
-	ret &= gst_structure_get_fraction(structure, "framerate", 
-						 &enc->fps_numerator, 
-						 &enc->fps_denominator);
-
-	if (!ret) 
+static glong
+gst_sh_video_enc_vop_interval(GstSHVideoEnc *enc)
+{
+	if (enc->scene_cut_threshold && enc->scene_cut_restart_gop &&
+	    !enc->vop_interval_fallback)
 	{
-		return ret;
+		return 0;
 	}
+	return enc->i_vop_interval;
+}
 
-	gst_sh_video_enc_read_src_caps(enc);
-	gst_sh_video_enc_init_encoder(enc);
-
-	if (!gst_caps_is_any(enc->out_caps))
+/* Duration of a frame at the caps framerate. With variable framerate 
+   the average interval of the input frames is used instead. */
+static GstClockTime
+gst_sh_video_enc_frame_duration(GstSHVideoEnc *enc)
+{
+	if (enc->fps_numerator)
 	{
-		ret = gst_sh_video_enc_set_src_caps(enc);
+		return gst_util_uint64_scale_int(GST_SECOND, enc->fps_denominator,
+						 enc->fps_numerator);
 	}
-		
-	if (ret) 
+	if (enc->frame_interval)
 	{
-		enc->caps_set = TRUE;
+		return enc->frame_interval;
 	}
+	return gst_util_uint64_scale_int(GST_SECOND, 10, VFR_FRAMERATE);
+}
 
-	return ret;
+/* Start time of a frame without a timestamp. Computed from the frame 
+   number so that rounding errors don't add up. */
+static GstClockTime
+gst_sh_video_enc_frame_time(GstSHVideoEnc *enc, glong frame)
+{
+	if (enc->fps_numerator)
+	{
+		return gst_util_uint64_scale(frame, 
+				GST_SECOND * enc->fps_denominator, enc->fps_numerator);
+	}
+	return frame * gst_sh_video_enc_frame_duration(enc);
 }
 
-void
-gst_sh_video_enc_read_sink_caps(GstSHVideoEnc * enc)
+/* libshcodecs gives each frame bitrate / framerate bits. With variable 
+   framerate the bitrate handed to it is scaled by the average frame 
+   interval, so that the bits per second stay on target. */
+static void
+gst_sh_video_enc_track_interval(GstSHVideoEnc *enc, GstSHVideoEncFrame *frame)
 {
-	GstStructure *structure;
+	GstClockTime interval, diff;
 
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+	if (!GST_CLOCK_TIME_IS_VALID(frame->timestamp))
+	{
+		return;
+	}
 
-	// get the caps of the previous element in chain
-	enc->out_caps = gst_pad_peer_get_caps(enc->sinkpad);
-	
-	if (!gst_caps_is_any(enc->out_caps))
+	if (GST_CLOCK_TIME_IS_VALID(enc->last_input_timestamp) && 
+	    !frame->discont && frame->timestamp > enc->last_input_timestamp)
 	{
-		structure = gst_caps_get_structure(enc->out_caps, 0);
-        if (!enc->width)
-		{
-	    	gst_structure_get_int(structure, "width", &enc->width);
-		}
-        if (!enc->height)
-		{
-		    gst_structure_get_int(structure, "height", &enc->height);
-		}
-        if (!enc->fps_numerator)
+		interval = frame->timestamp - enc->last_input_timestamp;
+
+		// Gaps of a second or more are pauses, not the frame rate
+		if (interval < GST_SECOND)
 		{
-		    gst_structure_get_fraction(structure, "framerate", 
-										 &enc->fps_numerator, 
-										 &enc->fps_denominator);
+			if (enc->frame_interval)
+			{
+				enc->frame_interval = (enc->frame_interval * 
+					(VFR_INTERVAL_WEIGHT - 1) + interval) / 
+					VFR_INTERVAL_WEIGHT;
+			}
+			else
+			{
+				enc->frame_interval = interval;
+			}
 		}
 	}
+	enc->last_input_timestamp = frame->timestamp;
+
+	if (enc->fps_numerator || !enc->frame_interval)
+	{
+		return;
+	}
+
+	// Only changes over 1/16 are passed on
+	diff = enc->frame_interval > enc->applied_interval ?
+		enc->frame_interval - enc->applied_interval :
+		enc->applied_interval - enc->frame_interval;
+	if (!enc->applied_interval || diff * 16 > enc->applied_interval)
+	{
+		enc->applied_interval = enc->frame_interval;
+		gst_sh_video_enc_request_change(enc, CHANGE_BITRATE);
+	}
 }
 
-void
-gst_sh_video_enc_read_src_caps(GstSHVideoEnc * enc)
+static void
+gst_sh_video_enc_store_frame_info(GstSHVideoEnc *enc, 
+				GstSHVideoEncFrame *frame)
 {
-	GstStructure *structure;
+	GstSHVideoEncFrameInfo *info;
 
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+	info = &enc->frame_info[enc->input_frames % 
+				GST_SH_VIDEO_ENC_FRAME_INFO_SIZE];
+	info->timestamp = frame->timestamp;
+	info->duration = frame->duration;
+	info->discont = frame->discont;
+	info->arrival = frame->arrival;
 
-	// get the caps of the next element in chain
-	enc->out_caps = gst_pad_peer_get_caps(enc->srcpad);
-	
-	if (!gst_caps_is_any(enc->out_caps) && 
-		enc->format == SHCodecs_Format_NONE)
+	enc->input_frames++;
+	enc->cycle_outputs = 0;
+}
+
+static void
+gst_sh_video_enc_stamp_output(GstSHVideoEnc *enc, GstBuffer *buffer)
+{
+	GstSHVideoEncFrameInfo *info;
+	glong latest, input;
+	glong period;
+	GstClockTime frame_duration;
+
+	latest = enc->input_frames - 1;
+	input = latest;
+
+	/* With B-VOPs the anchor frame comes out first, followed by the 
+	   B-VOPs that were held back waiting for it */
+	if (enc->format == SHCodecs_Format_MPEG4 && enc->b_vop_num > 0 &&
+	    enc->cycle_outputs > 0)
 	{
-		structure = gst_caps_get_structure(enc->out_caps, 0);
-		if (!strcmp(gst_structure_get_name(structure), "video/mpeg")) 
-		{
-			enc->format = SHCodecs_Format_MPEG4;
-		}
-		else if (!strcmp(gst_structure_get_name(structure), 
-				  "video/x-h264")) 
+		period = enc->b_vop_num + 1;
+		input = latest - period + enc->cycle_outputs;
+		if (input < 0 || input >= latest)
 		{
-			enc->format = SHCodecs_Format_H264;
+			input = latest;
 		}
 	}
-}
+	enc->cycle_outputs++;
 
-gboolean
-gst_sh_video_enc_set_src_caps(GstSHVideoEnc * enc)
-{
-	GstCaps* caps = NULL;
-	gboolean ret = TRUE;
-	
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+	frame_duration = gst_sh_video_enc_frame_duration(enc);
 
-	if (enc->format == SHCodecs_Format_MPEG4)
+	if (input < 0 || 
+	    latest - input >= GST_SH_VIDEO_ENC_FRAME_INFO_SIZE)
 	{
-		caps = gst_caps_new_simple("video/mpeg", "width", G_TYPE_INT, 
-				enc->width, "height", G_TYPE_INT, 
-				enc->height, "framerate", 
-				GST_TYPE_FRACTION, enc->fps_numerator, 
-				enc->fps_denominator, "mpegversion", 
-				G_TYPE_INT, 4, NULL);
+		GST_BUFFER_DURATION(buffer) = frame_duration;
+		GST_BUFFER_TIMESTAMP(buffer) = 
+			gst_sh_video_enc_frame_time(enc, enc->frame_number);
+		enc->pending_arrival = 0;
+		return;
 	}
-	else if (enc->format == SHCodecs_Format_H264)
+
+	info = &enc->frame_info[input % GST_SH_VIDEO_ENC_FRAME_INFO_SIZE];
+	enc->pending_arrival = info->arrival;
+
+	if (GST_CLOCK_TIME_IS_VALID(info->timestamp))
 	{
-		caps = gst_caps_new_simple("video/x-h264", "width", G_TYPE_INT, 
-				enc->width, "height", G_TYPE_INT, 
-				enc->height, "framerate", 
-				GST_TYPE_FRACTION, enc->fps_numerator, 
-				enc->fps_denominator, NULL);
+		GST_BUFFER_TIMESTAMP(buffer) = info->timestamp;
 	}
 	else
 	{
-		GST_ELEMENT_ERROR((GstElement*)enc, CORE, NEGOTIATION,
-					("Format undefined."), (NULL));
+		GST_BUFFER_TIMESTAMP(buffer) = gst_sh_video_enc_frame_time(enc, input);
 	}
 
-	if (!gst_pad_set_caps(enc->srcpad, caps))
+	if (GST_CLOCK_TIME_IS_VALID(info->duration))
 	{
-		GST_ELEMENT_ERROR((GstElement*)enc, CORE, NEGOTIATION,
-					("Source pad not linked."), (NULL));
-		ret = FALSE;
+		GST_BUFFER_DURATION(buffer) = info->duration;
 	}
-	if (!gst_pad_set_caps(gst_pad_get_peer(enc->srcpad), caps))
+	else
 	{
-		GST_ELEMENT_ERROR((GstElement*)enc, CORE, NEGOTIATION,
-					("Source pad not linked."), (NULL));
-		ret = FALSE;
+		GST_BUFFER_DURATION(buffer) = frame_duration;
+	}
+
+	if (info->discont)
+	{
+		GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+		info->discont = FALSE;
 	}
-	gst_caps_unref(caps);
-	return ret;
 }
 
-void
-gst_sh_video_enc_init_encoder(GstSHVideoEnc * enc)
+static int 
+gst_sh_video_enc_get_input(SHCodecs_Encoder * encoder, void *user_data)
 {
-	gint ret = 0;
-	glong fmt = 0;
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)user_data;
+	GstSHVideoEncFrame *frame;
+	GList *events;
+	gint ret=0;
 
 	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
 
-	if (strlen(enc->ainfo.ctrl_file_name_buf))
+	// The VPU is done with the previous frame, let the other instances in
+	vpu_sched_release(enc->vpu);
+
+	// All the output of the previous frame has been received
+	if (!gst_sh_video_enc_push_unit(enc))
 	{
+		return 1;
+	}
+	gst_sh_video_enc_finish_slices(enc);
 
-		ret = GetFromCtrlFTop((const char *)
-				enc->ainfo.ctrl_file_name_buf,
-				&enc->ainfo,
-				&fmt);
-		if (ret < 0) 
-		{
-			GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
-				  ("Error reading the top of control file."), 
-				  (NULL));
-		}
+	if (enc->key_unit_forced)
+	{
+		/* Only bitrate is known to change reliably while encoding. If the
+		   interval of one frame was ignored, the periodic key frames 
+		   placed by the element would never come out, so they are left
+		   to the encoder for the rest of the stream. */
+		if (!enc->key_frame_out && !gst_sh_video_enc_vop_interval(enc) &&
+		    enc->i_vop_interval)
+		{
+			GST_WARNING_OBJECT(enc, "Forced key frame not seen in the "
+					   "output, the encoder places the periodic "
+					   "key frames from now on");
+			enc->vop_interval_fallback = TRUE;
+		}
+		shcodecs_encoder_set_I_vop_interval(encoder, 
+						    gst_sh_video_enc_vop_interval(enc));
+		enc->key_unit_forced = FALSE;
+	}
+	enc->key_frame_out = FALSE;
 
-		if (enc->format == SHCodecs_Format_NONE)
+	/* An I slice that is not an IDR is no sync point, the request stays
+	   pending and the next frame is forced too */
+	if (enc->key_unit_announce && enc->key_unit_attempts)
+	{
+		if (enc->key_unit_attempts < KEY_UNIT_MAX_ATTEMPTS)
 		{
-			enc->format = fmt;
+			GST_DEBUG_OBJECT(enc, "Forced frame was not a sync point");
+			g_atomic_int_set(&enc->force_key_unit, TRUE);
 		}
-
-		if (!enc->width)
+		else
 		{
-			enc->width = enc->ainfo.xpic;
+			GST_WARNING_OBJECT(enc, "No sync point after %d forced frames, "
+					   "waiting for the next one", 
+					   enc->key_unit_attempts);
+			enc->key_unit_attempts = 0;
 		}
+	}
 
-		if (!enc->height)
-		{
-			enc->height = enc->ainfo.ypic;
-		}
-		if (!enc->fps_numerator)
-		{
-			enc->fps_numerator = enc->ainfo.frame_rate;
-		}
+	gst_sh_video_enc_apply_changes(enc);
 
-		if (!enc->fps_denominator)
-		{
-			enc->fps_denominator = 10;
-		}
-	}
+	frame = gst_sh_video_enc_dequeue_frame(enc);
 
-    if (enc->format == SHCodecs_Format_NONE ||
-		!(enc->width && enc->height)||
-		!(enc->fps_numerator && enc->fps_denominator))
+	/* When a lower bitrate is not enough the controller thins out the
+	   frames. A requested key frame is never skipped, but it is counted
+	   like the others. The skipped frames go to the trace so that a replay
+	   sees every input frame. */
+	while (frame && enc->rate_control &&
+	       rate_control_skip_frame(enc->rate_control) &&
+	       !frame->force_key_unit)
 	{
-		GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
-			("Key parameters are not set."), 
-			("Encoding parameters undefined. Stream format:%d, width:%d, height:%d and framerate: %d/%d",
-			 enc->format, enc->width, enc->height,
-			 enc->fps_numerator, enc->fps_denominator));
-    }
+		rate_control_sample sample;
 
-	enc->encoder = shcodecs_encoder_init(enc->width, enc->height, enc->format);
+		gst_sh_video_enc_rate_sample(enc, &sample, frame->timestamp, 0,
+					     TRUE);
+		gst_sh_video_enc_drop_frame(enc, frame);
+		frame = gst_sh_video_enc_dequeue_frame(enc);
+	}
 
-	shcodecs_encoder_set_frame_rate(enc->encoder,
-	 	(enc->fps_numerator / enc->fps_denominator) * 10);
+	if (!frame)
+	{
+		GST_DEBUG_OBJECT(enc, "Encoding stop requested, returning 1");
+		return 1;
+	}
 
-	shcodecs_encoder_set_xpic_size(enc->encoder,enc->width);
-	shcodecs_encoder_set_ypic_size(enc->encoder,enc->height);
+	// The events of the dropped frames, then those before this frame
+	pthread_mutex_lock(&enc->mutex);
+	events = g_list_concat(enc->carried_events, frame->events);
+	enc->carried_events = NULL;
+	pthread_mutex_unlock(&enc->mutex);
+	frame->events = NULL;
+	if (!gst_sh_video_enc_queue_events(enc, events))
+	{
+		gst_sh_video_enc_free_frame(frame);
+		return 1;
+	}
 
-	shcodecs_encoder_set_input_callback(enc->encoder, 
-					    gst_sh_video_enc_get_input, enc);
-	shcodecs_encoder_set_output_callback(enc->encoder, 
-					     gst_sh_video_enc_write_output, enc);
+	gst_sh_video_enc_track_interval(enc, frame);
 
-	if (strlen(enc->ainfo.ctrl_file_name_buf))
+	/* libshcodecs has no call for a single key frame, an interval of one
+	   frame is used for this frame only */
+	if (frame->force_key_unit || 
+	    g_atomic_int_compare_and_exchange(&enc->force_key_unit, TRUE, FALSE))
 	{
-		ret = GetFromCtrlFtoEncParam(enc->encoder, &enc->ainfo);
-		
-		if (ret < 0) 
-		{
-			GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
-				  ("Error reading parameters from control file."), 
-				  (NULL));
-		}
+		GST_DEBUG_OBJECT(enc, "Forcing a key frame at %" GST_TIME_FORMAT,
+				 GST_TIME_ARGS(frame->timestamp));
+		shcodecs_encoder_set_I_vop_interval(encoder, 1);
+		enc->key_unit_forced = TRUE;
+		enc->key_unit_announce = TRUE;
+		enc->key_unit_attempts++;
+		g_atomic_int_set(&enc->scene_cut_pending, FALSE);
 	}
-	else
+	else if (frame->scene_cut || 
+		 g_atomic_int_compare_and_exchange(&enc->scene_cut_pending, 
+						   TRUE, FALSE))
 	{
-		if (!gst_sh_video_enc_set_encoding_properties(enc))
-		{
-			GST_ELEMENT_ERROR((GstElement*)enc, CORE, FAILED,
-				  ("Setting SHCodecs encoder properties failed."), 
-				  (NULL));
-		}		
+		GST_DEBUG_OBJECT(enc, "Scene cut at %" GST_TIME_FORMAT,
+				 GST_TIME_ARGS(frame->timestamp));
+		shcodecs_encoder_set_I_vop_interval(encoder, 1);
+		enc->key_unit_forced = TRUE;
+	}
+	else if (!gst_sh_video_enc_vop_interval(enc) && enc->i_vop_interval &&
+		 enc->frames_since_key + 1 >= enc->i_vop_interval)
+	{
+		// Periodic key frame counted from the latest one
+		shcodecs_encoder_set_I_vop_interval(encoder, 1);
+		enc->key_unit_forced = TRUE;
 	}
+	enc->frames_since_key = enc->key_unit_forced ? 
+		0 : enc->frames_since_key + 1;
 
-	GST_DEBUG_OBJECT(enc, "Encoder init: %ldx%ld %ldfps format:%ld",
-			 shcodecs_encoder_get_xpic_size(enc->encoder),
-			 shcodecs_encoder_get_ypic_size(enc->encoder),
-			 shcodecs_encoder_get_frame_rate(enc->encoder) / 10,
-			 shcodecs_encoder_get_stream_type(enc->encoder)); 
+	/* The frame is late once the next one is due. The encoder runs 
+	   the frame on the VPU as soon as we return. */
+	vpu_sched_acquire(enc->vpu, frame->arrival + 
+		gst_sh_video_enc_frame_duration(enc) / GST_USECOND);
+
+	ret = shcodecs_encoder_input_provide(encoder, frame->y, frame->cbcr);
+	enc->encode_start = enc_stats_now();
+
+	gst_sh_video_enc_store_frame_info(enc, frame);
+
+	// The encoder has read the planes, upstream may reuse the memory
+	gst_sh_video_enc_free_frame(frame);
+
+	return ret;
 }
 
-static gboolean
-gst_sh_video_enc_activate(GstPad * pad)
+static GstBuffer *
+gst_sh_video_enc_new_output_buffer(GstSHVideoEnc *enc, guint size)
 {
-	gboolean ret;
-	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));
+	GstBuffer *buffer = NULL;
+	guint frame_bytes;
+
+	if (!enc->output_pool)
+	{
+		/* No coded frame can be larger than the VBV/CPB buffer */
+		if (enc->format == SHCodecs_Format_H264)
+		{
+			enc->output_buffer_size = enc->ratecontrol_cpb_max_size * 
+				enc->ratecontrol_cpb_buffer_unit_size / 8;
+		}
+		else
+		{
+			enc->output_buffer_size = enc->ratecontrol_vbv_max_size * 
+				enc->ratecontrol_vbv_buffer_unit_size / 8;
+		}
+
+		if (!enc->output_buffer_size)
+		{
+			// Room for eight average frames
+			frame_bytes = gst_util_uint64_scale(enc->bitrate / 8, 
+					gst_sh_video_enc_frame_duration(enc), GST_SECOND);
+			enc->output_buffer_size = frame_bytes * 8;
+		}
+
+		// Never more than a raw frame
+		enc->output_buffer_size = MIN(enc->output_buffer_size,
+					      enc->width * enc->height * 3 / 2);
+
+		GST_DEBUG_OBJECT(enc, "Output pool of %d buffers of %d bytes",
+				 OUTPUT_POOL_SIZE, enc->output_buffer_size);
 
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
-	if (gst_pad_check_pull_range(pad)) 
+		enc->output_pool = gst_sh_buffer_pool_new(OUTPUT_POOL_SIZE);
+	}
+
+	if (size <= enc->output_buffer_size)
 	{
-		GST_LOG_OBJECT(enc, "PULL mode");
-		ret = gst_pad_activate_pull(pad, TRUE);
-	} 
-	else 
-	{  
-		GST_LOG_OBJECT(enc, "PUSH mode");
-		ret = gst_pad_activate_push(pad, TRUE);
+		buffer = gst_sh_buffer_pool_get(enc->output_pool, 
+						enc->output_buffer_size);
 	}
-	return ret;
+
+	if (!buffer)
+	{
+		GST_LOG_OBJECT(enc, "Output pool exhausted or %d bytes too large", size);
+		buffer = gst_buffer_new_and_alloc(size);
+	}
+	return buffer;
 }
 
-static GstStateChangeReturn
-gst_sh_video_enc_change_state(GstElement *element, GstStateChange transition)
+static guint8 *
+gst_sh_video_enc_reserve_output(GstSHVideoEnc *enc, guint length)
 {
-	GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
-	GstSHVideoEnc *enc = GST_SH_VIDEO_ENC(element);
+	GstBuffer *buffer;
+	guint size = 0;
 
-	ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, 
-							      transition);
-	if (ret == GST_STATE_CHANGE_FAILURE)
+	if (enc->pending_unit)
 	{
-		return ret;
+		size = GST_BUFFER_SIZE(enc->pending_unit);
 	}
 
-	switch (transition) 
+	if (!enc->pending_unit || size + length > enc->pending_capacity)
 	{
-		case GST_STATE_CHANGE_PAUSED_TO_READY:
+		/* libshcodecs reuses its memory, the data is copied to 
+		   memory we own */
+		buffer = gst_sh_video_enc_new_output_buffer(enc, 
+				MAX(size + length, 2 * size));
+		enc->pending_capacity = GST_BUFFER_SIZE(buffer);
+
+		if (enc->pending_unit)
 		{
-			GST_DEBUG_OBJECT(enc, "Stopping encoding.");
-			enc->stream_stopped = TRUE;        
-			break;
+			GST_LOG_OBJECT(enc, "Access unit over %d bytes", size);
+			memcpy(GST_BUFFER_DATA(buffer), 
+			       GST_BUFFER_DATA(enc->pending_unit), size);
+			gst_buffer_copy_metadata(buffer, enc->pending_unit,
+						 GST_BUFFER_COPY_FLAGS | 
+						 GST_BUFFER_COPY_TIMESTAMPS);
+			gst_buffer_unref(enc->pending_unit);
 		}
-		default:
-			break;
+		else
+		{
+			gst_sh_video_enc_stamp_output(enc, buffer);
+			enc->pending_sync = FALSE;
+		}
+		enc->pending_unit = buffer;
 	}
-	return ret;
+	GST_BUFFER_SIZE(enc->pending_unit) = size;
+
+	return GST_BUFFER_DATA(enc->pending_unit) + size;
 }
 
-static GstFlowReturn 
-gst_sh_video_enc_chain(GstPad * pad, GstBuffer * buffer)
+static void
+gst_sh_video_enc_append_output(GstSHVideoEnc *enc, unsigned char *data, 
+			       guint length)
 {
-	gint yuv_size, cbcr_size;
-	GstSHVideoEnc *enc = (GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));  
+	guint8 *out;
 
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
-
-	if (enc->stream_stopped)
+	if (enc->format == SHCodecs_Format_H264 && 
+	    enc->stream_format == STREAM_FORMAT_AVC)
 	{
-		return GST_FLOW_UNEXPECTED;
+		gst_sh_video_enc_append_avc(enc, data, length);
+		return;
 	}
 
-	if (!enc->caps_set)
+	out = gst_sh_video_enc_reserve_output(enc, length);
+	memcpy(out, data, length);
+	GST_BUFFER_SIZE(enc->pending_unit) += length;
+}
+
+static void
+gst_sh_video_enc_append_avc(GstSHVideoEnc *enc, const guint8 *data, 
+			    guint length)
+{
+	const guint8 *end = data + length;
+	const guint8 *nal;
+	const guint8 *next;
+	guint8 *out;
+	guint size;
+
+	nal = bitstream_find_start_code(data, end);
+	while (nal < end)
 	{
-		gst_sh_video_enc_read_sink_caps(enc);
-		gst_sh_video_enc_read_src_caps(enc);
-		gst_sh_video_enc_init_encoder(enc);
-		if (!gst_caps_is_any(enc->out_caps))
+		nal += 3;
+		next = bitstream_find_start_code(nal, end);
+
+		/* Drops the leading zero of the next four byte start code */
+		size = next - nal;
+		while (size && nal[size - 1] == 0)
 		{
-			if (!gst_sh_video_enc_set_src_caps(enc))
+			size--;
+		}
+
+		if (size)
+		{
+			switch (nal[0] & 0x1f)
 			{
-				return GST_FLOW_UNEXPECTED;
+			case H264_NAL_SPS:
+				gst_sh_video_enc_store_nal(enc, &enc->sps, nal, 
+							   size);
+				break;
+			case H264_NAL_PPS:
+				gst_sh_video_enc_store_nal(enc, &enc->pps, nal, 
+							   size);
+				break;
+			default:
+				out = gst_sh_video_enc_reserve_output(enc, 
+								      size + 4);
+				GST_WRITE_UINT32_BE(out, size);
+				memcpy(out + 4, nal, size);
+				GST_BUFFER_SIZE(enc->pending_unit) += size + 4;
+
+				if ((nal[0] & 0x1f) == H264_NAL_IDR)
+				{
+					enc->pending_sync = TRUE;
+				}
+				break;
 			}
 		}
-		enc->caps_set = TRUE;
+		nal = next;
 	}
+}
+
+static void
+gst_sh_video_enc_store_nal(GstSHVideoEnc *enc, GstBuffer **store, 
+			   const guint8 *data, guint size)
+{
+	GstBuffer *buffer;
 
-	/* If buffers are not empty we'll have to 
-	   wait until encoder has consumed data */
-	if (enc->buffer_yuv && enc->buffer_cbcr)
+	if (*store && GST_BUFFER_SIZE(*store) == size &&
+	    !memcmp(GST_BUFFER_DATA(*store), data, size))
 	{
-		pthread_mutex_lock(&enc->cond_mutex);
-		pthread_cond_wait(&enc->thread_condition, &enc->cond_mutex);
-		pthread_mutex_unlock(&enc->cond_mutex);
+		return;
 	}
 
-	// Lock mutex while handling the buffers
-	pthread_mutex_lock(&enc->mutex);
-	yuv_size = enc->width * enc->height;
-	cbcr_size = enc->width * enc->height / 2;
+	buffer = gst_buffer_new_and_alloc(size);
+	memcpy(GST_BUFFER_DATA(buffer), data, size);
+	gst_buffer_replace(store, buffer);
+	gst_buffer_unref(buffer);
 
-	// Check that we have got enough data
-	if (GST_BUFFER_SIZE(buffer) != yuv_size + cbcr_size)
+	if (enc->sps && enc->pps && GST_BUFFER_SIZE(enc->sps) >= 4)
 	{
-		GST_DEBUG_OBJECT(enc, "Not enough data");
-		// If we can't continue we can issue EOS
-		enc->eos = TRUE;
-		gst_pad_push_event(enc->srcpad, gst_event_new_eos());
-		return GST_FLOW_OK;
-	}  
+		guint avcc_size;
+		GstBuffer *avcc;
+
+		avcc_size = bitstream_h264_avcc_size(GST_BUFFER_SIZE(enc->sps),
+						     GST_BUFFER_SIZE(enc->pps));
+		avcc = gst_buffer_new_and_alloc(avcc_size);
+		bitstream_h264_write_avcc(GST_BUFFER_DATA(avcc),
+					  GST_BUFFER_DATA(enc->sps), 
+					  GST_BUFFER_SIZE(enc->sps),
+					  GST_BUFFER_DATA(enc->pps),
+					  GST_BUFFER_SIZE(enc->pps));
+		gst_sh_video_enc_set_codec_data(enc, GST_BUFFER_DATA(avcc),
+						avcc_size);
+		gst_buffer_unref(avcc);
+	}
+}
 
-	enc->buffer_yuv = gst_buffer_new_and_alloc(yuv_size);
-	enc->buffer_cbcr = gst_buffer_new_and_alloc(cbcr_size);
+static void
+gst_sh_video_enc_set_codec_data(GstSHVideoEnc *enc, const guint8 *data, 
+				guint size)
+{
+	GstCaps *caps;
 
-	memcpy(GST_BUFFER_DATA(enc->buffer_yuv), GST_BUFFER_DATA(buffer), yuv_size);
+	if (!enc->src_caps || (enc->codec_data && 
+			       GST_BUFFER_SIZE(enc->codec_data) == size &&
+			       !memcmp(GST_BUFFER_DATA(enc->codec_data), data, 
+				       size)))
+	{
+		return;
+	}
 
-	memcpy(GST_BUFFER_DATA(enc->buffer_cbcr),
-		   GST_BUFFER_DATA(buffer) + yuv_size, cbcr_size);
+	GST_DEBUG_OBJECT(enc, "New codec_data, %d bytes", size);
 
-	// Buffers are ready to be read
-	pthread_mutex_unlock(&enc->mutex);
+	gst_buffer_replace(&enc->codec_data, NULL);
+	enc->codec_data = gst_buffer_new_and_alloc(size);
+	memcpy(GST_BUFFER_DATA(enc->codec_data), data, size);
 
-	gst_buffer_unref(buffer);
-	
-	if (!enc->enc_thread)
+	caps = gst_caps_copy(enc->src_caps);
+	if (enc->rtp)
 	{
-		/* We'll have to launch the encoder in 
-		   a separate thread to keep the pipeline running */
-		pthread_create(&enc->enc_thread, NULL, 
-				gst_sh_video_launch_encoder_thread, enc);
+		gst_sh_video_enc_set_rtp_config(enc, caps);
 	}
-
-	return GST_FLOW_OK;
+	else
+	{
+		gst_caps_set_simple(caps, "codec_data", GST_TYPE_BUFFER, 
+				    enc->codec_data, NULL);
+	}
+	gst_caps_replace(&enc->src_caps, caps);
+	gst_caps_unref(caps);
 }
 
 static gboolean
-gst_sh_video_enc_activate_pull(GstPad  *pad,
-					 gboolean active)
+gst_sh_video_enc_push_unit(GstSHVideoEnc *enc)
 {
-	GstSHVideoEnc *enc = 
-		(GstSHVideoEnc *)(GST_OBJECT_PARENT(pad));
-
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+	GstBuffer *buffer = enc->pending_unit;
+	gboolean sync_point;
+	guint header_size;
+	GstEvent *event;
 
-	if (active) 
+	if (!buffer)
 	{
-		enc->offset = 0;
-		return gst_pad_start_task(pad,
-				(GstTaskFunction)gst_sh_video_enc_loop, enc);
-	} 
-	else 
-	{
-		return gst_pad_stop_task(pad);
+		return TRUE;
 	}
-}
-
-static void
-gst_sh_video_enc_loop(GstSHVideoEnc *enc)
-{
-	GstFlowReturn ret;
-	gint yuv_size, cbcr_size;
-	GstBuffer* tmp;
+	enc->pending_unit = NULL;
 
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+	if (enc->format == SHCodecs_Format_H264)
+	{
+		// The avc units have no start codes left to scan
+		sync_point = enc->stream_format == STREAM_FORMAT_AVC ?
+			enc->pending_sync :
+			bitstream_h264_has_idr(GST_BUFFER_DATA(buffer),
+					       GST_BUFFER_SIZE(buffer));
 
-	if (!enc->caps_set)
+		// The parameter sets come with the IDR units
+		if (enc->rtp && sync_point)
+		{
+			gst_sh_video_enc_store_parameter_sets(enc, buffer);
+		}
+	}
+	else
 	{
-		gst_sh_video_enc_read_sink_caps(enc);
-		gst_sh_video_enc_read_src_caps(enc);
-		gst_sh_video_enc_init_encoder(enc);
-		if (!gst_caps_is_any(enc->out_caps))
+		sync_point = bitstream_mpeg4_has_i_vop(GST_BUFFER_DATA(buffer),
+						       GST_BUFFER_SIZE(buffer));
+
+		header_size = 
+			bitstream_mpeg4_header_size(GST_BUFFER_DATA(buffer),
+						    GST_BUFFER_SIZE(buffer));
+		if (header_size)
 		{
-			if (!gst_sh_video_enc_set_src_caps(enc))
-			{
-				gst_pad_pause_task(enc->sinkpad);
-				return;
-			}
+			gst_sh_video_enc_set_codec_data(enc, 
+							GST_BUFFER_DATA(buffer),
+							header_size);
 		}
-		enc->caps_set = TRUE;
 	}
 
-	/* If buffers are not empty we'll have to 
-	   wait until encoder has consumed data */
-	if (enc->buffer_yuv && enc->buffer_cbcr)
+	if (sync_point)
 	{
-		pthread_mutex_lock(&enc->cond_mutex);
-		pthread_cond_wait(&enc->thread_condition, &enc->cond_mutex);
-		pthread_mutex_unlock(&enc->cond_mutex);
+		enc->key_frame_out = TRUE;
 	}
 
-	// Lock mutex while handling the buffers
-	pthread_mutex_lock(&enc->mutex);
-	yuv_size = enc->width * enc->height;
-	cbcr_size = enc->width * enc->height / 2;
-
-	ret = gst_pad_pull_range(enc->sinkpad, enc->offset,
-			yuv_size, &enc->buffer_yuv);
-
-	if (ret != GST_FLOW_OK) 
+	if (!sync_point)
 	{
-		GST_DEBUG_OBJECT(enc, "pull_range failed: %s", gst_flow_get_name(ret));
-		gst_pad_pause_task(enc->sinkpad);
-		enc->eos = TRUE;
-		gst_pad_push_event(enc->srcpad, gst_event_new_eos());
-		return;
+		GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
 	}
-	else if (GST_BUFFER_SIZE(enc->buffer_yuv) != yuv_size)
+	else if (enc->key_unit_announce)
 	{
-		GST_DEBUG_OBJECT(enc, "Not enough data");
-		gst_pad_pause_task(enc->sinkpad);
-		enc->eos = TRUE;
-		gst_pad_push_event(enc->srcpad, gst_event_new_eos());
-		return;
-	}  
+		// Tells downstream which frame answers the request
+		enc->key_unit_announce = FALSE;
+		enc->key_unit_attempts = 0;
+		event = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM,
+				gst_structure_new("GstForceKeyUnit",
+						  "timestamp", G_TYPE_UINT64, 
+						  GST_BUFFER_TIMESTAMP(buffer),
+						  NULL));
+		if (!gst_sh_video_enc_queue_output(enc, GST_MINI_OBJECT(event)))
+		{
+			gst_buffer_unref(buffer);
+			return FALSE;
+		}
+	}
 
-	enc->offset += yuv_size;
+	if (enc->src_caps)
+	{
+		gst_buffer_set_caps(buffer, enc->src_caps);
+	}
 
-	ret = gst_pad_pull_range(enc->sinkpad, enc->offset, cbcr_size, &tmp);
+	GST_BUFFER_OFFSET(buffer) = enc->bytes_out;
+	enc->bytes_out += GST_BUFFER_SIZE(buffer);
+	GST_BUFFER_OFFSET_END(buffer) = enc->bytes_out;
 
-	if (ret != GST_FLOW_OK) 
+	if (!gst_sh_video_enc_slice_output(enc))
 	{
-		GST_DEBUG_OBJECT(enc, "pull_range failed: %s", gst_flow_get_name(ret));
-		gst_pad_pause_task(enc->sinkpad);
-		enc->eos = TRUE;
-		gst_pad_push_event(enc->srcpad, gst_event_new_eos());
-		return;
-	}  
-	else if (GST_BUFFER_SIZE(tmp) != cbcr_size)
+		enc->frame_number++;
+		gst_sh_video_enc_count_frame(enc, GST_BUFFER_TIMESTAMP(buffer),
+			GST_BUFFER_SIZE(buffer), 
+			gst_sh_video_enc_frame_type(enc, buffer, sync_point));
+	}
+	else
 	{
-		GST_DEBUG_OBJECT(enc, "Not enough data");
-		gst_pad_pause_task(enc->sinkpad);
-		enc->eos = TRUE;
-		gst_pad_push_event(enc->srcpad, gst_event_new_eos());
-		return;
-	}  
-
-	enc->offset += cbcr_size;
-
-	enc->buffer_cbcr = tmp;
+		/* In low latency mode the slices of a frame are added up and 
+		   the frame is counted once the encoder has finished it */
+		if (enc->cycle_outputs == 1)
+		{
+			gst_sh_video_enc_finish_slices(enc);
+			enc->frame_number++;
+			enc->slices_pending = TRUE;
+			enc->slices_timestamp = GST_BUFFER_TIMESTAMP(buffer);
+			enc->slices_size = 0;
+			enc->slices_type = 
+				gst_sh_video_enc_frame_type(enc, buffer, sync_point);
+		}
+		enc->slices_size += GST_BUFFER_SIZE(buffer);
+	}
 
-	pthread_mutex_unlock(&enc->mutex);
-	
-	if (!enc->enc_thread)
+	if (enc->rtp)
 	{
-		/* We'll have to launch the encoder in 
-		   a separate thread to keep the pipeline running */
-		pthread_create(&enc->enc_thread, NULL, 
-					gst_sh_video_launch_encoder_thread, enc);
+		return gst_sh_video_enc_push_rtp(enc, buffer);
 	}
+
+	/* The push task sends it downstream, a slow downstream 
+	   doesn't hold up the encoder until the queue is full */
+	return gst_sh_video_enc_queue_output(enc, GST_MINI_OBJECT(buffer));
 }
 
-void *
-gst_sh_video_launch_encoder_thread(void *data)
+static gboolean
+gst_sh_video_enc_slice_output(GstSHVideoEnc *enc)
 {
-	gint ret;
-	GstSHVideoEnc *enc = (GstSHVideoEnc *)data;
-
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
-
-	ret = shcodecs_encoder_run(enc->encoder);
+	return enc->slice_output;
+}
 
-	GST_DEBUG_OBJECT(enc, "shcodecs_encoder_run returned %d\n", ret);
-	GST_DEBUG_OBJECT(enc, "%d frames encoded.", enc->frame_number);
+static gboolean
+gst_sh_video_enc_set_slice_output(GstSHVideoEnc *enc)
+{
+	glong slice_size_mb = enc->slice_size_mb;
 
-	// We can stop waiting if encoding has ended
-	pthread_mutex_lock(&enc->cond_mutex);
-	pthread_cond_signal(&enc->thread_condition);
-	pthread_mutex_unlock(&enc->cond_mutex);
+	if (!enc->low_latency || enc->format != SHCodecs_Format_H264)
+	{
+		return FALSE;
+	}
 
-	// Calling stop task won't do any harm if we are in push mode
-	gst_pad_stop_task(enc->sinkpad);
-	if(!enc->eos)
+	// One macroblock row per slice unless a slice size is given
+	if (!slice_size_mb && !enc->slice_size_bit)
 	{
-		enc->eos = TRUE;
-		gst_pad_push_event(enc->srcpad, gst_event_new_eos());
-    }
+		slice_size_mb = enc->width / 16;
+	}
 
-	return NULL;
+	/* The encoder returns after each NAL unit, and a frame is split 
+	   into several slices */
+	if (shcodecs_encoder_set_h264_call_unit(enc->encoder, 
+						CALL_UNIT_NAL) == -1 ||
+	    shcodecs_encoder_set_h264_use_slice(enc->encoder, 1) == -1 ||
+	    (slice_size_mb ? 
+	     shcodecs_encoder_set_h264_slice_size_mb(enc->encoder, 
+						     slice_size_mb) :
+	     shcodecs_encoder_set_h264_slice_size_bit(enc->encoder, 
+						      enc->slice_size_bit)) == -1)
+	{
+		GST_WARNING_OBJECT(enc, "Slice settings not accepted, "
+				   "low-latency is off");
+		return FALSE;
+	}
+	return TRUE;
 }
 
-static int 
-gst_sh_video_enc_get_input(SHCodecs_Encoder * encoder, void *user_data)
+static gboolean
+gst_sh_video_enc_push_rtp(GstSHVideoEnc *enc, GstBuffer *unit)
 {
-	GstSHVideoEnc *enc = (GstSHVideoEnc *)user_data;
-	gint ret=0;
-
-	GST_LOG_OBJECT(enc, "%s called", __FUNCTION__);
+	// In low latency mode the end of the frame is not known
+	gboolean marker = !gst_sh_video_enc_slice_output(enc);
+	gboolean ret;
+#if GST_CHECK_VERSION(0,10,24)
+	GstBufferList *list;
 
-	// Lock mutex while reading the buffer  
-	pthread_mutex_lock(&enc->mutex); 
+	list = gst_buffer_list_new();
+	enc->packets = gst_buffer_list_iterate(list);
+#endif
 
-	if (enc->stream_stopped || enc->eos)
+	if (enc->format == SHCodecs_Format_H264)
 	{
-		GST_DEBUG_OBJECT(enc, "Encoding stop requested, returning 1");
-		ret = 1;
+		ret = gst_sh_rtp_packetize_h264(enc->packetizer, unit, marker,
+						gst_sh_video_enc_add_packet, enc);
 	}
-	else if (enc->buffer_yuv && enc->buffer_cbcr)
+	else
 	{
-		ret = shcodecs_encoder_input_provide(encoder, 
-					 GST_BUFFER_DATA(enc->buffer_yuv),
-					 GST_BUFFER_DATA(enc->buffer_cbcr));
+		ret = gst_sh_rtp_packetize_mpeg4(enc->packetizer, unit, marker,
+						 gst_sh_video_enc_add_packet, enc);
+	}
 
-		gst_buffer_unref(enc->buffer_yuv);
-		enc->buffer_yuv = NULL;
-		gst_buffer_unref(enc->buffer_cbcr);
-		enc->buffer_cbcr = NULL;  
+	// The packets keep the data alive
+	gst_buffer_unref(unit);
 
-		// Signal the main thread that buffers are read
-		pthread_mutex_lock(&enc->cond_mutex);
-		pthread_cond_signal(&enc->thread_condition);
-		pthread_mutex_unlock(&enc->cond_mutex);
-	}
-	pthread_mutex_unlock(&enc->mutex);
+#if GST_CHECK_VERSION(0,10,24)
+	gst_buffer_list_iterator_free(enc->packets);
+	enc->packets = NULL;
 
+	if (!ret)
+	{
+		gst_buffer_list_unref(list);
+		return FALSE;
+	}
+	return gst_sh_video_enc_queue_output(enc, GST_MINI_OBJECT(list));
+#else
 	return ret;
+#endif
+}
+
+static gboolean
+gst_sh_video_enc_add_packet(GstBuffer *header, GstBuffer *payload, 
+			    gpointer user_data)
+{
+	GstSHVideoEnc *enc = (GstSHVideoEnc *)user_data;
+#if GST_CHECK_VERSION(0,10,24)
+	gst_buffer_list_iterator_add_group(enc->packets);
+	gst_buffer_list_iterator_add(enc->packets, header);
+	if (payload)
+	{
+		gst_buffer_list_iterator_add(enc->packets, payload);
+	}
+	return TRUE;
+#else
+	GstBuffer *packet;
+
+	/* Without buffer lists a packet has to be in one buffer */
+	if (payload)
+	{
+		packet = gst_buffer_merge(header, payload);
+		gst_buffer_copy_metadata(packet, header, GST_BUFFER_COPY_ALL);
+		gst_buffer_unref(header);
+		gst_buffer_unref(payload);
+		header = packet;
+	}
+	return gst_sh_video_enc_queue_output(enc, GST_MINI_OBJECT(header));
+#endif
 }
 
 static int 
@@ -3083,38 +7196,45 @@ gst_sh_video_enc_write_output(SHCodecs_Encoder * encoder,
 			unsigned char *data, int length, void *user_data)
 {
 	GstSHVideoEnc *enc = (GstSHVideoEnc *)user_data;
-	GstBuffer* buf = NULL;
 	gint ret = 0;
 
 	GST_LOG_OBJECT(enc, "%s called. Got %d bytes data frame number: %d\n", 
 				   __FUNCTION__, length, enc->frame_number);
 
-	pthread_mutex_lock(&enc->mutex); 
-
 	if (enc->stream_stopped)
 	{
 		GST_DEBUG_OBJECT(enc, "Encoding stop requested, returning 1");
 		ret = 1;
 	}
+	else if (enc->output_flow != GST_FLOW_OK)
+	{
+		GST_DEBUG_OBJECT(enc, "Downstream returned %s, returning 1",
+				 gst_flow_get_name(enc->output_flow));
+		ret = 1;
+	}
 	else if (length)
 	{
-		buf = gst_buffer_new();
-		gst_buffer_set_data(buf, data, length);
+		/* With B-VOPs several VOPs come out for one input frame */
+		if (enc->pending_unit && enc->format == SHCodecs_Format_MPEG4 &&
+		    bitstream_mpeg4_has_vop(data, length) &&
+		    bitstream_mpeg4_has_vop(GST_BUFFER_DATA(enc->pending_unit),
+					    GST_BUFFER_SIZE(enc->pending_unit)))
+		{
+			if (!gst_sh_video_enc_push_unit(enc))
+			{
+				return 1;
+			}
+		}
 
-		GST_BUFFER_DURATION(buf) = 
-			enc->fps_denominator * 1000 * GST_MSECOND / enc->fps_numerator;
-		GST_BUFFER_TIMESTAMP(buf) = enc->frame_number*GST_BUFFER_DURATION(buf);
-		GST_BUFFER_OFFSET(buf) = enc->frame_number; 
-		enc->frame_number++;
+		gst_sh_video_enc_append_output(enc, data, length);
 
-		if (gst_pad_push(enc->srcpad, buf) != GST_FLOW_OK) 
+		// Slices are not held back in low latency mode
+		if (gst_sh_video_enc_slice_output(enc) && 
+		    !gst_sh_video_enc_push_unit(enc))
 		{
-			GST_DEBUG_OBJECT(enc, "pad_push failed: %s", 
-								gst_flow_get_name(ret));
 			ret = 1;
 		}
 	}
-	pthread_mutex_unlock(&enc->mutex); 
 	return ret;
 }
 
@@ -3209,7 +7329,8 @@ gst_sh_video_enc_set_encoding_properties(GstSHVideoEnc *enc)
 	{
 		return FALSE;
 	}
-	if (shcodecs_encoder_set_I_vop_interval(enc->encoder, enc->i_vop_interval) == -1)
+	if (shcodecs_encoder_set_I_vop_interval(enc->encoder, 
+						gst_sh_video_enc_vop_interval(enc)) == -1)
 	{
 		return FALSE;
 	}
@@ -29,6 +29,15 @@
 #include <pthread.h>
 
 #include "cntlfile/ControlFileUtil.h"
+#include "gstshringbuffer.h"
+#include "gstshbufferpool.h"
+#include "gstshrtp.h"
+#include "gstshratecontrol.h"
+#include "gstshencstats.h"
+#include "gstshencoderpool.h"
+#include "gstshencpresets.h"
+#include "gstshvpusched.h"
+#include "gstshscenecut.h"
 
 G_BEGIN_DECLS
 #define GST_TYPE_SH_VIDEO_ENC \
@@ -43,6 +52,100 @@ G_BEGIN_DECLS
 	(G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_SH_VIDEO_ENC))
 typedef struct _GstSHVideoEnc GstSHVideoEnc;
 typedef struct _GstSHVideoEncClass GstSHVideoEncClass;
+typedef struct _GstSHVideoEncFrame GstSHVideoEncFrame;
+
+/**
+ * Raw frame waiting in the encoder input queue. The frame keeps a reference
+ * to the buffers holding the planes until the encoder has read them.
+ * \var buffer_yuv Buffer holding the Y plane (and CbCr plane when it is 
+ *      contiguous)
+ * \var buffer_cbcr Separate buffer holding the CbCr plane or NULL
+ * \var y Start of the Y plane
+ * \var cbcr Start of the CbCr plane
+ * \var timestamp Timestamp of the input buffer
+ * \var duration Duration of the input buffer
+ * \var discont TRUE if the input buffer was marked discontinuous
+ * \var force_key_unit TRUE if the frame has to be encoded as a key frame
+ * \var scene_cut TRUE if the frame starts a new scene
+ * \var arrival enc_stats_now() when the frame was queued
+ * \var events Serialized events received before the frame, pushed 
+ *      downstream before its encoded data
+ */
+struct _GstSHVideoEncFrame
+{
+	GstBuffer *buffer_yuv;
+	GstBuffer *buffer_cbcr;
+	guchar *y;
+	guchar *cbcr;
+	GstClockTime timestamp;
+	GstClockTime duration;
+	gboolean discont;
+	gboolean force_key_unit;
+	gboolean scene_cut;
+	guint64 arrival;
+	GList *events;
+};
+
+/**
+ * Number of frames whose timing is remembered while the encoder holds them
+ */
+#define GST_SH_VIDEO_ENC_FRAME_INFO_SIZE 16
+
+/**
+ * Number of 32-bit words in the mask of explicitly set properties
+ */
+#define GST_SH_VIDEO_ENC_PROPS_SET_SIZE 8
+
+/**
+ * Maximum number of simulcast renditions
+ */
+#define GST_SH_VIDEO_ENC_MAX_PROFILES 4
+
+/**
+ * Timing of a frame given to the encoder, used to stamp the encoded frame
+ */
+typedef struct _GstSHVideoEncFrameInfo
+{
+	GstClockTime timestamp;
+	GstClockTime duration;
+	gboolean discont;
+	guint64 arrival;
+}GstSHVideoEncFrameInfo;
+
+/**
+ * Output profile of a simulcast rendition
+ * \var width Width of the rendition
+ * \var height Height of the rendition
+ * \var bitrate Bitrate of the rendition
+ */
+typedef struct _GstSHVideoEncProfile
+{
+	gint width;
+	gint height;
+	glong bitrate;
+}GstSHVideoEncProfile;
+
+/**
+ * Simulcast rendition. A child encoder is fed with downscaled copies of the
+ * input frames and its output is pushed on a src_%d request pad.
+ * \var index Index of the profile
+ * \var srcpad The request pad
+ * \var encoder Child encoder
+ * \var proxy Pad the child encoder pushes to
+ * \var sink_caps Caps of the downscaled frames
+ * \var columns scale_nv12_columns() table for the input and rendition 
+ *      widths, made with sink_caps. Held in a buffer so that it is 
+ *      reference counted like the caps.
+ */
+typedef struct _GstSHVideoEncRendition
+{
+	guint index;
+	GstPad *srcpad;
+	GstSHVideoEnc *encoder;
+	GstPad *proxy;
+	GstCaps *sink_caps;
+	GstBuffer *columns;
+}GstSHVideoEncRendition;
 
 /**
  * Define Gstreamer SH Video Encoder structure
@@ -51,26 +154,129 @@ struct _GstSHVideoEnc
 {
 	GstElement element;
 	GstPad *sinkpad, *srcpad;
-	GstBuffer *buffer_yuv;
-	GstBuffer *buffer_cbcr;
 
-	gint offset;
+	ring_buffer *input_queue;
+	guint queue_depth;
+	volatile gint encoder_waiting;
+	volatile gint chain_waiting;
+
+	GstSHBufferPool *input_pool;
+	guint pool_size;
+	GstSHBufferPool *output_pool;
+	guint output_buffer_size;
+
+	ring_buffer *output_queue;
+	guint output_queue_size;
+	guint output_high_water;
+	volatile gint output_waiting;
+	volatile gint push_waiting;
+	gboolean output_stopped;
+	GstFlowReturn output_flow;
+
+	GList *pending_events;
+	GList *carried_events;
+
+	GstBuffer *pending_unit;
+	guint pending_capacity;
+	gboolean pending_sync;
+	guint64 bytes_out;
+
+	gint stream_format;
+	GstCaps *src_caps;
+	GstBuffer *codec_data;
+	GstBuffer *sps;
+	GstBuffer *pps;
+
+	gboolean rtp;
+	guint mtu;
+	guint pt;
+	guint ssrc;
+	GstSHRtpPacketizer *packetizer;
+#if GST_CHECK_VERSION(0,10,24)
+	GstBufferListIterator *packets;
+#endif
+
+	gint drop_policy;
+	gboolean low_latency;
+	gboolean slice_output;
+
+	gboolean key_unit_next_frame;
+	volatile gint force_key_unit;
+	gboolean key_unit_forced;
+	gboolean key_unit_announce;
+	gint key_unit_attempts;
+
+	volatile gint pending_changes;
+
+	const rate_control_policy *rate_policy;
+	rate_control *rate_control;
+	glong target_bitrate;
+	glong applied_bitrate;
+	gchar *rate_trace_name;
+	FILE *rate_trace;
+	volatile gint qos_proportion;
+
+	enc_stats *stats;
+	guint stats_interval;
+	guint64 stats_last_post;
+	guint64 encode_start;
+	guint64 pending_arrival;
+	gboolean slices_pending;
+	GstClockTime slices_timestamp;
+	guint slices_size;
+	enc_stats_frame_type slices_type;
+	volatile gint frames_dropped;
+
+	const enc_preset *preset;
+
+	gchar *simulcast;
+	GstSHVideoEncProfile profiles[GST_SH_VIDEO_ENC_MAX_PROFILES];
+	guint n_profiles;
+	GList *renditions;
+
+	vpu_sched_client *vpu;
+	gint vpu_priority;
+	guint vpu_weight;
+
+	scene_cut *scene_cut;
+	guint scene_cut_threshold;
+	gboolean scene_cut_restart_gop;
+	volatile gint scene_cut_pending;
+	glong frames_since_key;
+	gboolean key_frame_out;
+	gboolean vop_interval_fallback;
+
+	guint32 props_set[GST_SH_VIDEO_ENC_PROPS_SET_SIZE];
+
+	guint64 offset;
+	guint read_ahead;
 	SHCodecs_Format format;  
 	SHCodecs_Encoder* encoder;
 	gint width;
 	gint height;
+	guint32 fourcc;
+	gint rowstride;
+	gint chroma_offset;
 	gint fps_numerator;
 	gint fps_denominator;
+	GstClockTime last_input_timestamp;
+	GstClockTime frame_interval;
+	GstClockTime applied_interval;
 
 	APPLI_INFO ainfo;
 	
 	GstCaps* out_caps;
 	gboolean caps_set;
+	gboolean variable_framerate;
 	glong frame_number;
+	glong input_frames;
+	gint cycle_outputs;
+	GstSHVideoEncFrameInfo frame_info[GST_SH_VIDEO_ENC_FRAME_INFO_SIZE];
 	GstClockTime timestamp_offset;
 
 	gboolean stream_stopped;
 	gboolean eos;
+	gboolean encoder_clean;
 
 	pthread_t enc_thread;
 	pthread_mutex_t mutex;
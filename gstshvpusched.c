@@ -0,0 +1,411 @@
+/**
+ * Process-wide scheduler sharing the VPU between the encoder and decoder
+ * instances
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#include <pthread.h>
+#include <time.h>
+#include "gstshvpusched.h"
+
+/**
+ * \struct _vpu_sched_client
+ * \var priority Priority of the jobs
+ * \var weight Weight of the jobs
+ * \var cost Running average of the microseconds a job takes
+ * \var finish_tag Virtual finish time of the latest job
+ * \var start_tag Virtual start time of the waiting job
+ * \var deadline Deadline of the waiting or running job, 0 for none
+ * \var waiting Whether the client waits for the VPU
+ * \var granted Whether the waiting job has been let in
+ * \var running Whether the job is running
+ * \var expired Whether the running job has held the VPU for too long and 
+ *      no longer takes up a slot
+ * \var flushing Whether vpu_sched_acquire() should return at once
+ * \var request_time When the job started to wait
+ * \var grant_time When the job was let in
+ * \var jobs Number of jobs run
+ * \var missed Number of jobs finished after their deadline
+ * \var wait_total Microseconds the jobs have waited in total
+ * \var window_start Start of the current load window
+ * \var window_busy Microseconds the jobs have run in the current window
+ * \var load Load of the previous window
+ * \var cond Signaled when the job is let in
+ */
+struct _vpu_sched_client
+{
+	gint priority;
+	guint weight;
+	guint64 cost;
+	guint64 finish_tag;
+	guint64 start_tag;
+	guint64 deadline;
+	gboolean waiting;
+	gboolean granted;
+	gboolean running;
+	gboolean expired;
+	gboolean flushing;
+	guint64 request_time;
+	guint64 grant_time;
+
+	guint jobs;
+	guint missed;
+	guint64 wait_total;
+	guint64 window_start;
+	guint64 window_busy;
+	gdouble load;
+
+	pthread_cond_t cond;
+};
+
+/* Initial cost of a job, about a D1 frame */
+#define VPU_SCHED_INITIAL_COST 10000
+
+/* Microseconds the VPU is kept for a client that has just finished a job.
+   Each client has one job at a time, so without this a busy client is 
+   never waiting when the VPU is free and the weights would not matter. */
+#define VPU_SCHED_ANTICIPATION 2000
+
+/* All clients, in registration order */
+static GList *clients = NULL;
+static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Start tag of the latest job let in */
+static guint64 virtual_time = 0;
+/* Number of slots taken */
+static guint busy = 0;
+/* Client the free slot is kept for after its previous job */
+static vpu_sched_client *reserved = NULL;
+static guint64 reserve_until = 0;
+
+guint64
+vpu_sched_now(void)
+{
+	struct timespec now;
+
+	// The same clock as enc_stats_now()
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (guint64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * Check whether a waiting job has to start now to make its deadline
+ * \param client The client
+ * \param now Current time
+ */
+static gboolean
+vpu_sched_urgent(vpu_sched_client *client, guint64 now)
+{
+	return client->deadline && client->deadline <= now + client->cost;
+}
+
+/**
+ * Choose the next job. Higher priorities go first. Within a priority the
+ * jobs that would otherwise miss their deadline go first, earliest 
+ * deadline first, and the rest in the order of their virtual finish times.
+ * \param now Current time
+ * \return the client of the job or NULL if nobody is waiting
+ */
+static vpu_sched_client *
+vpu_sched_pick(guint64 now)
+{
+	GList *item;
+	vpu_sched_client *client, *best = NULL;
+	gboolean urgent, best_urgent = FALSE;
+
+	for (item = clients; item; item = item->next)
+	{
+		client = (vpu_sched_client *)item->data;
+		if (!client->waiting || client->granted || client->flushing)
+		{
+			continue;
+		}
+
+		urgent = vpu_sched_urgent(client, now);
+		if (!best || client->priority > best->priority ||
+		    (client->priority == best->priority &&
+		     (urgent != best_urgent ? urgent :
+		      urgent ? client->deadline < best->deadline :
+		      client->finish_tag < best->finish_tag)))
+		{
+			best = client;
+			best_urgent = urgent;
+		}
+	}
+	return best;
+}
+
+/**
+ * Let jobs in while there are free slots. Called with the mutex held.
+ * \param now Current time
+ */
+static void
+vpu_sched_dispatch(guint64 now)
+{
+	vpu_sched_client *client;
+
+	while (busy < VPU_SCHED_SLOTS)
+	{
+		if (reserved && !reserved->waiting && !reserved->flushing &&
+		    now < reserve_until)
+		{
+			break;
+		}
+
+		client = reserved && reserved->waiting && !reserved->flushing ? 
+			reserved : vpu_sched_pick(now);
+		reserved = NULL;
+		if (!client)
+		{
+			break;
+		}
+
+		client->granted = TRUE;
+		busy++;
+		virtual_time = MAX(virtual_time, client->start_tag);
+		pthread_cond_signal(&client->cond);
+	}
+}
+
+/**
+ * Free the slots of the jobs that have held the VPU for too long. Called 
+ * with the mutex held.
+ * \param now Current time
+ */
+static void
+vpu_sched_expire(guint64 now)
+{
+	GList *item;
+	vpu_sched_client *client;
+
+	for (item = clients; item; item = item->next)
+	{
+		client = (vpu_sched_client *)item->data;
+		if (client->running && !client->expired &&
+		    now - client->grant_time > VPU_SCHED_MAX_HOLD)
+		{
+			client->expired = TRUE;
+			busy--;
+		}
+	}
+}
+
+/**
+ * Finish the running job. Called with the mutex held.
+ * \param client The client
+ * \param anticipate Whether the VPU may be kept for the next job of the 
+ *        client
+ */
+static void
+vpu_sched_finish(vpu_sched_client *client, gboolean anticipate)
+{
+	vpu_sched_client *best;
+	guint64 now, elapsed;
+
+	now = vpu_sched_now();
+	elapsed = MIN(now - client->grant_time, VPU_SCHED_MAX_HOLD);
+
+	client->cost = (client->cost * 7 + elapsed) / 8;
+	client->jobs++;
+	if (client->deadline && now > client->deadline)
+	{
+		client->missed++;
+	}
+
+	client->window_busy += elapsed;
+	if (now - client->window_start >= VPU_SCHED_LOAD_WINDOW)
+	{
+		client->load = MIN((gdouble)client->window_busy / 
+				   (now - client->window_start), 1.0);
+		client->window_start = now;
+		client->window_busy = 0;
+	}
+
+	client->running = FALSE;
+	if (!client->expired)
+	{
+		busy--;
+	}
+	client->expired = FALSE;
+
+	best = vpu_sched_pick(now);
+	if (anticipate && best && !client->flushing && 
+	    client->priority >= best->priority && !vpu_sched_urgent(best, now) &&
+	    MAX(virtual_time, client->finish_tag) + 
+	    client->cost * VPU_SCHED_MAX_WEIGHT / client->weight < best->finish_tag)
+	{
+		reserved = client;
+		reserve_until = now + VPU_SCHED_ANTICIPATION;
+
+		// Shortens the wait of the next job in case the client won't return
+		pthread_cond_signal(&best->cond);
+	}
+
+	vpu_sched_dispatch(now);
+}
+
+vpu_sched_client *
+vpu_sched_client_new(void)
+{
+	vpu_sched_client *client;
+	pthread_condattr_t attr;
+
+	client = g_new0(vpu_sched_client, 1);
+	client->priority = VPU_SCHED_DEFAULT_PRIORITY;
+	client->weight = VPU_SCHED_DEFAULT_WEIGHT;
+	client->cost = VPU_SCHED_INITIAL_COST;
+	client->window_start = vpu_sched_now();
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&client->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	pthread_mutex_lock(&sched_mutex);
+	client->finish_tag = virtual_time;
+	clients = g_list_append(clients, client);
+	pthread_mutex_unlock(&sched_mutex);
+
+	return client;
+}
+
+void
+vpu_sched_client_free(vpu_sched_client *client)
+{
+	if (!client)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&sched_mutex);
+	clients = g_list_remove(clients, client);
+	if (client->running)
+	{
+		vpu_sched_finish(client, FALSE);
+	}
+	if (reserved == client)
+	{
+		reserved = NULL;
+		vpu_sched_dispatch(vpu_sched_now());
+	}
+	pthread_mutex_unlock(&sched_mutex);
+
+	pthread_cond_destroy(&client->cond);
+	g_free(client);
+}
+
+void
+vpu_sched_client_set_share(vpu_sched_client *client, gint priority, 
+			   guint weight)
+{
+	pthread_mutex_lock(&sched_mutex);
+	client->priority = CLAMP(priority, 0, VPU_SCHED_MAX_PRIORITY);
+	client->weight = CLAMP(weight, 1, VPU_SCHED_MAX_WEIGHT);
+	pthread_mutex_unlock(&sched_mutex);
+}
+
+void
+vpu_sched_client_set_flushing(vpu_sched_client *client, gboolean flushing)
+{
+	pthread_mutex_lock(&sched_mutex);
+	client->flushing = flushing;
+	pthread_cond_signal(&client->cond);
+	pthread_mutex_unlock(&sched_mutex);
+}
+
+void
+vpu_sched_acquire(vpu_sched_client *client, guint64 deadline)
+{
+	guint64 now;
+	struct timespec timeout;
+
+	pthread_mutex_lock(&sched_mutex);
+	if (client->running || client->flushing)
+	{
+		pthread_mutex_unlock(&sched_mutex);
+		return;
+	}
+
+	/* Weighted fair queuing: the job is ordered by its virtual finish time,
+	   which starts from the virtual time of the last dispatched job, so an
+	   idle client gets no credit for the time it did not use the VPU */
+	now = vpu_sched_now();
+	client->start_tag = MAX(virtual_time, client->finish_tag);
+	client->finish_tag = client->start_tag + 
+		client->cost * VPU_SCHED_MAX_WEIGHT / client->weight;
+	client->deadline = deadline;
+	client->request_time = now;
+	client->waiting = TRUE;
+	client->granted = FALSE;
+
+	vpu_sched_dispatch(now);
+	while (!client->granted && !client->flushing)
+	{
+		// Wake up now and then to check for a job stuck with the VPU
+		now = reserved ? MIN(reserve_until, now + VPU_SCHED_MAX_HOLD / 4) :
+			now + VPU_SCHED_MAX_HOLD / 4;
+		timeout.tv_sec = now / 1000000;
+		timeout.tv_nsec = (now % 1000000) * 1000;
+		pthread_cond_timedwait(&client->cond, &sched_mutex, &timeout);
+
+		now = vpu_sched_now();
+		vpu_sched_expire(now);
+		vpu_sched_dispatch(now);
+	}
+	client->waiting = FALSE;
+
+	if (client->granted)
+	{
+		client->granted = FALSE;
+		client->running = TRUE;
+		client->expired = FALSE;
+		client->grant_time = vpu_sched_now();
+		client->wait_total += client->grant_time - client->request_time;
+	}
+	pthread_mutex_unlock(&sched_mutex);
+}
+
+void
+vpu_sched_release(vpu_sched_client *client)
+{
+	pthread_mutex_lock(&sched_mutex);
+	if (client->running)
+	{
+		vpu_sched_finish(client, TRUE);
+	}
+	pthread_mutex_unlock(&sched_mutex);
+}
+
+void
+vpu_sched_client_get_stats(vpu_sched_client *client, vpu_sched_stats *stats)
+{
+	guint64 elapsed;
+
+	pthread_mutex_lock(&sched_mutex);
+	stats->jobs = client->jobs;
+	stats->missed = client->missed;
+	stats->wait = client->jobs ? client->wait_total / client->jobs : 0;
+
+	// A client that stopped using the VPU has no window closing
+	elapsed = vpu_sched_now() - client->window_start;
+	stats->load = elapsed < VPU_SCHED_LOAD_WINDOW ? client->load :
+		MIN((gdouble)client->window_busy / elapsed, 1.0);
+	pthread_mutex_unlock(&sched_mutex);
+}
@@ -0,0 +1,125 @@
+/**
+ * Process-wide scheduler sharing the VPU between the encoder and decoder
+ * instances
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA  02110-1301 USA
+ *
+ * \author Pablo Virolainen <pablo.virolainen@nomovok.com>
+ * \author Johannes Lahti <johannes.lahti@nomovok.com>
+ * \author Aki Honkasuo <aki.honkasuo@nomovok.com>
+ *
+ */
+
+#ifndef  GSTSHVPUSCHED_H
+#define  GSTSHVPUSCHED_H
+
+#include <glib.h>
+
+/** Number of jobs the VPU runs at the same time */
+#define VPU_SCHED_SLOTS 1
+
+/** Highest priority. A waiting job of a higher priority always goes first. */
+#define VPU_SCHED_MAX_PRIORITY 7
+#define VPU_SCHED_DEFAULT_PRIORITY 0
+
+/** Share of the VPU relative to the other clients of the same priority */
+#define VPU_SCHED_MAX_WEIGHT 16
+#define VPU_SCHED_DEFAULT_WEIGHT 1
+
+/** Microseconds after which a job is assumed stuck outside the VPU, 
+    typically pushing downstream, and the next job is let in */
+#define VPU_SCHED_MAX_HOLD 200000
+
+/** Microseconds over which the load of a client is measured */
+#define VPU_SCHED_LOAD_WINDOW 1000000
+
+typedef struct _vpu_sched_client vpu_sched_client;
+
+/**
+ * \struct _vpu_sched_stats gstshvpusched.h
+ * \var jobs Number of jobs run
+ * \var missed Number of jobs that were finished after their deadline
+ * \var wait Average microseconds a job waited for the VPU
+ * \var load Share of the time the client had the VPU in the last window,
+ *      0.0-1.0
+ */
+typedef struct _vpu_sched_stats
+{
+	guint jobs;
+	guint missed;
+	guint wait;
+	gdouble load;
+}vpu_sched_stats;
+
+/**
+ * Register a user of the VPU
+ * \return the client
+ */
+vpu_sched_client *vpu_sched_client_new(void);
+
+/**
+ * Unregister a user of the VPU. A job still running is finished.
+ * \param client The client
+ */
+void vpu_sched_client_free(vpu_sched_client *client);
+
+/**
+ * Set the priority and the weight of the following jobs
+ * \param client The client
+ * \param priority Priority, 0-VPU_SCHED_MAX_PRIORITY
+ * \param weight Weight, 1-VPU_SCHED_MAX_WEIGHT
+ */
+void vpu_sched_client_set_share(vpu_sched_client *client, gint priority, 
+				guint weight);
+
+/**
+ * Make vpu_sched_acquire() return at once, without waiting for the VPU. 
+ * Used to get the thread of the client stopped.
+ * \param client The client
+ * \param flushing TRUE to stop waiting, FALSE to schedule again
+ */
+void vpu_sched_client_set_flushing(vpu_sched_client *client, 
+				   gboolean flushing);
+
+/**
+ * Wait until the client may use the VPU for one job. Each client has at 
+ * most one job, the call returns at once if the job is already running.
+ * \param client The client
+ * \param deadline vpu_sched_now() time the job should be finished by, or 0
+ */
+void vpu_sched_acquire(vpu_sched_client *client, guint64 deadline);
+
+/**
+ * Finish the job of the client and let the next job in. Does nothing if
+ * the client has no job running.
+ * \param client The client
+ */
+void vpu_sched_release(vpu_sched_client *client);
+
+/**
+ * Get the utilization of the VPU by a client
+ * \param client The client
+ * \param stats The statistics
+ */
+void vpu_sched_client_get_stats(vpu_sched_client *client, 
+				vpu_sched_stats *stats);
+
+/**
+ * Get the time used for the deadlines
+ * \return monotonic microseconds from an arbitrary point
+ */
+guint64 vpu_sched_now(void);
+
+#endif // GSTSHVPUSCHED_H